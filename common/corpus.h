@@ -0,0 +1,417 @@
+// corpus.h
+// Binary collision corpus shared by all the generators, with a zero-copy mmap reader
+// Author: Paul Bottinelli
+// For Black Hat EU 2025 - Cut to the QUIC: Slashing QUIC's Performance with a Hash DoS
+//
+// Every generator can write its collisions as a corpus (--corpus path), which any consumer
+// maps and indexes directly instead of parsing one of the text formats. All integers are
+// little-endian. A file is laid out as:
+//
+//   header     CorpusHeader, 128 bytes
+//   model      hash model the records collide under, as text (see below)
+//   params     generator parameters, "key=value" lines
+//   data       the records, concatenated, starting on a 64-byte boundary
+//   offsets    when the records vary in length: record_count + 1 uint64 offsets into
+//              data, starting on an 8-byte boundary; absent for fixed-length records
+//
+// checksum is the CRC-32 (zlib's) of every byte after the header, padding included.
+// Records share target under the model on the bits of target_mask: all of them for full
+// collisions, the low bits for inputs colliding in a bucket index.
+//
+// Hash models, with the syntax of joint_collisions:
+//   xxh32:<seed>                          XXHash32
+//   mult:<initial>:<multiplier>[:<bits>]  h = h * multiplier + byte, 32 bits by default
+//   dsl:<name>                            a hash-dsl model; the params give its model_path
+//
+// common/corpus.py reads and writes the same format from Python.
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#define CORPUS_MAGIC "HASHCORP"
+#define CORPUS_VERSION 1
+
+struct CorpusHeader {
+    char magic[8];             // CORPUS_MAGIC
+    uint32_t version;          // CORPUS_VERSION
+    uint32_t header_size;      // sizeof(CorpusHeader)
+    uint64_t record_count;
+    uint64_t record_size;      // bytes per record, 0 when lengths vary
+    uint64_t target;
+    uint64_t target_mask;
+    uint64_t seed;             // random seed of the generator, 0 if unknown
+    uint32_t hash_bits;        // digest size
+    uint32_t checksum;
+    uint64_t model_offset;
+    uint64_t model_size;
+    uint64_t params_offset;
+    uint64_t params_size;
+    uint64_t data_offset;
+    uint64_t data_size;
+    uint64_t offsets_offset;   // 0 for fixed-length records
+    uint64_t reserved;
+};
+static_assert(sizeof(CorpusHeader) == 128, "corpus header layout");
+
+// CRC-32 with the polynomial and conventions of zlib.crc32, slicing by 8 bytes
+class Crc32 {
+public:
+    void update(const uint8_t* data, size_t size) noexcept {
+        const auto& t = tables();
+        uint32_t crc = ~crc_;
+        for (; size >= 8; data += 8, size -= 8) {
+            uint32_t low, high;
+            std::memcpy(&low, data, 4);
+            std::memcpy(&high, data + 4, 4);
+            low ^= crc;
+            crc = t[7][low & 0xFF] ^ t[6][(low >> 8) & 0xFF] ^ t[5][(low >> 16) & 0xFF] ^
+                  t[4][low >> 24] ^ t[3][high & 0xFF] ^ t[2][(high >> 8) & 0xFF] ^
+                  t[1][(high >> 16) & 0xFF] ^ t[0][high >> 24];
+        }
+        for (; size > 0; ++data, --size) {
+            crc = t[0][(crc ^ *data) & 0xFF] ^ (crc >> 8);
+        }
+        crc_ = ~crc;
+    }
+
+    uint32_t value() const noexcept { return crc_; }
+
+private:
+    uint32_t crc_ = 0;
+
+    using Tables = std::array<std::array<uint32_t, 256>, 8>;
+    static const Tables& tables() {
+        static const Tables instance = []() {
+            Tables t;
+            for (uint32_t i = 0; i < 256; ++i) {
+                uint32_t c = i;
+                for (int k = 0; k < 8; ++k) {
+                    c = (c >> 1) ^ (0xEDB88320U & (0U - (c & 1)));
+                }
+                t[0][i] = c;
+            }
+            for (uint32_t i = 0; i < 256; ++i) {
+                for (size_t k = 1; k < 8; ++k) {
+                    t[k][i] = (t[k - 1][i] >> 8) ^ t[0][t[k - 1][i] & 0xFF];
+                }
+            }
+            return t;
+        }();
+        return instance;
+    }
+};
+
+// Description of the records, written in the header
+struct CorpusInfo {
+    std::string model;
+    unsigned hash_bits = 32;
+    uint64_t target = 0;
+    uint64_t target_mask = ~uint64_t(0);
+    uint64_t seed = 0;
+    std::string params;
+
+    // Append a "key=value" line to the parameters
+    template <typename T>
+    CorpusInfo& param(const std::string& key, const T& value) {
+        params += key + "=" + to_text(value) + "\n";
+        return *this;
+    }
+
+private:
+    static std::string to_text(const std::string& value) { return value; }
+    static std::string to_text(const char* value) { return value; }
+    template <typename T>
+    static std::string to_text(const T& value) { return std::to_string(value); }
+};
+
+// Streams records to a corpus file. record_size fixes the length of every record, 0 lets
+// it vary. The header is written last, by finish() or the destructor.
+class CorpusWriter {
+public:
+    CorpusWriter(const std::string& path, const CorpusInfo& info, size_t record_size = 0)
+        : path_(path), file_(path, std::ios::binary | std::ios::trunc), record_size_(record_size) {
+        if (!file_) {
+            throw std::runtime_error("could not open corpus file '" + path + "'");
+        }
+        std::memset(&header_, 0, sizeof(header_));
+        std::memcpy(header_.magic, CORPUS_MAGIC, sizeof(header_.magic));
+        header_.version = CORPUS_VERSION;
+        header_.header_size = sizeof(CorpusHeader);
+        header_.record_size = record_size;
+        header_.target = info.target;
+        header_.target_mask = info.target_mask;
+        header_.seed = info.seed;
+        header_.hash_bits = info.hash_bits;
+        const CorpusHeader placeholder = header_;
+        file_.write(reinterpret_cast<const char*>(&placeholder), sizeof(placeholder));
+        position_ = sizeof(CorpusHeader);
+        header_.model_offset = position_;
+        header_.model_size = info.model.size();
+        write(info.model.data(), info.model.size());
+        header_.params_offset = position_;
+        header_.params_size = info.params.size();
+        write(info.params.data(), info.params.size());
+        pad(64);
+        header_.data_offset = position_;
+        if (record_size == 0) {
+            offsets_.push_back(0);
+        }
+    }
+
+    CorpusWriter(const CorpusWriter&) = delete;
+    CorpusWriter& operator=(const CorpusWriter&) = delete;
+
+    ~CorpusWriter() {
+        try {
+            finish();
+        } catch (...) {
+        }
+    }
+
+    void add(const uint8_t* data, size_t size) {
+        if (record_size_ != 0 && size != record_size_) {
+            throw std::invalid_argument("corpus record of " + std::to_string(size) + " bytes, expected " +
+                                        std::to_string(record_size_));
+        }
+        write(data, size);
+        ++header_.record_count;
+        if (record_size_ == 0) {
+            offsets_.push_back(position_ - header_.data_offset);
+        }
+    }
+
+    // The digest the records share, when only known once they are generated
+    void set_target(uint64_t target) { header_.target = target; }
+
+    uint64_t size() const noexcept { return header_.record_count; }
+    const std::string& path() const noexcept { return path_; }
+
+    void finish() {
+        if (finished_) {
+            return;
+        }
+        finished_ = true;
+        header_.data_size = position_ - header_.data_offset;
+        if (record_size_ == 0) {
+            pad(8);
+            header_.offsets_offset = position_;
+            write(reinterpret_cast<const uint8_t*>(offsets_.data()), offsets_.size() * sizeof(uint64_t));
+        }
+        header_.checksum = crc_.value();
+        file_.seekp(0);
+        file_.write(reinterpret_cast<const char*>(&header_), sizeof(header_));
+        file_.close();
+        if (!file_) {
+            throw std::runtime_error("could not write corpus file '" + path_ + "'");
+        }
+    }
+
+private:
+    std::string path_;
+    std::ofstream file_;
+    size_t record_size_;
+    CorpusHeader header_;
+    uint64_t position_ = 0;
+    std::vector<uint64_t> offsets_;
+    Crc32 crc_;
+    bool finished_ = false;
+
+    void write(const void* data, size_t size) {
+        file_.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+        crc_.update(static_cast<const uint8_t*>(data), size);
+        position_ += size;
+    }
+
+    void pad(uint64_t alignment) {
+        static const uint8_t zeros[64] = {};
+        write(zeros, static_cast<size_t>((alignment - position_ % alignment) % alignment));
+    }
+};
+
+// A record of a mapped corpus, valid as long as the corpus
+struct CorpusRecord {
+    const uint8_t* data;
+    size_t size;
+};
+
+// Read-only mapping of a corpus file; records are accessed in place
+class Corpus {
+public:
+    explicit Corpus(const std::string& path) : path_(path) {
+        map(path);
+        try {
+            validate();
+        } catch (...) {
+            unmap();
+            throw;
+        }
+    }
+
+    Corpus(const Corpus&) = delete;
+    Corpus& operator=(const Corpus&) = delete;
+
+    ~Corpus() { unmap(); }
+
+    const CorpusHeader& header() const noexcept { return header_; }
+    uint64_t size() const noexcept { return header_.record_count; }
+    bool fixed_size() const noexcept { return header_.record_size != 0; }
+    size_t record_size() const noexcept { return static_cast<size_t>(header_.record_size); }
+    const uint8_t* data() const noexcept { return data_; }
+    uint64_t data_size() const noexcept { return header_.data_size; }
+    uint64_t file_size() const noexcept { return size_; }
+    const std::string& path() const noexcept { return path_; }
+
+    std::string model() const { return text(header_.model_offset, header_.model_size); }
+    std::string params() const { return text(header_.params_offset, header_.params_size); }
+
+    // Value of key in the parameters, or fallback
+    std::string param(const std::string& key, const std::string& fallback = "") const {
+        const std::string all = params();
+        size_t start = 0;
+        while (start < all.size()) {
+            size_t end = all.find('\n', start);
+            if (end == std::string::npos) {
+                end = all.size();
+            }
+            if (all.compare(start, key.size(), key) == 0 && start + key.size() < end &&
+                all[start + key.size()] == '=') {
+                return all.substr(start + key.size() + 1, end - start - key.size() - 1);
+            }
+            start = end + 1;
+        }
+        return fallback;
+    }
+
+    CorpusRecord operator[](uint64_t i) const noexcept {
+        if (offsets_) {
+            return {data_ + offsets_[i], static_cast<size_t>(offsets_[i + 1] - offsets_[i])};
+        }
+        return {data_ + i * header_.record_size, static_cast<size_t>(header_.record_size)};
+    }
+
+    bool verify_checksum() const noexcept {
+        Crc32 crc;
+        crc.update(base_ + sizeof(CorpusHeader), static_cast<size_t>(size_ - sizeof(CorpusHeader)));
+        return crc.value() == header_.checksum;
+    }
+
+private:
+    std::string path_;
+    CorpusHeader header_;
+    const uint8_t* base_ = nullptr;
+    uint64_t size_ = 0;
+    const uint8_t* data_ = nullptr;
+    const uint64_t* offsets_ = nullptr;
+    std::vector<uint8_t> buffer_;  // file contents where mmap is unavailable
+    bool mapped_ = false;
+
+    // Check the header and that every section lies within the file
+    void validate() {
+        if (size_ < sizeof(CorpusHeader)) {
+            invalid("file too short");
+        }
+        std::memcpy(&header_, base_, sizeof(header_));
+        if (std::memcmp(header_.magic, CORPUS_MAGIC, sizeof(header_.magic)) != 0) {
+            invalid("not a corpus file");
+        }
+        if (header_.version != CORPUS_VERSION || header_.header_size != sizeof(CorpusHeader)) {
+            invalid("unsupported version " + std::to_string(header_.version));
+        }
+        check_section(header_.model_offset, header_.model_size);
+        check_section(header_.params_offset, header_.params_size);
+        check_section(header_.data_offset, header_.data_size);
+        if (header_.record_size != 0) {
+            if (header_.data_size / header_.record_size != header_.record_count ||
+                header_.data_size % header_.record_size != 0) {
+                invalid("data size does not match the record count");
+            }
+        } else {
+            if (header_.record_count > (size_ - sizeof(CorpusHeader)) / sizeof(uint64_t) ||
+                header_.offsets_offset % sizeof(uint64_t) != 0) {
+                invalid("bad offsets table");
+            }
+            check_section(header_.offsets_offset, (header_.record_count + 1) * sizeof(uint64_t));
+            offsets_ = reinterpret_cast<const uint64_t*>(base_ + header_.offsets_offset);
+            for (uint64_t i = 0; i < header_.record_count; ++i) {
+                if (offsets_[i] > offsets_[i + 1]) {
+                    invalid("offsets not increasing");
+                }
+            }
+            if (offsets_[0] != 0 || offsets_[header_.record_count] != header_.data_size) {
+                invalid("offsets do not cover the data");
+            }
+        }
+        data_ = base_ + header_.data_offset;
+    }
+
+    [[noreturn]] void invalid(const std::string& reason) const {
+        throw std::runtime_error("invalid corpus '" + path_ + "': " + reason);
+    }
+
+    void check_section(uint64_t offset, uint64_t size) const {
+        if (offset < sizeof(CorpusHeader) || offset > size_ || size > size_ - offset) {
+            invalid("section out of bounds");
+        }
+    }
+
+    std::string text(uint64_t offset, uint64_t size) const {
+        return std::string(reinterpret_cast<const char*>(base_ + offset), static_cast<size_t>(size));
+    }
+
+    void map(const std::string& path) {
+#if defined(__unix__) || defined(__APPLE__)
+        const int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            throw std::runtime_error("could not open corpus file '" + path + "'");
+        }
+        struct stat st;
+        if (::fstat(fd, &st) != 0) {
+            ::close(fd);
+            throw std::runtime_error("could not stat corpus file '" + path + "'");
+        }
+        size_ = static_cast<uint64_t>(st.st_size);
+        if (size_ != 0) {
+            void* p = ::mmap(nullptr, static_cast<size_t>(size_), PROT_READ, MAP_SHARED, fd, 0);
+            if (p == MAP_FAILED) {
+                ::close(fd);
+                throw std::runtime_error("could not map corpus file '" + path + "'");
+            }
+            base_ = static_cast<const uint8_t*>(p);
+            mapped_ = true;
+        }
+        ::close(fd);
+#else
+        std::ifstream file(path, std::ios::binary);
+        if (!file) {
+            throw std::runtime_error("could not open corpus file '" + path + "'");
+        }
+        buffer_.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        base_ = buffer_.data();
+        size_ = buffer_.size();
+#endif
+    }
+
+    void unmap() noexcept {
+#if defined(__unix__) || defined(__APPLE__)
+        if (mapped_) {
+            ::munmap(const_cast<uint8_t*>(base_), static_cast<size_t>(size_));
+        }
+#endif
+    }
+};
@@ -0,0 +1,137 @@
+# corpus.py
+# Binary collision corpus (see corpus.h) for the Python generators
+# Author: Paul Bottinelli
+# For Black Hat EU 2025 - Cut to the QUIC: Slashing QUIC's Performance with a Hash DoS
+#
+# Same file format as common/corpus.h: a 128-byte header, the hash model and the
+# generator parameters as text, the records, and an offsets table when their lengths vary.
+# The records are streamed to the file, and the header is written when the writer closes.
+
+import mmap
+import struct
+import zlib
+
+MAGIC = b'HASHCORP'
+VERSION = 1
+HEADER = struct.Struct('<8sIIQQQQQII8Q')
+assert HEADER.size == 128
+
+
+class CorpusWriter:
+    """Write records to a corpus file; record_size fixes their length, 0 lets it vary."""
+
+    def __init__(self, path, model, target=0, hash_bits=32, target_mask=None, seed=0,
+                 params=None, record_size=0):
+        self.path = path
+        self.model = model.encode()
+        self.params = ''.join(f'{k}={v}\n' for k, v in (params or {}).items()).encode()
+        self.target = target
+        self.hash_bits = hash_bits
+        self.target_mask = (1 << 64) - 1 if target_mask is None else target_mask
+        self.seed = seed
+        self.record_size = record_size
+        self.count = 0
+        self._file = open(path, 'wb')
+        self._file.write(bytes(HEADER.size))
+        self._position = HEADER.size
+        self._crc = 0
+        self._model_offset = self._write(self.model)
+        self._params_offset = self._write(self.params)
+        self._pad(64)
+        self._data_offset = self._position
+        self._offsets = [0] if record_size == 0 else None
+
+    def add(self, record):
+        if self.record_size and len(record) != self.record_size:
+            raise ValueError(f"corpus record of {len(record)} bytes, expected {self.record_size}")
+        self._write(record)
+        self.count += 1
+        if self._offsets is not None:
+            self._offsets.append(self._position - self._data_offset)
+
+    def close(self):
+        if self._file is None:
+            return
+        data_size = self._position - self._data_offset
+        offsets_offset = 0
+        if self._offsets is not None:
+            self._pad(8)
+            offsets_offset = self._write(struct.pack(f'<{len(self._offsets)}Q', *self._offsets))
+        self._file.seek(0)
+        self._file.write(HEADER.pack(
+            MAGIC, VERSION, HEADER.size, self.count, self.record_size, self.target,
+            self.target_mask, self.seed, self.hash_bits, self._crc,
+            self._model_offset, len(self.model), self._params_offset, len(self.params),
+            self._data_offset, data_size, offsets_offset, 0))
+        self._file.close()
+        self._file = None
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *exc):
+        self.close()
+
+    def _write(self, data):
+        offset = self._position
+        self._file.write(data)
+        self._crc = zlib.crc32(data, self._crc)
+        self._position += len(data)
+        return offset
+
+    def _pad(self, alignment):
+        self._write(bytes(-self._position % alignment))
+
+
+class Corpus:
+    """Memory-mapped corpus; records are bytes-like views sliced from the mapping."""
+
+    def __init__(self, path):
+        with open(path, 'rb') as f:
+            self._map = mmap.mmap(f.fileno(), 0, access=mmap.ACCESS_READ)
+        if len(self._map) < HEADER.size:
+            raise ValueError(f"invalid corpus '{path}': file too short")
+        (magic, version, header_size, self.count, self.record_size, self.target,
+         self.target_mask, self.seed, self.hash_bits, self.checksum,
+         model_offset, model_size, params_offset, params_size,
+         self._data_offset, self.data_size, offsets_offset, _) = HEADER.unpack_from(self._map)
+        if magic != MAGIC:
+            raise ValueError(f"invalid corpus '{path}': not a corpus file")
+        if version != VERSION or header_size != HEADER.size:
+            raise ValueError(f"invalid corpus '{path}': unsupported version {version}")
+        self.model = self._map[model_offset:model_offset + model_size].decode()
+        self.params = dict(line.split('=', 1) for line in
+                           self._map[params_offset:params_offset + params_size].decode().splitlines()
+                           if '=' in line)
+        self._view = memoryview(self._map)
+        self._offsets = None
+        if self.record_size == 0:
+            self._offsets = self._view[offsets_offset:offsets_offset + 8 * (self.count + 1)].cast('Q')
+
+    def __len__(self):
+        return self.count
+
+    def __getitem__(self, i):
+        if not 0 <= i < self.count:
+            raise IndexError(i)
+        if self._offsets is None:
+            start = self._data_offset + i * self.record_size
+            return bytes(self._view[start:start + self.record_size])
+        return bytes(self._view[self._data_offset + self._offsets[i]:self._data_offset + self._offsets[i + 1]])
+
+    def __iter__(self):
+        return (self[i] for i in range(self.count))
+
+    def verify_checksum(self):
+        return zlib.crc32(self._view[HEADER.size:]) == self.checksum
+
+    def close(self):
+        self._offsets = None
+        self._view.release()
+        self._map.close()
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *exc):
+        self.close()
@@ -0,0 +1,115 @@
+// hash_model.h
+// Binary interface of the hash model kernels generated by hash-dsl/hashgen.py, and their loader
+// Author: Paul Bottinelli
+// For Black Hat EU 2025 - Cut to the QUIC: Slashing QUIC's Performance with a Hash DoS
+//
+// A hash model is an initial state, a round absorbing one little-endian input word of 1 to
+// 8 bytes into the state, and a finalization that may depend on the input length. Every
+// step is invertible in the state, so the generated shared object provides, besides the
+// forward direction, the backward round (from a state and a word to the previous state)
+// and the inverse finalization that the meet-in-the-middle engines need, and a batch
+// kernel hashing many inputs at once from a structure-of-arrays layout.
+//
+// The shared object exports a single C function, hash_model_kernels, returning a table of
+// function pointers. HashModel loads it with dlopen and exposes it with the interface of
+// MultiplicativeHash where both make sense.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#ifndef HASH_MODEL_NO_LOADER
+#include <dlfcn.h>
+#endif
+
+// Bumped whenever HashModelKernels changes
+#define HASH_MODEL_ABI_VERSION 1
+
+extern "C" {
+
+struct HashModelKernels {
+    uint32_t abi_version;
+    const char* name;
+    unsigned bits;        // 32 or 64
+    unsigned word_bytes;  // bytes per round, inputs are a whole number of words
+    uint64_t initial_state;
+    // Absorb the length / word_bytes words of data into state
+    uint64_t (*forward)(uint64_t state, const uint8_t* data, size_t length);
+    // Undo forward: backward(forward(s, data, n), data, n) == s
+    uint64_t (*backward)(uint64_t state, const uint8_t* data, size_t length);
+    // Digest of a state after an input of the given total length, and its inverse
+    uint64_t (*finalize)(uint64_t state, uint64_t length);
+    uint64_t (*unfinalize)(uint64_t digest, uint64_t length);
+    // 32-bit models only, null otherwise: absorb n_words words into each of lanes states.
+    // Word p of lane l is at words + (p * lanes + l) * word_bytes.
+    void (*forward_batch)(uint32_t* states, const uint8_t* words, size_t n_words, size_t lanes);
+};
+
+typedef const HashModelKernels* (*HashModelKernelsFunction)(void);
+
+}  // extern "C"
+
+#ifndef HASH_MODEL_NO_LOADER
+
+class HashModel {
+public:
+    // Load the kernels of a shared object generated by hashgen.py
+    explicit HashModel(const std::string& path) {
+        handle_ = dlopen(path.c_str(), RTLD_NOW | RTLD_LOCAL);
+        if (!handle_) {
+            throw std::runtime_error("cannot load hash model " + path + ": " + dlerror());
+        }
+        const auto get = reinterpret_cast<HashModelKernelsFunction>(dlsym(handle_, "hash_model_kernels"));
+        kernels_ = get ? get() : nullptr;
+        if (!kernels_ || kernels_->abi_version != HASH_MODEL_ABI_VERSION) {
+            dlclose(handle_);
+            throw std::runtime_error(path + " is not a hash model of ABI version " +
+                                     std::to_string(HASH_MODEL_ABI_VERSION) + ", regenerate it");
+        }
+        mask_ = kernels_->bits >= 64 ? ~uint64_t(0) : (uint64_t(1) << kernels_->bits) - 1;
+    }
+
+    HashModel(const HashModel&) = delete;
+    HashModel& operator=(const HashModel&) = delete;
+    ~HashModel() { dlclose(handle_); }
+
+    std::string name() const { return kernels_->name; }
+    unsigned bits() const noexcept { return kernels_->bits; }
+    unsigned word_bytes() const noexcept { return kernels_->word_bytes; }
+    uint64_t mask() const noexcept { return mask_; }
+    uint64_t initial_value() const noexcept { return kernels_->initial_state; }
+    bool has_batch() const noexcept { return kernels_->forward_batch != nullptr; }
+
+    uint64_t hash(const uint8_t* val, size_t length) const noexcept {
+        return kernels_->finalize(kernels_->forward(kernels_->initial_state, val, length), length);
+    }
+
+    uint64_t forward(uint64_t state, const uint8_t* val, size_t length) const noexcept {
+        return kernels_->forward(state, val, length);
+    }
+
+    uint64_t backward(uint64_t state, const uint8_t* val, size_t length) const noexcept {
+        return kernels_->backward(state, val, length);
+    }
+
+    uint64_t finalize(uint64_t state, uint64_t length) const noexcept {
+        return kernels_->finalize(state, length);
+    }
+
+    uint64_t unfinalize(uint64_t digest, uint64_t length) const noexcept {
+        return kernels_->unfinalize(digest, length);
+    }
+
+    void forward_batch(uint32_t* states, const uint8_t* words, size_t n_words, size_t lanes) const noexcept {
+        kernels_->forward_batch(states, words, n_words, lanes);
+    }
+
+private:
+    void* handle_ = nullptr;
+    const HashModelKernels* kernels_ = nullptr;
+    uint64_t mask_ = 0;
+};
+
+#endif  // HASH_MODEL_NO_LOADER
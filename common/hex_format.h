@@ -0,0 +1,247 @@
+// hex_format.h
+// Hexadecimal, C-array and bytes-literal formatting of collisions into large output buffers
+// Author: Paul Bottinelli
+// For Black Hat EU 2025 - Cut to the QUIC: Slashing QUIC's Performance with a Hash DoS
+//
+// Writing hundreds of millions of collisions through stream manipulators costs more than
+// finding them. The encoders here write into a caller-provided buffer: hexadecimal digits
+// are looked up 16 bytes at a time with SSSE3 byte shuffles (pshufb), and C arrays are
+// rendered from those digits with three more shuffles per 8 bytes into a constant
+// "0x.., " template. Buffer collects the lines of a run in a large preallocated buffer
+// and hands it to the stream in a few large writes.
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <ostream>
+#include <string>
+#include <vector>
+#if defined(__SSSE3__)
+#include <immintrin.h>
+#endif
+
+namespace hex_format {
+
+// Characters written by each encoder, at most
+inline size_t hex_size(size_t length) noexcept { return 2 * length; }
+inline size_t c_array_size(size_t length) noexcept { return 6 * length + 2; }
+inline size_t bytes_literal_size(size_t length) noexcept { return 4 * length + 3; }
+
+namespace detail {
+
+constexpr char DIGITS[] = "0123456789abcdef";
+
+#if defined(__SSSE3__)
+// The hexadecimal digits of 16 bytes, as the digits of bytes 0-7 and of bytes 8-15
+inline void hex16(const uint8_t* data, __m128i& low, __m128i& high) {
+    const __m128i digits = _mm_loadu_si128(reinterpret_cast<const __m128i*>(DIGITS));
+    const __m128i nibble = _mm_set1_epi8(0x0F);
+    const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data));
+    const __m128i hi = _mm_shuffle_epi8(digits, _mm_and_si128(_mm_srli_epi16(bytes, 4), nibble));
+    const __m128i lo = _mm_shuffle_epi8(digits, _mm_and_si128(bytes, nibble));
+    low = _mm_unpacklo_epi8(hi, lo);
+    high = _mm_unpackhi_epi8(hi, lo);
+}
+
+// Shuffles placing the 16 digits of 8 bytes into 48 characters of "0x.., " groups, and
+// the template characters around them
+struct CArrayTables {
+    __m128i shuffle[3];
+    __m128i chars[3];
+
+    CArrayTables() {
+        alignas(16) uint8_t shuffle_bytes[48];
+        alignas(16) char template_chars[48];
+        for (int p = 0; p < 48; ++p) {
+            const int byte = p / 6, column = p % 6;
+            shuffle_bytes[p] = column == 2 ? uint8_t(2 * byte) : column == 3 ? uint8_t(2 * byte + 1) : 0x80;
+            template_chars[p] = "0x\0\0, "[column];
+        }
+        for (int k = 0; k < 3; ++k) {
+            shuffle[k] = _mm_load_si128(reinterpret_cast<const __m128i*>(shuffle_bytes + 16 * k));
+            chars[k] = _mm_load_si128(reinterpret_cast<const __m128i*>(template_chars + 16 * k));
+        }
+    }
+};
+
+inline char* c_array8(__m128i digits, char* out) {
+    static const CArrayTables tables;
+    for (int k = 0; k < 3; ++k) {
+        const __m128i text = _mm_or_si128(_mm_shuffle_epi8(digits, tables.shuffle[k]), tables.chars[k]);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 16 * k), text);
+    }
+    return out + 48;
+}
+#endif
+
+}  // namespace detail
+
+// Lowercase hexadecimal digits of data; returns the end of the output
+inline char* encode_hex(const uint8_t* data, size_t length, char* out) {
+    size_t i = 0;
+#if defined(__SSSE3__)
+    for (; i + 16 <= length; i += 16) {
+        __m128i low, high;
+        detail::hex16(data + i, low, high);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out), low);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 16), high);
+        out += 32;
+    }
+#endif
+    for (; i < length; ++i) {
+        *out++ = detail::DIGITS[data[i] >> 4];
+        *out++ = detail::DIGITS[data[i] & 0xF];
+    }
+    return out;
+}
+
+// C-style byte array, {0x12, 0x34}
+inline char* encode_c_array(const uint8_t* data, size_t length, char* out) {
+    *out++ = '{';
+    size_t i = 0;
+#if defined(__SSSE3__)
+    for (; i + 16 <= length; i += 16) {
+        __m128i low, high;
+        detail::hex16(data + i, low, high);
+        out = detail::c_array8(high, detail::c_array8(low, out));
+    }
+#endif
+    for (; i < length; ++i) {
+        const char group[6] = {'0', 'x', detail::DIGITS[data[i] >> 4], detail::DIGITS[data[i] & 0xF], ',', ' '};
+        std::memcpy(out, group, sizeof(group));
+        out += sizeof(group);
+    }
+    // The last group has no separator
+    if (length > 0) {
+        out -= 2;
+    }
+    *out++ = '}';
+    return out;
+}
+
+// Python bytes literal, b'ab\x01'
+inline char* encode_bytes_literal(const uint8_t* data, size_t length, char* out) {
+    *out++ = 'b';
+    *out++ = '\'';
+    for (size_t i = 0; i < length; ++i) {
+        const uint8_t c = data[i];
+        if (c == '\\' || c == '\'') {
+            *out++ = '\\';
+            *out++ = static_cast<char>(c);
+        } else if (c == '\t' || c == '\n' || c == '\r') {
+            *out++ = '\\';
+            *out++ = c == '\t' ? 't' : c == '\n' ? 'n' : 'r';
+        } else if (c >= 0x20 && c < 0x7F) {
+            *out++ = static_cast<char>(c);
+        } else {
+            *out++ = '\\';
+            *out++ = 'x';
+            *out++ = detail::DIGITS[c >> 4];
+            *out++ = detail::DIGITS[c & 0xF];
+        }
+    }
+    *out++ = '\'';
+    return out;
+}
+
+// Hexadecimal digits of value, without leading zeros (as std::hex writes them)
+inline char* encode_uint(uint64_t value, char* out) {
+    int digits = 1;
+    while (digits < 16 && (value >> (4 * digits)) != 0) {
+        ++digits;
+    }
+    for (int i = digits - 1; i >= 0; --i) {
+        *out++ = detail::DIGITS[(value >> (4 * i)) & 0xF];
+    }
+    return out;
+}
+
+inline std::string hex_string(const uint8_t* data, size_t length) {
+    std::string hex(hex_size(length), '\0');
+    encode_hex(data, length, &hex[0]);
+    return hex;
+}
+
+// Output buffer of a stream: text is formatted in place and reaches the stream in writes
+// of about capacity bytes, when the buffer fills up, on flush() and on destruction. Other
+// writes to the stream must come after a flush() to keep their order.
+class Buffer {
+public:
+    static constexpr size_t DEFAULT_CAPACITY = size_t(1) << 20;
+
+    explicit Buffer(std::ostream& out, size_t capacity = DEFAULT_CAPACITY)
+        : out_(out), data_(std::max<size_t>(capacity, 256)) {}
+
+    Buffer(const Buffer&) = delete;
+    Buffer& operator=(const Buffer&) = delete;
+
+    ~Buffer() { flush(); }
+
+    // Room for n more characters; write them at the returned pointer, then commit() its end
+    char* reserve(size_t n) {
+        if (size_ + n > data_.size()) {
+            flush();
+            if (n > data_.size()) {
+                data_.resize(n);
+            }
+        }
+        return data_.data() + size_;
+    }
+
+    void commit(char* end) noexcept { size_ = static_cast<size_t>(end - data_.data()); }
+
+    Buffer& put(char c) {
+        char* out = reserve(1);
+        *out = c;
+        commit(out + 1);
+        return *this;
+    }
+
+    Buffer& append(const char* text, size_t length) {
+        char* out = reserve(length);
+        std::memcpy(out, text, length);
+        commit(out + length);
+        return *this;
+    }
+
+    Buffer& append(const char* text) { return append(text, std::strlen(text)); }
+    Buffer& append(const std::string& text) { return append(text.data(), text.size()); }
+
+    Buffer& hex(const uint8_t* data, size_t length) {
+        commit(encode_hex(data, length, reserve(hex_size(length))));
+        return *this;
+    }
+
+    Buffer& c_array(const uint8_t* data, size_t length) {
+        commit(encode_c_array(data, length, reserve(c_array_size(length))));
+        return *this;
+    }
+
+    Buffer& bytes_literal(const uint8_t* data, size_t length) {
+        commit(encode_bytes_literal(data, length, reserve(bytes_literal_size(length))));
+        return *this;
+    }
+
+    Buffer& uint(uint64_t value) {
+        commit(encode_uint(value, reserve(16)));
+        return *this;
+    }
+
+    void flush() {
+        if (size_ > 0) {
+            out_.write(data_.data(), static_cast<std::streamsize>(size_));
+            size_ = 0;
+        }
+        out_.flush();
+    }
+
+private:
+    std::ostream& out_;
+    std::vector<char> data_;
+    size_t size_ = 0;
+};
+
+}  // namespace hex_format
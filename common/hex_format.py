@@ -0,0 +1,51 @@
+# hex_format.py
+# Hexadecimal and C-array formatting of collisions, written in large batches
+# Author: Paul Bottinelli
+# For Black Hat EU 2025 - Cut to the QUIC: Slashing QUIC's Performance with a Hash DoS
+#
+# Python counterpart of hex_format.h for the Python generators: bytes.hex() instead of
+# binascii.hexlify per collision, a table of the 256 "0x.." strings instead of a format
+# operation per byte, and lines joined and written a batch at a time instead of one
+# print() each.
+
+C_BYTES = tuple(f'0x{i:02x}' for i in range(256))
+
+
+def hex_line(record):
+    """Hexadecimal string of a collision."""
+    return record.hex()
+
+
+def c_array(record):
+    """C-style byte array of a collision, {0x12, 0x34}."""
+    return '{' + ', '.join([C_BYTES[b] for b in record]) + '}'
+
+
+class LineWriter:
+    """Collect lines and write them to a text file in batches of about capacity characters."""
+
+    def __init__(self, file, capacity=1 << 20):
+        self.file = file
+        self.capacity = capacity
+        self._lines = []
+        self._size = 0
+
+    def write(self, line):
+        self._lines.append(line)
+        self._size += len(line) + 1
+        if self._size >= self.capacity:
+            self.flush()
+
+    def flush(self):
+        if self._lines:
+            self._lines.append('')
+            self.file.write('\n'.join(self._lines))
+            self._lines = []
+            self._size = 0
+        self.file.flush()
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *exc):
+        self.flush()
@@ -0,0 +1,413 @@
+// large_alloc.h
+// Huge-page and NUMA-aware allocation for large lookup tables, and thread placement
+// Author: Paul Bottinelli
+// For Black Hat EU 2025 - Cut to the QUIC: Slashing QUIC's Performance with a Hash DoS
+//
+// Tables of several GB are probed at random, so with 4 KB pages nearly every lookup also
+// misses the TLB, and on multi-socket hosts half of them go to the remote node. Containers
+// using large_alloc::Allocator get, for every allocation of at least 2 MB:
+//   - huge pages: explicit 2 MB pages (MAP_HUGETLB), or transparent huge pages requested
+//     with madvise on a 2 MB aligned mapping, falling back to the latter if the former fail
+//   - NUMA placement through the mbind system call: pages bound to the node selected with
+//     NodeBinding on the allocating thread (to build one replica per node), or interleaved
+//     over all nodes, or left to the first-touch default
+// Worker threads are pinned next to their replica with pin_thread. report() shows, for
+// every live large allocation, the page size actually used and the pages on each node.
+//
+// Only the raw system calls are used, so there is no dependency on libnuma. On other
+// systems, allocations fall back to operator new and placement is a no-op.
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <iterator>
+#include <map>
+#include <mutex>
+#include <new>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#ifdef __linux__
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace large_alloc {
+
+enum class HugePages { Off, Transparent, Explicit };
+enum class NumaPolicy { Local, Interleave, Replicate };
+
+constexpr size_t HUGE_PAGE_SIZE = size_t(2) << 20;
+
+struct Config {
+    HugePages huge_pages = HugePages::Transparent;
+    NumaPolicy numa = NumaPolicy::Local;
+};
+
+inline Config& config() {
+    static Config instance;
+    return instance;
+}
+
+// Node the allocations of the current thread are bound to, -1 for the global policy
+inline int& bound_node() {
+    static thread_local int node = -1;
+    return node;
+}
+
+// Binds the allocations of the current thread to node while in scope
+class NodeBinding {
+public:
+    explicit NodeBinding(int node) : previous_(bound_node()) { bound_node() = node; }
+    ~NodeBinding() { bound_node() = previous_; }
+    NodeBinding(const NodeBinding&) = delete;
+    NodeBinding& operator=(const NodeBinding&) = delete;
+
+private:
+    int previous_;
+};
+
+// Parse a sysfs CPU list such as "0-15,32-47"
+inline std::vector<int> parse_cpu_list(const std::string& list) {
+    std::vector<int> cpus;
+    std::stringstream stream(list);
+    std::string range;
+    while (std::getline(stream, range, ',')) {
+        if (range.empty() || range == "\n") {
+            continue;
+        }
+        const size_t dash = range.find('-');
+        const int lo = std::stoi(range.substr(0, dash));
+        const int hi = dash == std::string::npos ? lo : std::stoi(range.substr(dash + 1));
+        for (int cpu = lo; cpu <= hi; ++cpu) {
+            cpus.push_back(cpu);
+        }
+    }
+    return cpus;
+}
+
+// NUMA nodes with the CPUs this process may run on; a single node 0 when sysfs has no
+// node information
+struct Topology {
+    std::map<int, std::vector<int>> node_cpus;
+
+    static const Topology& get() {
+        static const Topology topology = detect();
+        return topology;
+    }
+
+    size_t n_nodes() const noexcept { return node_cpus.size(); }
+
+    int node_of_cpu(int cpu) const noexcept {
+        for (const auto& node : node_cpus) {
+            for (int c : node.second) {
+                if (c == cpu) {
+                    return node.first;
+                }
+            }
+        }
+        return 0;
+    }
+
+    // CPU for worker i: workers are spread round-robin over the nodes, then over the CPUs
+    // of each node
+    int worker_cpu(size_t worker) const {
+        auto node = node_cpus.begin();
+        std::advance(node, worker % node_cpus.size());
+        const std::vector<int>& cpus = node->second;
+        return cpus[(worker / node_cpus.size()) % cpus.size()];
+    }
+
+private:
+    static Topology detect() {
+        Topology topology;
+        std::vector<int> allowed;
+#ifdef __linux__
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+            for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+                if (CPU_ISSET(cpu, &set)) {
+                    allowed.push_back(cpu);
+                }
+            }
+        }
+        for (int node = 0; node < 1024; ++node) {
+            std::ifstream file("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+            if (!file) {
+                continue;
+            }
+            std::string list;
+            std::getline(file, list);
+            std::vector<int> cpus;
+            for (int cpu : parse_cpu_list(list)) {
+                if (std::find(allowed.begin(), allowed.end(), cpu) != allowed.end()) {
+                    cpus.push_back(cpu);
+                }
+            }
+            if (!cpus.empty()) {
+                topology.node_cpus[node] = cpus;
+            }
+        }
+#endif
+        if (topology.node_cpus.empty()) {
+            topology.node_cpus[0] = allowed.empty() ? std::vector<int>{0} : allowed;
+        }
+        return topology;
+    }
+};
+
+// Pin the calling thread to cpu. Returns false if the kernel refused.
+inline bool pin_thread(int cpu) {
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return sched_setaffinity(0, sizeof(set), &set) == 0;
+#else
+    (void)cpu;
+    return false;
+#endif
+}
+
+// Bookkeeping of the live large allocations, for report()
+struct Region {
+    size_t bytes;
+    const char* pages;  // how huge pages were requested
+    std::string placement;
+};
+
+inline std::mutex& registry_mutex() {
+    static std::mutex mutex;
+    return mutex;
+}
+
+inline std::map<void*, Region>& registry() {
+    static std::map<void*, Region> regions;
+    return regions;
+}
+
+namespace detail {
+
+inline size_t round_up(size_t bytes) { return (bytes + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE; }
+
+#ifdef __linux__
+constexpr int MPOL_BIND_MODE = 2;
+constexpr int MPOL_INTERLEAVE_MODE = 3;
+
+inline bool mbind_nodes(void* addr, size_t bytes, int mode, const std::vector<int>& nodes) {
+    unsigned long mask[16] = {};
+    for (int node : nodes) {
+        if (node >= 0 && node < 16 * 64) {
+            mask[node / 64] |= 1UL << (node % 64);
+        }
+    }
+    return syscall(SYS_mbind, addr, bytes, mode, mask, 16 * 64 + 1, 0) == 0;
+}
+
+// 2 MB aligned anonymous mapping of bytes (a multiple of 2 MB)
+inline void* map_aligned(size_t bytes) {
+    void* raw = mmap(nullptr, bytes + HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (raw == MAP_FAILED) {
+        return nullptr;
+    }
+    const uintptr_t start = reinterpret_cast<uintptr_t>(raw);
+    const uintptr_t aligned = (start + HUGE_PAGE_SIZE - 1) & ~(uintptr_t(HUGE_PAGE_SIZE) - 1);
+    if (aligned > start) {
+        munmap(raw, aligned - start);
+    }
+    const uintptr_t end = start + bytes + HUGE_PAGE_SIZE;
+    if (end > aligned + bytes) {
+        munmap(reinterpret_cast<void*>(aligned + bytes), end - aligned - bytes);
+    }
+    return reinterpret_cast<void*>(aligned);
+}
+#endif
+
+inline void* allocate(size_t bytes) {
+#ifdef __linux__
+    const size_t size = round_up(bytes);
+    const Config& cfg = config();
+    void* p = nullptr;
+    const char* pages = "4 KB";
+    if (cfg.huge_pages == HugePages::Explicit) {
+        p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (p == MAP_FAILED) {
+            p = nullptr;
+        } else {
+            pages = "2 MB (hugetlb)";
+        }
+    }
+    if (p == nullptr) {
+        p = map_aligned(size);
+        if (p == nullptr) {
+            throw std::bad_alloc();
+        }
+        if (cfg.huge_pages != HugePages::Off && madvise(p, size, MADV_HUGEPAGE) == 0) {
+            pages = "THP";
+        }
+    }
+
+    std::string placement = "first touch";
+    const int node = bound_node();
+    if (node >= 0) {
+        placement = mbind_nodes(p, size, MPOL_BIND_MODE, {node})
+            ? "bound to node " + std::to_string(node) : "first touch (mbind failed)";
+    } else if (cfg.numa == NumaPolicy::Interleave) {
+        std::vector<int> nodes;
+        for (const auto& entry : Topology::get().node_cpus) {
+            nodes.push_back(entry.first);
+        }
+        placement = mbind_nodes(p, size, MPOL_INTERLEAVE_MODE, nodes)
+            ? "interleaved" : "first touch (mbind failed)";
+    }
+
+    std::lock_guard<std::mutex> lock(registry_mutex());
+    registry()[p] = {size, pages, placement};
+    return p;
+#else
+    return ::operator new(bytes);
+#endif
+}
+
+inline void deallocate(void* p, size_t bytes) noexcept {
+#ifdef __linux__
+    {
+        std::lock_guard<std::mutex> lock(registry_mutex());
+        registry().erase(p);
+    }
+    munmap(p, round_up(bytes));
+#else
+    (void)bytes;
+    ::operator delete(p);
+#endif
+}
+
+#ifdef __linux__
+// Kilobytes of the mapping containing p backed by transparent huge pages
+inline long thp_kilobytes(void* p) {
+    std::ifstream smaps("/proc/self/smaps");
+    std::string line;
+    bool inside = false;
+    const uintptr_t addr = reinterpret_cast<uintptr_t>(p);
+    while (std::getline(smaps, line)) {
+        unsigned long start = 0;
+        unsigned long end = 0;
+        char dash = 0;
+        std::istringstream header(line);
+        if (line.find(':') == std::string::npos || line.find('-') < line.find(':')) {
+            if (header >> std::hex >> start >> dash >> end && dash == '-') {
+                inside = addr >= start && addr < end;
+                continue;
+            }
+        }
+        if (inside && line.compare(0, 14, "AnonHugePages:") == 0) {
+            return std::stol(line.substr(14));
+        }
+    }
+    return -1;
+}
+
+// Pages of [p, p + bytes) on each node, from up to 1024 evenly spaced 4 KB samples
+inline std::map<int, size_t> node_samples(void* p, size_t bytes) {
+    constexpr size_t PAGE = 4096;
+    const size_t n_pages = bytes / PAGE;
+    const size_t n_samples = std::min<size_t>(n_pages, 1024);
+    std::vector<void*> pages(n_samples);
+    std::vector<int> status(n_samples, -1);
+    for (size_t i = 0; i < n_samples; ++i) {
+        pages[i] = static_cast<char*>(p) + (i * n_pages / n_samples) * PAGE;
+    }
+    std::map<int, size_t> counts;
+    if (syscall(SYS_move_pages, 0, n_samples, pages.data(), nullptr, status.data(), 0) != 0) {
+        return counts;
+    }
+    for (int node : status) {
+        ++counts[node];  // negative: not yet touched
+    }
+    return counts;
+}
+#endif
+
+}  // namespace detail
+
+// Print the page size and node placement of every live large allocation
+inline void report(std::ostream& out) {
+    std::lock_guard<std::mutex> lock(registry_mutex());
+    const Topology& topology = Topology::get();
+    out << "Memory placement (" << topology.n_nodes() << " NUMA node"
+        << (topology.n_nodes() > 1 ? "s" : "") << ", " << registry().size()
+        << " large allocations):" << std::endl;
+    for (const auto& entry : registry()) {
+        const Region& region = entry.second;
+        out << "  " << std::setw(8) << region.bytes / (1 << 20) << " MB  pages: " << region.pages;
+#ifdef __linux__
+        if (std::string(region.pages) == "THP") {
+            const long kb = detail::thp_kilobytes(entry.first);
+            if (kb >= 0) {
+                out << " (" << kb / 1024 << " MB huge)";
+            }
+        }
+        out << "  " << region.placement << "  nodes:";
+        const auto counts = detail::node_samples(entry.first, region.bytes);
+        size_t total = 0;
+        for (const auto& count : counts) {
+            total += count.second;
+        }
+        if (total == 0) {
+            out << " unknown";
+        }
+        for (const auto& count : counts) {
+            out << ' ' << (count.first < 0 ? std::string("untouched") : std::to_string(count.first))
+                << '=' << 100 * count.second / total << '%';
+        }
+#endif
+        out << std::endl;
+    }
+}
+
+// Standard allocator: allocations of at least HUGE_PAGE_SIZE bytes get the placement
+// described above, smaller ones go to operator new
+template <typename T>
+struct Allocator {
+    using value_type = T;
+
+    Allocator() = default;
+    template <typename U>
+    Allocator(const Allocator<U>&) noexcept {}
+
+    T* allocate(size_t n) {
+        const size_t bytes = n * sizeof(T);
+        if (bytes < HUGE_PAGE_SIZE) {
+            return static_cast<T*>(::operator new(bytes, std::align_val_t(alignof(T))));
+        }
+        return static_cast<T*>(detail::allocate(bytes));
+    }
+
+    void deallocate(T* p, size_t n) noexcept {
+        const size_t bytes = n * sizeof(T);
+        if (bytes < HUGE_PAGE_SIZE) {
+            ::operator delete(p, std::align_val_t(alignof(T)));
+        } else {
+            detail::deallocate(p, bytes);
+        }
+    }
+
+    template <typename U>
+    bool operator==(const Allocator<U>&) const noexcept { return true; }
+    template <typename U>
+    bool operator!=(const Allocator<U>&) const noexcept { return false; }
+};
+
+template <typename T>
+using Vector = std::vector<T, Allocator<T>>;
+
+}  // namespace large_alloc
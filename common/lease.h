@@ -0,0 +1,787 @@
+// lease.h
+// Leases of a search space handed to worker processes, with per-lease shards merged in order
+// Author: Paul Bottinelli
+// For Black Hat EU 2025 - Cut to the QUIC: Slashing QUIC's Performance with a Hash DoS
+//
+// Threads share a process: one crash or one stuck machine ends the run. Here a coordinator
+// splits a search space of `space` items (the first differences of a diff_crypt sweep, the
+// prefixes of a meet-in-the-middle run) into leases of lease_size consecutive items,
+// numbered from 0, and hands them to worker processes, on the same machine or on others.
+// The address is a Unix socket path (anything with a '/') or host:port for TCP. TCP is
+// unauthenticated: use it on trusted networks only.
+//
+// The protocol is line-based. On connection, the coordinator sends the job: the parameters
+// every worker needs to compute the same results, as key=value fields. Then the worker
+// sends:
+//   LEASE                 answered "LEASE <id> <first> <size>", "WAIT <seconds>" (every
+//                         lease is out, ask again later) or "DONE"
+//   RENEW <id>            extends a lease by the timeout, sent every timeout / 4 seconds by
+//                         a thread of the worker while it works on the lease
+//   RESULT <id> <count>   followed by the count records of the lease, record_size bytes each
+// A lease is re-issued when its worker disconnects or stops renewing it. The first result
+// of a lease counts, later ones are dropped: results must depend on the lease only, e.g.
+// through lease_seed, and never on the worker or its threads.
+//
+// The coordinator sorts the records of a lease and writes them as a corpus file,
+// <dir>/lease-<id>.corpus (written to a temporary name, then renamed), and the job line to
+// <dir>/job. A coordinator restarted on the same directory with the same job resumes:
+// leases whose shard exists are done. The merged output is the records of leases 0, 1, 2...
+// in order, up to limit records, so it does not depend on how many workers ran, in which
+// order they finished, or how often leases were re-issued. No lease is issued past the
+// point where the leases before it hold limit records. POSIX only.
+
+#pragma once
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#include <dirent.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "corpus.h"
+
+// Fields of a job, "key=value" separated by spaces; values cannot hold spaces
+class LeaseJob {
+public:
+    LeaseJob() = default;
+
+    explicit LeaseJob(const std::string& line) {
+        std::istringstream fields(line);
+        std::string field;
+        while (fields >> field) {
+            const size_t equal = field.find('=');
+            if (equal == std::string::npos || equal == 0) {
+                throw std::invalid_argument("malformed job field '" + field + "'");
+            }
+            values_[field.substr(0, equal)] = field.substr(equal + 1);
+        }
+    }
+
+    template <typename T>
+    LeaseJob& set(const std::string& key, const T& value) {
+        std::ostringstream text;
+        text << value;
+        const std::string value_text = text.str();
+        if (value_text.empty() || value_text.find_first_of(" \t\r\n") != std::string::npos) {
+            throw std::invalid_argument("job field " + key + " cannot be empty or hold spaces");
+        }
+        values_[key] = value_text;
+        return *this;
+    }
+
+    bool has(const std::string& key) const { return values_.count(key) != 0; }
+
+    std::string get(const std::string& key) const {
+        const auto it = values_.find(key);
+        if (it == values_.end()) {
+            throw std::invalid_argument("job field " + key + " missing");
+        }
+        return it->second;
+    }
+
+    std::string get(const std::string& key, const std::string& fallback) const {
+        return has(key) ? get(key) : fallback;
+    }
+
+    uint64_t number(const std::string& key) const {
+        const std::string text = get(key);
+        size_t end = 0;
+        const uint64_t value = std::stoull(text, &end, 0);
+        if (end != text.size()) {
+            throw std::invalid_argument("job field " + key + " is not a number");
+        }
+        return value;
+    }
+
+    std::string line() const {
+        std::string text;
+        for (const auto& value : values_) {
+            text += (text.empty() ? "" : " ") + value.first + "=" + value.second;
+        }
+        return text;
+    }
+
+private:
+    std::map<std::string, std::string> values_;  // sorted: the same job gives the same line
+};
+
+struct Lease {
+    uint64_t id;
+    uint64_t first;  // items first to first + size - 1 of the search space
+    uint64_t size;
+};
+
+// Seed of the random choices made for a lease, the same on every worker (splitmix64)
+inline uint64_t lease_seed(uint64_t seed, uint64_t id) noexcept {
+    uint64_t z = seed + (id + 1) * 0x9E3779B97F4A7C15ULL;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+namespace lease_detail {
+
+constexpr size_t MAX_LINE = 1 << 16;
+constexpr uint64_t MAX_RESULT_BYTES = uint64_t(1) << 32;
+constexpr int WAIT_SECONDS = 1;
+
+// host:port for TCP, anything else is a Unix socket path
+inline bool split_tcp(const std::string& address, std::string& host, std::string& port) {
+    const size_t colon = address.rfind(':');
+    if (address.find('/') != std::string::npos || colon == std::string::npos) {
+        return false;
+    }
+    host = address.substr(0, colon);
+    port = address.substr(colon + 1);
+    if (port.empty() || port.find_first_not_of("0123456789") != std::string::npos) {
+        throw std::invalid_argument("invalid address " + address + ", expected a socket path or host:port");
+    }
+    return true;
+}
+
+inline sockaddr_un unix_address(const std::string& path) {
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (path.empty() || path.size() >= sizeof(address.sun_path)) {
+        throw std::invalid_argument("invalid socket path '" + path + "'");
+    }
+    std::strcpy(address.sun_path, path.c_str());
+    return address;
+}
+
+// what, the path or address, and the error of the last system call
+inline std::runtime_error errno_error(const std::string& what, const std::string& address) {
+    return std::runtime_error(what + " " + address + ": " + std::strerror(errno));
+}
+
+// Listening socket on address; a stale Unix socket file is replaced
+inline int listen_on(const std::string& address) {
+    std::string host, port;
+    if (!split_tcp(address, host, port)) {
+        const sockaddr_un un = unix_address(address);
+        const int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        ::unlink(address.c_str());
+        if (fd < 0 || ::bind(fd, reinterpret_cast<const sockaddr*>(&un), sizeof(un)) != 0 ||
+            ::listen(fd, 64) != 0) {
+            const auto error = errno_error("could not listen on", address);
+            if (fd >= 0) {
+                ::close(fd);
+            }
+            throw error;
+        }
+        return fd;
+    }
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_PASSIVE;
+    addrinfo* results = nullptr;
+    if (::getaddrinfo(host.empty() || host == "*" ? nullptr : host.c_str(), port.c_str(), &hints, &results) != 0) {
+        throw std::runtime_error("could not resolve " + address);
+    }
+    int fd = -1;
+    for (addrinfo* ai = results; ai && fd < 0; ai = ai->ai_next) {
+        fd = ::socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+        if (fd < 0) {
+            continue;
+        }
+        const int one = 1;
+        ::setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        if (::bind(fd, ai->ai_addr, ai->ai_addrlen) != 0 || ::listen(fd, 64) != 0) {
+            ::close(fd);
+            fd = -1;
+        }
+    }
+    ::freeaddrinfo(results);
+    if (fd < 0) {
+        throw errno_error("could not listen on", address);
+    }
+    return fd;
+}
+
+// Connected socket to address, -1 if nothing listens there (yet)
+inline int connect_to(const std::string& address) {
+    std::string host, port;
+    if (!split_tcp(address, host, port)) {
+        const sockaddr_un un = unix_address(address);
+        const int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd >= 0 && ::connect(fd, reinterpret_cast<const sockaddr*>(&un), sizeof(un)) == 0) {
+            return fd;
+        }
+        if (fd >= 0) {
+            ::close(fd);
+        }
+        return -1;
+    }
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* results = nullptr;
+    if (::getaddrinfo(host.empty() ? "localhost" : host.c_str(), port.c_str(), &hints, &results) != 0) {
+        throw std::runtime_error("could not resolve " + address);
+    }
+    int fd = -1;
+    for (addrinfo* ai = results; ai && fd < 0; ai = ai->ai_next) {
+        fd = ::socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+        if (fd >= 0 && ::connect(fd, ai->ai_addr, ai->ai_addrlen) != 0) {
+            ::close(fd);
+            fd = -1;
+        }
+    }
+    ::freeaddrinfo(results);
+    if (fd >= 0) {
+        const int one = 1;
+        ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    }
+    return fd;
+}
+
+// Write all of size bytes, false once the peer is gone
+inline bool send_all(int fd, const void* data, size_t size) {
+    const char* bytes = static_cast<const char*>(data);
+    while (size > 0) {
+        const ssize_t n = ::send(fd, bytes, size, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        bytes += n;
+        size -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+inline bool send_line(int fd, const std::string& line) {
+    const std::string text = line + "\n";
+    return send_all(fd, text.data(), text.size());
+}
+
+inline bool file_exists(const std::string& path) {
+    struct stat st;
+    return ::stat(path.c_str(), &st) == 0;
+}
+
+}  // namespace lease_detail
+
+// Splits a search space into leases, serves them until the merged output is complete, and
+// writes the shards. info describes the records in the shard files.
+class LeaseCoordinator {
+public:
+    struct Config {
+        std::string address;
+        std::string shard_dir;
+        uint64_t space = 0;            // items in the search space
+        uint64_t lease_size = 0;       // items per lease
+        size_t record_size = 0;        // bytes per record
+        uint64_t limit = UINT64_MAX;   // records in the merged output
+        double timeout = 30;           // seconds without renewal before a lease is re-issued
+    };
+
+    LeaseCoordinator(const Config& config, const LeaseJob& job, const CorpusInfo& info)
+        : config_(config), info_(info) {
+        if (config.space == 0 || config.lease_size == 0 || config.record_size == 0) {
+            throw std::invalid_argument("empty search space, lease or record");
+        }
+        if (config.timeout <= 0) {
+            throw std::invalid_argument("lease timeout must be positive");
+        }
+        n_leases_ = (config.space - 1) / config.lease_size + 1;
+        job_ = job;
+        job_.set("space", config.space)
+            .set("lease_size", config.lease_size)
+            .set("record_size", config.record_size)
+            .set("timeout", config.timeout);
+        open_shards();
+        listener_ = lease_detail::listen_on(config.address);
+    }
+
+    LeaseCoordinator(const LeaseCoordinator&) = delete;
+    LeaseCoordinator& operator=(const LeaseCoordinator&) = delete;
+
+    ~LeaseCoordinator() {
+        for (auto& connection : connections_) {
+            ::close(connection.fd);
+        }
+        if (listener_ >= 0) {
+            ::close(listener_);
+            std::string host, port;
+            if (!lease_detail::split_tcp(config_.address, host, port)) {
+                ::unlink(config_.address.c_str());
+            }
+        }
+    }
+
+    uint64_t leases() const noexcept { return n_leases_; }
+    // Leases done from lease 0 on, and the records they hold
+    uint64_t leases_done() const noexcept { return frontier_; }
+    uint64_t records() const noexcept { return std::min(frontier_records_, config_.limit); }
+    const LeaseJob& job() const noexcept { return job_; }
+
+    // Serve the workers until the leases of the merged output are done, logging to log
+    void run(std::ostream& log) {
+        log << "Coordinating " << n_leases_ << " leases of " << config_.lease_size << " on "
+            << config_.address << " (" << frontier_ + done_.size() << " done in " << config_.shard_dir
+            << ")" << std::endl;
+        while (!finished()) {
+            std::vector<pollfd> fds(1 + connections_.size());
+            fds[0] = {listener_, POLLIN, 0};
+            for (size_t i = 0; i < connections_.size(); ++i) {
+                fds[i + 1] = {connections_[i].fd, POLLIN, 0};
+            }
+            if (::poll(fds.data(), fds.size(), 250) < 0 && errno != EINTR) {
+                throw std::runtime_error(std::string("poll failed: ") + std::strerror(errno));
+            }
+            if (fds[0].revents & POLLIN) {
+                accept_worker(log);
+            }
+            for (size_t i = fds.size() - 1; i > 0; --i) {
+                if ((fds[i].revents & (POLLIN | POLLHUP | POLLERR)) && !serve(connections_[i - 1], log)) {
+                    drop(i - 1, log);
+                }
+            }
+            expire(log);
+        }
+        for (auto& connection : connections_) {
+            lease_detail::send_line(connection.fd, "DONE");
+            ::close(connection.fd);
+        }
+        connections_.clear();
+        log << "Leases 0 to " << frontier_ - 1 << " done: " << records() << " records to merge" << std::endl;
+    }
+
+    // Call emit(data, size) on the records of the merged output, in order
+    template <typename Emit>
+    uint64_t merge(Emit emit) const {
+        uint64_t n = 0;
+        for (uint64_t id = 0; id < frontier_ && n < config_.limit; ++id) {
+            const Corpus shard(shard_path(id));
+            for (uint64_t i = 0; i < shard.size() && n < config_.limit; ++i, ++n) {
+                const CorpusRecord record = shard[i];
+                emit(record.data, record.size);
+            }
+        }
+        return n;
+    }
+
+private:
+    struct Issued {
+        int fd;
+        std::chrono::steady_clock::time_point deadline;
+    };
+
+    struct Connection {
+        int fd;
+        uint64_t worker;
+        std::string input;
+        bool in_result = false;   // reading the records of a RESULT
+        uint64_t result_id = 0;
+        uint64_t result_bytes = 0;
+    };
+
+    Config config_;
+    CorpusInfo info_;
+    LeaseJob job_;
+    uint64_t n_leases_ = 0;
+    int listener_ = -1;
+    std::vector<Connection> connections_;
+    uint64_t workers_ = 0;                  // workers seen, to name them in the log
+    uint64_t next_ = 0;                     // first lease never issued
+    std::set<uint64_t> reissue_;            // leases to issue again, lowest first
+    std::map<uint64_t, Issued> issued_;
+    std::map<uint64_t, uint64_t> done_;     // records of the leases done past the frontier
+    uint64_t frontier_ = 0;                 // leases 0 to frontier_ - 1 are done
+    uint64_t frontier_records_ = 0;
+
+    std::string shard_path(uint64_t id) const {
+        char name[64];
+        std::snprintf(name, sizeof(name), "/lease-%08llu.corpus", static_cast<unsigned long long>(id));
+        return config_.shard_dir + name;
+    }
+
+    bool finished() const noexcept { return frontier_ == n_leases_ || frontier_records_ >= config_.limit; }
+
+    // Records of the done leases below next_; once they reach the limit, the output ends
+    // before next_
+    bool enough_issued() const noexcept {
+        uint64_t total = frontier_records_;
+        for (const auto& lease : done_) {
+            if (lease.first < next_) {
+                total += lease.second;
+            }
+        }
+        return total >= config_.limit;
+    }
+
+    // Check or write the job of the directory and collect the shards already there
+    void open_shards() {
+        if (::mkdir(config_.shard_dir.c_str(), 0755) != 0 && errno != EEXIST) {
+            throw lease_detail::errno_error("could not create shard directory", config_.shard_dir);
+        }
+        const std::string job_path = config_.shard_dir + "/job";
+        const std::string line = job_.line();
+        if (lease_detail::file_exists(job_path)) {
+            std::ifstream file(job_path);
+            std::string existing;
+            std::getline(file, existing);
+            if (existing != line) {
+                throw std::runtime_error("shard directory " + config_.shard_dir +
+                                         " holds the shards of another job, remove it or use another");
+            }
+        } else {
+            std::ofstream file(job_path);
+            file << line << "\n";
+            if (!file) {
+                throw std::runtime_error("could not write " + job_path);
+            }
+        }
+        DIR* dir = ::opendir(config_.shard_dir.c_str());
+        if (!dir) {
+            throw lease_detail::errno_error("could not read shard directory", config_.shard_dir);
+        }
+        while (const dirent* entry = ::readdir(dir)) {
+            unsigned long long id;
+            char tail;
+            if (std::sscanf(entry->d_name, "lease-%llu.corpu%c", &id, &tail) != 2 || tail != 's' ||
+                id >= n_leases_ || shard_path(id) != config_.shard_dir + "/" + entry->d_name) {
+                continue;
+            }
+            try {
+                const Corpus shard(shard_path(id));
+                done_[id] = shard.size();
+            } catch (const std::exception&) {
+                // Damaged: the lease is run again
+            }
+        }
+        ::closedir(dir);
+        advance();
+        next_ = frontier_;
+        for (const auto& lease : done_) {
+            for (; next_ < lease.first; ++next_) {
+                reissue_.insert(next_);
+            }
+            next_ = lease.first + 1;
+        }
+    }
+
+    void advance() {
+        for (auto it = done_.find(frontier_); it != done_.end(); it = done_.find(frontier_)) {
+            frontier_records_ += it->second;
+            ++frontier_;
+            done_.erase(it);
+        }
+    }
+
+    void accept_worker(std::ostream& log) {
+        const int fd = ::accept(listener_, nullptr, nullptr);
+        if (fd < 0) {
+            return;
+        }
+        Connection connection{fd, ++workers_, std::string()};
+        if (!lease_detail::send_line(fd, "JOB " + job_.line())) {
+            ::close(fd);
+            return;
+        }
+        connections_.push_back(connection);
+        log << "Worker " << connection.worker << " connected (" << connections_.size() << " connected)" << std::endl;
+    }
+
+    // Return the leases of the connection at index to the pool and close it
+    void drop(size_t index, std::ostream& log) {
+        const Connection& connection = connections_[index];
+        size_t returned = 0;
+        for (auto it = issued_.begin(); it != issued_.end();) {
+            if (it->second.fd == connection.fd) {
+                reissue_.insert(it->first);
+                it = issued_.erase(it);
+                ++returned;
+            } else {
+                ++it;
+            }
+        }
+        log << "Worker " << connection.worker << " disconnected";
+        if (returned != 0) {
+            log << ", " << returned << " lease(s) to re-issue";
+        }
+        log << std::endl;
+        ::close(connection.fd);
+        connections_.erase(connections_.begin() + static_cast<std::ptrdiff_t>(index));
+    }
+
+    void expire(std::ostream& log) {
+        const auto now = std::chrono::steady_clock::now();
+        for (auto it = issued_.begin(); it != issued_.end();) {
+            if (it->second.deadline < now) {
+                log << "Lease " << it->first << " expired, to re-issue" << std::endl;
+                reissue_.insert(it->first);
+                it = issued_.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+
+    std::chrono::steady_clock::time_point deadline() const {
+        return std::chrono::steady_clock::now() +
+               std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                   std::chrono::duration<double>(config_.timeout));
+    }
+
+    // Read and handle what the worker sent; false to drop it
+    bool serve(Connection& connection, std::ostream& log) {
+        char buffer[1 << 16];
+        const ssize_t n = ::recv(connection.fd, buffer, sizeof(buffer), 0);
+        if (n <= 0) {
+            return false;
+        }
+        connection.input.append(buffer, static_cast<size_t>(n));
+        for (;;) {
+            if (connection.in_result) {
+                if (connection.input.size() < connection.result_bytes) {
+                    return true;
+                }
+                complete(connection, log);
+                connection.input.erase(0, connection.result_bytes);
+                connection.in_result = false;
+                continue;
+            }
+            const size_t newline = connection.input.find('\n');
+            if (newline == std::string::npos) {
+                return connection.input.size() <= lease_detail::MAX_LINE;
+            }
+            std::istringstream line(connection.input.substr(0, newline));
+            connection.input.erase(0, newline + 1);
+            std::string command;
+            uint64_t id = 0;
+            line >> command;
+            if (command == "LEASE") {
+                if (!lease_detail::send_line(connection.fd, issue(connection))) {
+                    return false;
+                }
+            } else if (command == "RENEW" && line >> id) {
+                const auto it = issued_.find(id);
+                if (it != issued_.end() && it->second.fd == connection.fd) {
+                    it->second.deadline = deadline();
+                }
+            } else if (command == "RESULT" && line >> id >> connection.result_bytes &&
+                       id < n_leases_ &&
+                       connection.result_bytes <= lease_detail::MAX_RESULT_BYTES / config_.record_size) {
+                connection.result_id = id;
+                connection.result_bytes *= config_.record_size;
+                connection.in_result = true;
+            } else {
+                log << "Worker " << connection.worker << " sent an invalid request" << std::endl;
+                return false;
+            }
+        }
+    }
+
+    std::string issue(const Connection& connection) {
+        if (finished()) {
+            return "DONE";
+        }
+        uint64_t id;
+        if (!reissue_.empty()) {
+            id = *reissue_.begin();
+            reissue_.erase(reissue_.begin());
+        } else if (next_ < n_leases_ && !enough_issued()) {
+            id = next_++;
+        } else {
+            return "WAIT " + std::to_string(lease_detail::WAIT_SECONDS);
+        }
+        issued_[id] = {connection.fd, deadline()};
+        const uint64_t first = id * config_.lease_size;
+        const uint64_t size = std::min(config_.lease_size, config_.space - first);
+        return "LEASE " + std::to_string(id) + " " + std::to_string(first) + " " + std::to_string(size);
+    }
+
+    // The records of connection.result_id are the first result_bytes bytes of its input
+    void complete(const Connection& connection, std::ostream& log) {
+        const uint64_t id = connection.result_id;
+        if (id < frontier_ || done_.count(id) != 0) {
+            return;  // done already, by a worker it was re-issued to or away from
+        }
+        const size_t size = config_.record_size;
+        const uint64_t count = connection.result_bytes / size;
+        const uint8_t* data = reinterpret_cast<const uint8_t*>(connection.input.data());
+        std::vector<const uint8_t*> sorted(count);
+        for (uint64_t i = 0; i < count; ++i) {
+            sorted[i] = data + i * size;
+        }
+        std::sort(sorted.begin(), sorted.end(), [size](const uint8_t* a, const uint8_t* b) {
+            return std::memcmp(a, b, size) < 0;
+        });
+
+        CorpusInfo info = info_;
+        info.param("lease", id)
+            .param("first", id * config_.lease_size)
+            .param("size", std::min(config_.lease_size, config_.space - id * config_.lease_size));
+        const std::string path = shard_path(id);
+        {
+            CorpusWriter shard(path + ".tmp", info, size);
+            for (const uint8_t* record : sorted) {
+                shard.add(record, size);
+            }
+            shard.finish();
+        }
+        if (std::rename((path + ".tmp").c_str(), path.c_str()) != 0) {
+            throw lease_detail::errno_error("could not write shard", path);
+        }
+
+        issued_.erase(id);
+        reissue_.erase(id);
+        done_[id] = count;
+        advance();
+        log << "Lease " << id << " done by worker " << connection.worker << ": " << count
+            << " records (" << frontier_ << "/" << n_leases_ << " leases in order, " << records()
+            << " records, " << issued_.size() << " out)" << std::endl;
+    }
+};
+
+// Worker side: the job, then leases until the coordinator is done
+class LeaseWorker {
+public:
+    // Connect to the coordinator, retrying for up to wait seconds
+    explicit LeaseWorker(const std::string& address, double wait = 10) {
+        const auto give_up = std::chrono::steady_clock::now() +
+                             std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                                 std::chrono::duration<double>(wait));
+        while ((fd_ = lease_detail::connect_to(address)) < 0) {
+            if (std::chrono::steady_clock::now() >= give_up) {
+                throw lease_detail::errno_error("could not connect to coordinator", address);
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        }
+        std::string line;
+        if (!read_line(line) || line.compare(0, 4, "JOB ") != 0) {
+            ::close(fd_);
+            throw std::runtime_error("no job from coordinator " + address);
+        }
+        job_ = LeaseJob(line.substr(4));
+        record_size_ = static_cast<size_t>(job_.number("record_size"));
+        renew_interval_ = std::stod(job_.get("timeout")) / 4;
+        heartbeat_ = std::thread([this]() { renew(); });
+    }
+
+    LeaseWorker(const LeaseWorker&) = delete;
+    LeaseWorker& operator=(const LeaseWorker&) = delete;
+
+    ~LeaseWorker() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        wake_.notify_all();
+        heartbeat_.join();
+        ::close(fd_);
+    }
+
+    const LeaseJob& job() const noexcept { return job_; }
+    size_t record_size() const noexcept { return record_size_; }
+
+    // Next lease to work on; false once the coordinator is done or gone
+    bool next(Lease& lease) {
+        for (;;) {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                if (!lease_detail::send_line(fd_, "LEASE")) {
+                    return false;
+                }
+            }
+            std::string line;
+            if (!read_line(line)) {
+                return false;
+            }
+            std::istringstream answer(line);
+            std::string command;
+            answer >> command;
+            if (command == "LEASE" && answer >> lease.id >> lease.first >> lease.size) {
+                std::lock_guard<std::mutex> lock(mutex_);
+                current_ = lease.id;
+                leased_ = true;
+                return true;
+            }
+            int seconds = 0;
+            if (command == "WAIT" && answer >> seconds) {
+                std::this_thread::sleep_for(std::chrono::seconds(seconds));
+                continue;
+            }
+            return false;  // DONE
+        }
+    }
+
+    // Send the records found in lease, record_size() bytes each; false once the
+    // coordinator is gone
+    bool complete(const Lease& lease, const std::vector<uint8_t>& records) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        leased_ = false;
+        const std::string header = "RESULT " + std::to_string(lease.id) + " " +
+                                   std::to_string(records.size() / record_size_) + "\n";
+        return lease_detail::send_all(fd_, header.data(), header.size()) &&
+               lease_detail::send_all(fd_, records.data(), records.size() / record_size_ * record_size_);
+    }
+
+private:
+    int fd_ = -1;
+    LeaseJob job_;
+    size_t record_size_ = 0;
+    double renew_interval_ = 1;
+    std::string input_;
+    std::thread heartbeat_;
+    std::mutex mutex_;              // socket writes and the fields below
+    std::condition_variable wake_;
+    bool stop_ = false;
+    bool leased_ = false;
+    uint64_t current_ = 0;
+
+    bool read_line(std::string& line) {
+        size_t newline;
+        while ((newline = input_.find('\n')) == std::string::npos) {
+            char buffer[4096];
+            const ssize_t n = ::recv(fd_, buffer, sizeof(buffer), 0);
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n <= 0 || input_.size() > lease_detail::MAX_LINE) {
+                return false;
+            }
+            input_.append(buffer, static_cast<size_t>(n));
+        }
+        line = input_.substr(0, newline);
+        input_.erase(0, newline + 1);
+        return true;
+    }
+
+    void renew() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        const auto interval = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+            std::chrono::duration<double>(renew_interval_));
+        while (!wake_.wait_for(lock, interval, [this]() { return stop_; })) {
+            if (leased_) {
+                lease_detail::send_line(fd_, "RENEW " + std::to_string(current_));
+            }
+        }
+    }
+};
@@ -0,0 +1,352 @@
+// shm_ring.h
+// Shared-memory ring of fixed-size collision records between a generator and a consumer
+// Author: Paul Bottinelli
+// For Black Hat EU 2025 - Cut to the QUIC: Slashing QUIC's Performance with a Hash DoS
+//
+// A corpus file (corpus.h) is written in full before a benchmark reads it back. With a ring,
+// a generator (--shm name) publishes each record into POSIX shared memory as it finds it,
+// and a consumer in another process reads the records in place, without files, copies or
+// parsing. The shared object /dev/shm/<name> is laid out as:
+//
+//   0     magic "HASHRING", version, header size (uint32 each but the magic)
+//   16    record_size, capacity (records, a power of two), target, target_mask, seed
+//   56    hash_bits, ready (uint32)
+//   64    hash model, as in a corpus header, NUL-padded to 192 bytes
+//   256   head: records published by the producer (uint64, own cache line)
+//   320   tail: records released by the consumer (uint64, own cache line)
+//   384   closed: the producer is done (uint32), detached: the consumer is gone (uint32),
+//         aborted: the stream is incomplete (uint32), producer pid (int32)
+//   512   capacity records of record_size bytes, then 64 bytes of padding
+//
+// Single producer, single consumer. Record i lives in slot i % capacity. The producer
+// writes a record, then advances head with a release store; the consumer reads head with
+// an acquire load, hands out the records up to it in place, and advances tail once done
+// with them. A producer that gets capacity records ahead of the consumer waits
+// (backpressure), spinning briefly, then yielding, then sleeping. The consumer waits for
+// the ring to be created and ready, unlinks its name once attached, and sees the end of
+// the stream once closed is set and it has released every record. A producer whose
+// consumer detached early gets an exception instead of waiting forever.
+//
+// aborted is set from creation and cleared only by finish(), just before closed: a
+// producer that fails or is destroyed without finishing closes the ring with aborted still
+// set, and the consumer throws once it has drained the records, rather than taking a
+// truncated stream for a complete one. A consumer waiting on an empty ring also throws once
+// the producer process no longer exists (killed, or crashed before closing).
+//
+// common/shm_ring.py is the producer side for the Python generators. Linux and other
+// POSIX systems only.
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <cerrno>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "corpus.h"
+
+#define SHM_RING_MAGIC "HASHRING"
+#define SHM_RING_VERSION 2
+
+struct ShmRingHeader {
+    char magic[8];             // SHM_RING_MAGIC
+    uint32_t version;          // SHM_RING_VERSION
+    uint32_t header_size;      // sizeof(ShmRingHeader)
+    uint64_t record_size;
+    uint64_t capacity;         // records, a power of two
+    uint64_t target;
+    uint64_t target_mask;
+    uint64_t seed;
+    uint32_t hash_bits;
+    std::atomic<uint32_t> ready;
+    char model[192];
+    alignas(64) std::atomic<uint64_t> head;
+    alignas(64) std::atomic<uint64_t> tail;
+    alignas(64) std::atomic<uint32_t> closed;
+    std::atomic<uint32_t> detached;
+    std::atomic<uint32_t> aborted;   // cleared by ShmRingWriter::finish() only
+    int32_t producer_pid;
+    char reserved[112];
+};
+static_assert(sizeof(ShmRingHeader) == 512, "ring header layout");
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "ring counters shared between processes");
+
+namespace shm_ring_detail {
+
+constexpr size_t PADDING = 64;                             // readable bytes past the last slot
+constexpr size_t DEFAULT_BYTES = size_t(1) << 24;          // ring size when not given
+
+inline std::string object_name(const std::string& name) {
+    if (name.empty() || name.find('/') != std::string::npos) {
+        throw std::invalid_argument("invalid shared memory ring name '" + name + "'");
+    }
+    return "/" + name;
+}
+
+inline size_t mapping_size(uint64_t record_size, uint64_t capacity) {
+    return sizeof(ShmRingHeader) + static_cast<size_t>(record_size * capacity) + PADDING;
+}
+
+// Spin, then yield, then sleep while the other side catches up
+class Backoff {
+public:
+    void wait() {
+        if (rounds_ < 16) {
+            for (int i = 0; i < 32; ++i) {
+#if defined(__x86_64__) || defined(__i386__)
+                __builtin_ia32_pause();
+#endif
+            }
+        } else if (rounds_ < 32) {
+            std::this_thread::yield();
+        } else {
+            std::this_thread::sleep_for(std::chrono::microseconds(50));
+        }
+        ++rounds_;
+    }
+
+    void reset() noexcept { rounds_ = 0; }
+
+    // Sleeping, and due for an occasional check that the other side is still there
+    bool idle() const noexcept { return rounds_ >= 32 && rounds_ % 256 == 0; }
+
+private:
+    unsigned rounds_ = 0;
+};
+
+}  // namespace shm_ring_detail
+
+// Producer side: creates the ring, replacing a stale one of the same name. capacity is in
+// records and rounded down to a power of two; 0 sizes the ring to about 16 MB.
+class ShmRingWriter {
+public:
+    ShmRingWriter(const std::string& name, const CorpusInfo& info, size_t record_size, size_t capacity = 0)
+        : name_(shm_ring_detail::object_name(name)) {
+        if (record_size == 0) {
+            throw std::invalid_argument("shared memory rings hold fixed-size records");
+        }
+        if (info.model.size() >= sizeof(ShmRingHeader::model)) {
+            throw std::invalid_argument("hash model too long for a shared memory ring");
+        }
+        if (capacity == 0) {
+            capacity = std::max<size_t>(shm_ring_detail::DEFAULT_BYTES / record_size, 2);
+        }
+        size_t slots = 2;
+        while (slots * 2 <= capacity) {
+            slots *= 2;
+        }
+        size_ = shm_ring_detail::mapping_size(record_size, slots);
+
+        ::shm_unlink(name_.c_str());
+        const int fd = ::shm_open(name_.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+        if (fd < 0) {
+            throw std::runtime_error("could not create shared memory ring '" + name + "'");
+        }
+        if (::ftruncate(fd, static_cast<off_t>(size_)) != 0) {
+            ::close(fd);
+            ::shm_unlink(name_.c_str());
+            throw std::runtime_error("could not size shared memory ring '" + name + "'");
+        }
+        void* p = ::mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (p == MAP_FAILED) {
+            ::shm_unlink(name_.c_str());
+            throw std::runtime_error("could not map shared memory ring '" + name + "'");
+        }
+        // The mapping is zero-filled: head, tail and the flags start at 0, but for aborted
+        header_ = static_cast<ShmRingHeader*>(p);
+        std::memcpy(header_->magic, SHM_RING_MAGIC, sizeof(header_->magic));
+        header_->version = SHM_RING_VERSION;
+        header_->header_size = sizeof(ShmRingHeader);
+        header_->record_size = record_size;
+        header_->capacity = slots;
+        header_->target = info.target;
+        header_->target_mask = info.target_mask;
+        header_->seed = info.seed;
+        header_->hash_bits = info.hash_bits;
+        std::memcpy(header_->model, info.model.data(), info.model.size());
+        header_->aborted.store(1, std::memory_order_relaxed);
+        header_->producer_pid = static_cast<int32_t>(::getpid());
+        slots_ = reinterpret_cast<uint8_t*>(header_ + 1);
+        header_->ready.store(1, std::memory_order_release);
+    }
+
+    ShmRingWriter(const ShmRingWriter&) = delete;
+    ShmRingWriter& operator=(const ShmRingWriter&) = delete;
+
+    // Without finish(), the ring is closed as aborted
+    ~ShmRingWriter() {
+        header_->closed.store(1, std::memory_order_release);
+        ::munmap(header_, size_);
+    }
+
+    // Copy a record into the next slot, waiting while the ring is full
+    void add(const uint8_t* data, size_t size) {
+        if (size != header_->record_size) {
+            throw std::invalid_argument("ring record of " + std::to_string(size) + " bytes, expected " +
+                                        std::to_string(header_->record_size));
+        }
+        shm_ring_detail::Backoff backoff;
+        while (head_ - header_->tail.load(std::memory_order_acquire) >= header_->capacity) {
+            if (header_->detached.load(std::memory_order_acquire)) {
+                throw std::runtime_error("the consumer of shared memory ring '" + name_.substr(1) + "' detached");
+            }
+            backoff.wait();
+        }
+        std::memcpy(slots_ + (head_ & (header_->capacity - 1)) * size, data, size);
+        header_->head.store(++head_, std::memory_order_release);
+    }
+
+    // Mark the successful end of the stream; the consumer drains the ring, then stops
+    void finish() noexcept {
+        header_->aborted.store(0, std::memory_order_relaxed);
+        header_->closed.store(1, std::memory_order_release);
+    }
+
+    uint64_t size() const noexcept { return head_; }
+    uint64_t capacity() const noexcept { return header_->capacity; }
+
+private:
+    std::string name_;
+    ShmRingHeader* header_ = nullptr;
+    uint8_t* slots_ = nullptr;
+    size_t size_ = 0;
+    uint64_t head_ = 0;
+};
+
+// Consumer side: attaches to the ring of a producer, created before or within timeout
+// seconds, and hands out its records in place
+class ShmRing {
+public:
+    explicit ShmRing(const std::string& name, double timeout = 10.0) : name_(shm_ring_detail::object_name(name)) {
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::duration<double>(timeout);
+        shm_ring_detail::Backoff backoff;
+        for (;;) {
+            if (attach()) {
+                break;
+            }
+            if (std::chrono::steady_clock::now() > deadline) {
+                throw std::runtime_error("no shared memory ring '" + name + "' after " + std::to_string(timeout) + " s");
+            }
+            backoff.wait();
+        }
+        ::shm_unlink(name_.c_str());
+        slots_ = reinterpret_cast<const uint8_t*>(header_ + 1);
+    }
+
+    ShmRing(const ShmRing&) = delete;
+    ShmRing& operator=(const ShmRing&) = delete;
+
+    ~ShmRing() {
+        header_->detached.store(1, std::memory_order_release);
+        ::munmap(header_, size_);
+    }
+
+    std::string model() const { return std::string(header_->model, ::strnlen(header_->model, sizeof(header_->model))); }
+    uint64_t target() const noexcept { return header_->target; }
+    uint64_t target_mask() const noexcept { return header_->target_mask; }
+    uint64_t seed() const noexcept { return header_->seed; }
+    unsigned hash_bits() const noexcept { return header_->hash_bits; }
+    size_t record_size() const noexcept { return static_cast<size_t>(header_->record_size); }
+    uint64_t capacity() const noexcept { return header_->capacity; }
+
+    // Records released so far, i.e. the index of the next record acquire() returns
+    uint64_t position() const noexcept { return tail_; }
+
+    // Wait for records and return up to max of them, contiguous in the ring, at data; 0 at
+    // the end of the stream. They stay valid until released. Throws at the end of an
+    // aborted stream, or when the producer is gone without closing the ring.
+    size_t acquire(size_t max, const uint8_t*& data) {
+        shm_ring_detail::Backoff backoff;
+        uint64_t head;
+        while ((head = header_->head.load(std::memory_order_acquire)) == tail_) {
+            if (header_->closed.load(std::memory_order_acquire)) {
+                // Records published just before closing
+                head = header_->head.load(std::memory_order_acquire);
+                if (head != tail_) {
+                    break;
+                }
+                if (header_->aborted.load(std::memory_order_relaxed)) {
+                    throw std::runtime_error("the producer of shared memory ring '" + name_.substr(1) +
+                                             "' aborted after " + std::to_string(tail_) + " records");
+                }
+                return 0;
+            }
+            if (backoff.idle() && !producer_alive()) {
+                throw std::runtime_error("the producer of shared memory ring '" + name_.substr(1) +
+                                         "' exited without closing it");
+            }
+            backoff.wait();
+        }
+        const uint64_t slot = tail_ & (header_->capacity - 1);
+        data = slots_ + slot * header_->record_size;
+        return static_cast<size_t>(std::min<uint64_t>({head - tail_, header_->capacity - slot, max}));
+    }
+
+    // Hand the first n acquired records back to the producer
+    void release(size_t n) noexcept {
+        tail_ += n;
+        header_->tail.store(tail_, std::memory_order_release);
+    }
+
+    // End of the readable memory: batch hashers may read up to here past the last slot
+    const uint8_t* limit() const noexcept { return reinterpret_cast<const uint8_t*>(header_) + size_; }
+
+private:
+    std::string name_;
+    ShmRingHeader* header_ = nullptr;
+    const uint8_t* slots_ = nullptr;
+    size_t size_ = 0;
+    uint64_t tail_ = 0;
+
+    // False once the producer process is gone; closed is checked again, as it may have
+    // finished just before exiting
+    bool producer_alive() const noexcept {
+        const pid_t pid = static_cast<pid_t>(header_->producer_pid);
+        return pid <= 0 || ::kill(pid, 0) == 0 || errno != ESRCH ||
+               header_->closed.load(std::memory_order_acquire);
+    }
+
+    // Map the ring once it exists and its header is written
+    bool attach() {
+        const int fd = ::shm_open(name_.c_str(), O_RDWR, 0);
+        if (fd < 0) {
+            return false;
+        }
+        struct stat st;
+        if (::fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(ShmRingHeader)) {
+            ::close(fd);
+            return false;
+        }
+        size_ = static_cast<size_t>(st.st_size);
+        void* p = ::mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (p == MAP_FAILED) {
+            throw std::runtime_error("could not map shared memory ring '" + name_.substr(1) + "'");
+        }
+        header_ = static_cast<ShmRingHeader*>(p);
+        if (!header_->ready.load(std::memory_order_acquire)) {
+            ::munmap(p, size_);
+            return false;
+        }
+        if (std::memcmp(header_->magic, SHM_RING_MAGIC, sizeof(header_->magic)) != 0 ||
+            header_->version != SHM_RING_VERSION || header_->header_size != sizeof(ShmRingHeader) ||
+            header_->record_size == 0 || header_->capacity == 0 ||
+            (header_->capacity & (header_->capacity - 1)) != 0 ||
+            size_ < shm_ring_detail::mapping_size(header_->record_size, header_->capacity)) {
+            ::munmap(p, size_);
+            throw std::runtime_error("invalid shared memory ring '" + name_.substr(1) + "'");
+        }
+        return true;
+    }
+};
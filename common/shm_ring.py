@@ -0,0 +1,112 @@
+# shm_ring.py
+# Producer side of the shared-memory ring of collision records (see shm_ring.h)
+# Author: Paul Bottinelli
+# For Black Hat EU 2025 - Cut to the QUIC: Slashing QUIC's Performance with a Hash DoS
+#
+# Same layout and protocol as common/shm_ring.h, through /dev/shm: a record is copied into
+# its slot, then head is advanced with one aligned 8-byte store. x86 keeps stores in
+# order, which is what the consumer's acquire load of head relies on; other architectures
+# need the native producer. Linux only.
+#
+# The ring is created aborted; finish() clears that flag as it closes the ring, so a stream
+# closed by close(), or by leaving a with block on an exception, reads as incomplete.
+
+import mmap
+import os
+import struct
+import time
+
+MAGIC = b'HASHRING'
+VERSION = 2
+HEADER_SIZE = 512
+HEADER = struct.Struct('<8sIIQQQQQI')   # up to, but excluding, ready
+READY_OFFSET = 60
+MODEL_OFFSET = 64
+MODEL_SIZE = 192
+HEAD_OFFSET = 256
+TAIL_OFFSET = 320
+CLOSED_OFFSET = 384
+DETACHED_OFFSET = 388
+ABORTED_OFFSET = 392
+PID_OFFSET = 396
+PADDING = 64
+DEFAULT_BYTES = 1 << 24
+
+
+class ShmRingWriter:
+    """Publish fixed-size records into a shared-memory ring, waiting while it is full."""
+
+    def __init__(self, name, model, record_size, target=0, hash_bits=32, target_mask=None,
+                 seed=0, capacity=0):
+        if not name or '/' in name:
+            raise ValueError(f"invalid shared memory ring name '{name}'")
+        if len(model.encode()) >= MODEL_SIZE:
+            raise ValueError("hash model too long for a shared memory ring")
+        if record_size <= 0:
+            raise ValueError("shared memory rings hold fixed-size records")
+        self.name = name
+        self.record_size = record_size
+        capacity = capacity or max(DEFAULT_BYTES // record_size, 2)
+        self.capacity = 1 << max(capacity.bit_length() - 1, 1)
+        self.count = 0
+        size = HEADER_SIZE + self.capacity * record_size + PADDING
+
+        path = os.path.join('/dev/shm', name)
+        try:
+            os.unlink(path)
+        except FileNotFoundError:
+            pass
+        fd = os.open(path, os.O_RDWR | os.O_CREAT | os.O_EXCL, 0o600)
+        try:
+            os.ftruncate(fd, size)
+            self._map = mmap.mmap(fd, size)
+        finally:
+            os.close(fd)
+        self._words = memoryview(self._map)[:HEADER_SIZE].cast('Q')
+        self._flags = memoryview(self._map)[:HEADER_SIZE].cast('I')
+        HEADER.pack_into(self._map, 0, MAGIC, VERSION, HEADER_SIZE, record_size, self.capacity,
+                         target, (1 << 64) - 1 if target_mask is None else target_mask, seed,
+                         hash_bits)
+        self._map[MODEL_OFFSET:MODEL_OFFSET + len(model)] = model.encode()
+        self._flags[ABORTED_OFFSET // 4] = 1
+        self._flags[PID_OFFSET // 4] = os.getpid()
+        self._flags[READY_OFFSET // 4] = 1
+
+    def add(self, record):
+        if len(record) != self.record_size:
+            raise ValueError(f"ring record of {len(record)} bytes, expected {self.record_size}")
+        delay = 0
+        while self.count - self._words[TAIL_OFFSET // 8] >= self.capacity:
+            if self._flags[DETACHED_OFFSET // 4]:
+                raise RuntimeError(f"the consumer of shared memory ring '{self.name}' detached")
+            time.sleep(delay)
+            delay = min(delay * 2 or 1e-5, 1e-3)
+        start = HEADER_SIZE + (self.count & (self.capacity - 1)) * self.record_size
+        self._map[start:start + self.record_size] = record
+        self.count += 1
+        self._words[HEAD_OFFSET // 8] = self.count
+
+    def finish(self):
+        """Mark the successful end of the stream; the consumer drains the ring, then stops."""
+        if self._map is not None:
+            self._flags[ABORTED_OFFSET // 4] = 0
+        self.close()
+
+    def close(self):
+        """Close the ring; unless finish() was called, the consumer sees an aborted stream."""
+        if self._map is None:
+            return
+        self._flags[CLOSED_OFFSET // 4] = 1
+        self._words.release()
+        self._flags.release()
+        self._map.close()
+        self._map = None
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, exc_type, exc, traceback):
+        if exc_type is None:
+            self.finish()
+        else:
+            self.close()
@@ -0,0 +1,608 @@
+// verify_corpus.cpp
+// Standalone verifier of collision corpus files (common/corpus.h)
+// Author: Paul Bottinelli
+// For Black Hat EU 2025 - Cut to the QUIC: Slashing QUIC's Performance with a Hash DoS
+//
+// Maps a corpus, builds a hasher for the model declared in its header, and checks on all
+// cores that every record hashes to the declared target on the bits of the target mask
+// (the whole digest, or a bucket index). Joint collision corpora are also checked against
+// their second hash. Fixed-length records are hashed in batches: 8 records per AVX2
+// instruction for XXHash32 and 32-bit multiplicative hashes, each 32-bit lane loading the
+// same word of a different record with a gather, and through the batch kernel of the
+// shared object for hash-dsl models. Variable-length XXHash32 records go through the
+// multi-buffer XXHash32::hash_many().
+//
+// With --shm, the records are read instead from the shared-memory ring of a generator
+// (common/shm_ring.h) as it publishes them, in place, and released batch by batch.
+//
+// Reports every mismatch (up to --max-report of them) and the throughput, and exits with
+// 1 when some record does not collide, or the checksum does not match.
+
+#include <algorithm>
+#include <atomic>
+#include <bitset>
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include "../common/corpus.h"
+#include "../common/hash_model.h"
+#include "../common/hex_format.h"
+#include "../common/shm_ring.h"
+#include "../lsquic/xxhash32.h"
+#include "../multiplicative-hash-mitm/multiplicative_hash.h"
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+// Configuration constants
+constexpr size_t BATCH = 256;                      // records hashed per call
+constexpr uint64_t CHUNK = uint64_t(1) << 16;      // records claimed at a time by a thread
+constexpr size_t DEFAULT_MAX_REPORT = 20;
+constexpr double DEFAULT_RING_WAIT = 10.0;         // seconds to wait for a ring to appear
+
+// Digests of the records of one hash model
+class RecordHasher {
+public:
+    virtual ~RecordHasher() = default;
+
+    virtual uint64_t hash(const uint8_t* data, size_t size) const = 0;
+
+    // Digests of the n records of size bytes at data, data + size, ... Up to limit may be
+    // read, past the end of the last record.
+    virtual void hash_records(const uint8_t* data, size_t size, size_t n, const uint8_t* limit,
+                              uint64_t* out) const {
+        (void)limit;
+        for (size_t i = 0; i < n; ++i) {
+            out[i] = hash(data + i * size, size);
+        }
+    }
+
+    // Digests of n records of any lengths
+    virtual void hash_many(const uint8_t* const* data, const uint64_t* sizes, size_t n, uint64_t* out) const {
+        for (size_t i = 0; i < n; ++i) {
+            out[i] = hash(data[i], sizes[i]);
+        }
+    }
+};
+
+#if defined(__AVX2__)
+namespace simd {
+
+// Largest record whose 8 lanes a gather can address with 32-bit offsets
+constexpr size_t MAX_RECORD = size_t(1) << 27;
+
+inline __m256i set1(uint32_t x) { return _mm256_set1_epi32(static_cast<int>(x)); }
+
+template <int r>
+inline __m256i rotl(__m256i x) {
+    return _mm256_or_si256(_mm256_slli_epi32(x, r), _mm256_srli_epi32(x, 32 - r));
+}
+
+// Offsets of the same position in 8 consecutive records
+inline __m256i lanes(size_t size) {
+    return _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), set1(static_cast<uint32_t>(size)));
+}
+
+// Little-endian 32-bit words at offset of the 8 records
+inline __m256i gather(const uint8_t* records, __m256i lanes, size_t offset) {
+    return _mm256_i32gather_epi32(reinterpret_cast<const int*>(records + offset), lanes, 1);
+}
+
+inline void store(__m256i digests, uint64_t* out) {
+    alignas(32) uint32_t lanes[8];
+    _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), digests);
+    for (int l = 0; l < 8; ++l) {
+        out[l] = lanes[l];
+    }
+}
+
+}  // namespace simd
+#endif
+
+class Xxh32Hasher : public RecordHasher {
+public:
+    explicit Xxh32Hasher(uint32_t seed) : seed_(seed) {}
+
+    uint64_t hash(const uint8_t* data, size_t size) const override {
+        return XXHash32::hash(data, size, seed_);
+    }
+
+    void hash_records(const uint8_t* data, size_t size, size_t n, const uint8_t* limit,
+                      uint64_t* out) const override {
+        size_t i = 0;
+#if defined(__AVX2__)
+        if (size <= simd::MAX_RECORD) {
+            const __m256i lanes = simd::lanes(size);
+            // The last byte loads read 3 bytes past their record
+            for (; i + 8 <= n && data + (i + 8) * size + 3 <= limit; i += 8) {
+                simd::store(hash8(data + i * size, size, lanes), out + i);
+            }
+        }
+#else
+        (void)limit;
+#endif
+        for (; i < n; ++i) {
+            out[i] = hash(data + i * size, size);
+        }
+    }
+
+    void hash_many(const uint8_t* const* data, const uint64_t* sizes, size_t n, uint64_t* out) const override {
+        uint32_t digests[BATCH];
+        for (size_t first = 0; first < n; first += BATCH) {
+            const size_t count = std::min(BATCH, n - first);
+            XXHash32::hash_many(reinterpret_cast<const void* const*>(data + first), sizes + first, count, seed_,
+                                digests);
+            std::copy(digests, digests + count, out + first);
+        }
+    }
+
+private:
+    static constexpr uint32_t Prime1 = 2654435761U;
+    static constexpr uint32_t Prime2 = 2246822519U;
+    static constexpr uint32_t Prime3 = 3266489917U;
+    static constexpr uint32_t Prime4 = 668265263U;
+    static constexpr uint32_t Prime5 = 374761393U;
+
+    uint32_t seed_;
+
+#if defined(__AVX2__)
+    // XXHash32::hash of 8 records, as in xxhash32.h
+    __m256i hash8(const uint8_t* records, size_t size, __m256i lanes) const {
+        using simd::set1;
+        auto round = [](__m256i state, __m256i word) {
+            state = _mm256_add_epi32(state, _mm256_mullo_epi32(word, set1(Prime2)));
+            return _mm256_mullo_epi32(simd::rotl<13>(state), set1(Prime1));
+        };
+        size_t offset = 0;
+        __m256i acc;
+        if (size >= 16) {
+            __m256i v1 = set1(seed_ + Prime1 + Prime2);
+            __m256i v2 = set1(seed_ + Prime2);
+            __m256i v3 = set1(seed_);
+            __m256i v4 = set1(seed_ - Prime1);
+            for (; offset + 16 <= size; offset += 16) {
+                v1 = round(v1, simd::gather(records, lanes, offset));
+                v2 = round(v2, simd::gather(records, lanes, offset + 4));
+                v3 = round(v3, simd::gather(records, lanes, offset + 8));
+                v4 = round(v4, simd::gather(records, lanes, offset + 12));
+            }
+            acc = _mm256_add_epi32(_mm256_add_epi32(simd::rotl<1>(v1), simd::rotl<7>(v2)),
+                                   _mm256_add_epi32(simd::rotl<12>(v3), simd::rotl<18>(v4)));
+        } else {
+            acc = set1(seed_ + Prime5);
+        }
+        acc = _mm256_add_epi32(acc, set1(static_cast<uint32_t>(size)));
+        for (; offset + 4 <= size; offset += 4) {
+            const __m256i word = _mm256_mullo_epi32(simd::gather(records, lanes, offset), set1(Prime3));
+            acc = _mm256_mullo_epi32(simd::rotl<17>(_mm256_add_epi32(acc, word)), set1(Prime4));
+        }
+        for (; offset < size; ++offset) {
+            const __m256i byte = _mm256_and_si256(simd::gather(records, lanes, offset), set1(0xFF));
+            acc = _mm256_add_epi32(acc, _mm256_mullo_epi32(byte, set1(Prime5)));
+            acc = _mm256_mullo_epi32(simd::rotl<11>(acc), set1(Prime1));
+        }
+        acc = _mm256_xor_si256(acc, _mm256_srli_epi32(acc, 15));
+        acc = _mm256_mullo_epi32(acc, set1(Prime2));
+        acc = _mm256_xor_si256(acc, _mm256_srli_epi32(acc, 13));
+        acc = _mm256_mullo_epi32(acc, set1(Prime3));
+        return _mm256_xor_si256(acc, _mm256_srli_epi32(acc, 16));
+    }
+#endif
+};
+
+class MultHasher : public RecordHasher {
+public:
+    explicit MultHasher(const MultiplicativeHash& hash) : hash_(hash) {}
+
+    uint64_t hash(const uint8_t* data, size_t size) const override { return hash_.hash(data, size); }
+
+    void hash_records(const uint8_t* data, size_t size, size_t n, const uint8_t* limit,
+                      uint64_t* out) const override {
+        size_t i = 0;
+#if defined(__AVX2__)
+        if (hash_.bits() == 32 && size <= simd::MAX_RECORD) {
+            const __m256i lanes = simd::lanes(size);
+            for (; i + 8 <= n && data + (i + 8) * size + 3 <= limit; i += 8) {
+                simd::store(hash8(data + i * size, size, lanes), out + i);
+            }
+        }
+#else
+        (void)limit;
+#endif
+        for (; i < n; ++i) {
+            out[i] = hash(data + i * size, size);
+        }
+    }
+
+private:
+    MultiplicativeHash hash_;
+
+#if defined(__AVX2__)
+    // Four bytes per step: h * M^4 + b0 * M^3 + b1 * M^2 + b2 * M + b3
+    __m256i hash8(const uint8_t* records, size_t size, __m256i lanes) const {
+        using simd::set1;
+        const uint32_t m1 = static_cast<uint32_t>(hash_.multiplier());
+        const __m256i byte_mask = set1(0xFF);
+        const __m256i m = set1(m1);
+        const __m256i m2 = set1(m1 * m1);
+        const __m256i m3 = set1(m1 * m1 * m1);
+        const __m256i m4 = set1(m1 * m1 * m1 * m1);
+        __m256i h = set1(static_cast<uint32_t>(hash_.initial_value()));
+        size_t offset = 0;
+        for (; offset + 4 <= size; offset += 4) {
+            const __m256i word = simd::gather(records, lanes, offset);
+            const __m256i b0 = _mm256_and_si256(word, byte_mask);
+            const __m256i b1 = _mm256_and_si256(_mm256_srli_epi32(word, 8), byte_mask);
+            const __m256i b2 = _mm256_and_si256(_mm256_srli_epi32(word, 16), byte_mask);
+            const __m256i b3 = _mm256_srli_epi32(word, 24);
+            h = _mm256_add_epi32(_mm256_mullo_epi32(h, m4), _mm256_mullo_epi32(b0, m3));
+            h = _mm256_add_epi32(h, _mm256_add_epi32(_mm256_mullo_epi32(b1, m2), _mm256_mullo_epi32(b2, m)));
+            h = _mm256_add_epi32(h, b3);
+        }
+        for (; offset < size; ++offset) {
+            const __m256i byte = _mm256_and_si256(simd::gather(records, lanes, offset), byte_mask);
+            h = _mm256_add_epi32(_mm256_mullo_epi32(h, m), byte);
+        }
+        return h;
+    }
+#endif
+};
+
+class DslHasher : public RecordHasher {
+public:
+    explicit DslHasher(const std::string& path) : model_(path) {}
+
+    const HashModel& model() const noexcept { return model_; }
+
+    uint64_t hash(const uint8_t* data, size_t size) const override { return model_.hash(data, size); }
+
+    // Transposed into the structure-of-arrays layout of the batch kernel
+    void hash_records(const uint8_t* data, size_t size, size_t n, const uint8_t* limit,
+                      uint64_t* out) const override {
+        const size_t word = model_.word_bytes();
+        if (!model_.has_batch() || size % word != 0) {
+            RecordHasher::hash_records(data, size, n, limit, out);
+            return;
+        }
+        const size_t n_words = size / word;
+        std::vector<uint8_t> words(n_words * n * word);
+        std::vector<uint32_t> states(n, static_cast<uint32_t>(model_.initial_value()));
+        for (size_t l = 0; l < n; ++l) {
+            for (size_t p = 0; p < n_words; ++p) {
+                std::copy(data + l * size + p * word, data + l * size + (p + 1) * word,
+                          &words[(p * n + l) * word]);
+            }
+        }
+        model_.forward_batch(states.data(), words.data(), n_words, n);
+        for (size_t l = 0; l < n; ++l) {
+            out[l] = model_.finalize(states[l], size);
+        }
+    }
+
+private:
+    HashModel model_;
+};
+
+// A hash model, target and mask the records must satisfy
+struct Constraint {
+    std::string model;
+    std::unique_ptr<RecordHasher> hasher;
+    uint64_t target;
+    uint64_t mask;
+};
+
+// Hasher of a model in corpus syntax: xxh32:<seed>, mult:<initial>:<multiplier>[:<bits>] or
+// dsl:<name>, the latter loaded from dsl_path
+std::unique_ptr<RecordHasher> make_hasher(const std::string& model, const std::string& dsl_path) {
+    std::vector<std::string> fields;
+    size_t start = 0;
+    for (size_t colon; (colon = model.find(':', start)) != std::string::npos; start = colon + 1) {
+        fields.push_back(model.substr(start, colon - start));
+    }
+    fields.push_back(model.substr(start));
+
+    if (fields[0] == "xxh32" && fields.size() == 2) {
+        return std::unique_ptr<RecordHasher>(
+            new Xxh32Hasher(static_cast<uint32_t>(std::stoul(fields[1], nullptr, 0))));
+    }
+    if (fields[0] == "mult" && (fields.size() == 3 || fields.size() == 4)) {
+        const unsigned bits = fields.size() == 4 ? static_cast<unsigned>(std::stoul(fields[3], nullptr, 0)) : 32;
+        return std::unique_ptr<RecordHasher>(new MultHasher(
+            MultiplicativeHash(std::stoull(fields[1], nullptr, 0), std::stoull(fields[2], nullptr, 0), bits)));
+    }
+    if (fields[0] == "dsl" && fields.size() == 2) {
+        if (dsl_path.empty()) {
+            throw std::invalid_argument("no shared object for model " + model + ", pass --model");
+        }
+        std::unique_ptr<DslHasher> hasher(new DslHasher(dsl_path));
+        if (hasher->model().name() != fields[1]) {
+            throw std::invalid_argument(dsl_path + " is the model " + hasher->model().name() +
+                                        ", the corpus declares " + fields[1]);
+        }
+        return std::unique_ptr<RecordHasher>(hasher.release());
+    }
+    throw std::invalid_argument("unknown hash model " + model);
+}
+
+struct Mismatch {
+    uint64_t index;
+    size_t constraint;
+    uint64_t digest;
+    std::string record;   // hexadecimal, as the record may not outlive the check
+};
+
+// Digests that miss a constraint, kept up to max_report of them, and the number of records
+// that miss at least one
+class MismatchLog {
+public:
+    explicit MismatchLog(size_t max_report) : max_report_(max_report) {}
+
+    void add(uint64_t index, size_t constraint, uint64_t digest, const uint8_t* data, size_t size) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (reported_.size() < max_report_) {
+            reported_.push_back({index, constraint, digest, hex_format::hex_string(data, size)});
+        }
+    }
+
+    // Count the failed records of a batch, once each whatever the constraints they miss
+    void add_failed(const std::bitset<BATCH>& failed) {
+        if (failed.any()) {
+            failed_.fetch_add(failed.count(), std::memory_order_relaxed);
+        }
+    }
+
+    uint64_t failed() const noexcept { return failed_.load(); }
+
+    std::vector<Mismatch> reported() {
+        std::sort(reported_.begin(), reported_.end(),
+                  [](const Mismatch& a, const Mismatch& b) { return a.index < b.index; });
+        return reported_;
+    }
+
+private:
+    size_t max_report_;
+    std::atomic<uint64_t> failed_{0};
+    std::mutex mutex_;
+    std::vector<Mismatch> reported_;
+};
+
+// Check n fixed-size records against every constraint, BATCH at a time; first is the
+// index of the first one
+void check_records(const std::vector<Constraint>& constraints, const uint8_t* data, size_t size, size_t n,
+                   const uint8_t* limit, uint64_t first, MismatchLog& log) {
+    uint64_t digests[BATCH];
+    for (size_t batch = 0; batch < n; batch += BATCH) {
+        const size_t count = std::min(BATCH, n - batch);
+        std::bitset<BATCH> failed;
+        for (size_t c = 0; c < constraints.size(); ++c) {
+            const Constraint& constraint = constraints[c];
+            constraint.hasher->hash_records(data + batch * size, size, count, limit, digests);
+            for (size_t i = 0; i < count; ++i) {
+                if ((digests[i] & constraint.mask) != constraint.target) {
+                    failed.set(i);
+                    log.add(first + batch + i, c, digests[i], data + (batch + i) * size, size);
+                }
+            }
+        }
+        log.add_failed(failed);
+    }
+}
+
+void print_constraints(const std::vector<Constraint>& constraints) {
+    for (const Constraint& c : constraints) {
+        std::cout << "Model: " << c.model << ", target 0x" << std::hex << c.target << " on mask 0x"
+                  << c.mask << std::dec << std::endl;
+    }
+}
+
+// Throughput, mismatches and verdict; returns the exit code
+int print_results(const std::vector<Constraint>& constraints, MismatchLog& log, uint64_t n_records,
+                  uint64_t n_bytes, double elapsed, unsigned n_threads, bool checksum_ok) {
+    std::cout << "Verified " << n_records << " records in " << std::fixed << std::setprecision(3)
+              << elapsed << " s on " << n_threads << (n_threads == 1 ? " thread: " : " threads: ")
+              << std::setprecision(2) << n_bytes / std::max(elapsed, 1e-9) / 1e9 << " GB/s, "
+              << n_records / std::max(elapsed, 1e-9) / 1e6 << " M records/s" << std::endl;
+    std::cout.unsetf(std::ios::floatfield);
+
+    for (const Mismatch& mismatch : log.reported()) {
+        std::cout << "  MISMATCH: record " << mismatch.index << " " << mismatch.record << " -> "
+                  << constraints[mismatch.constraint].model << " 0x" << std::hex << mismatch.digest
+                  << " != 0x" << constraints[mismatch.constraint].target << std::dec << std::endl;
+    }
+
+    const uint64_t failed = log.failed();
+    std::cout << "\n=== Test Results ===" << std::endl;
+    std::cout << "Passed: " << n_records - failed << "/" << n_records << std::endl;
+    std::cout << "Failed: " << failed << "/" << n_records << std::endl;
+    if (failed > 0 || !checksum_ok) {
+        std::cout << "TEST FAILED: " << (failed > 0 ? "Some records do not collide" : "Checksum mismatch")
+                  << std::endl;
+        return 1;
+    }
+    std::cout << "TEST PASSED: All records collide" << std::endl;
+    return 0;
+}
+
+// Verify the records of a generator's shared-memory ring as they arrive, on this thread
+int verify_ring(const std::string& name, double wait, const std::string& dsl_path, size_t max_report) {
+    ShmRing ring(name, wait);
+    const size_t size = ring.record_size();
+    std::cout << "Ring: " << name << " (records of " << size << " bytes, " << ring.capacity()
+              << " slots)" << std::endl;
+    std::vector<Constraint> constraints;
+    constraints.push_back({ring.model(), make_hasher(ring.model(), dsl_path),
+                           ring.target() & ring.target_mask(), ring.target_mask()});
+    print_constraints(constraints);
+
+    MismatchLog log(max_report);
+    const auto start = std::chrono::steady_clock::now();
+    const uint8_t* data;
+    size_t n;
+    while ((n = ring.acquire(CHUNK, data)) > 0) {
+        check_records(constraints, data, size, n, ring.limit(), ring.position(), log);
+        ring.release(n);
+    }
+    const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    const uint64_t n_records = ring.position();
+    return print_results(constraints, log, n_records, n_records * size, elapsed, 1, true);
+}
+
+void print_usage(const char* name) {
+    std::cerr << "Usage: " << name << " corpus|--shm name [--wait seconds] [--threads n] [--model model.so]"
+              << " [--skip-checksum] [--max-report n]" << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+    // Parse command line arguments
+    std::string path;
+    unsigned n_threads = std::max(1u, std::thread::hardware_concurrency());
+    std::string dsl_path;
+    bool skip_checksum = false;
+    size_t max_report = DEFAULT_MAX_REPORT;
+    std::string ring_name;
+    double ring_wait = DEFAULT_RING_WAIT;
+
+    try {
+        for (int i = 1; i < argc; i++) {
+            const std::string arg = argv[i];
+            auto value = [&]() -> std::string {
+                if (i + 1 >= argc) {
+                    throw std::invalid_argument("missing value for " + arg);
+                }
+                return argv[++i];
+            };
+
+            if (arg == "--threads") {
+                n_threads = static_cast<unsigned>(std::stoul(value(), nullptr, 0));
+                if (n_threads == 0) {
+                    throw std::invalid_argument("number of threads must be positive");
+                }
+            } else if (arg == "--model") {
+                dsl_path = value();
+            } else if (arg == "--skip-checksum") {
+                skip_checksum = true;
+            } else if (arg == "--max-report") {
+                max_report = std::stoul(value(), nullptr, 0);
+            } else if (arg == "--shm") {
+                ring_name = value();
+            } else if (arg == "--wait") {
+                ring_wait = std::stod(value());
+            } else if (!arg.empty() && arg[0] != '-' && path.empty()) {
+                path = arg;
+            } else {
+                throw std::invalid_argument("unknown argument " + arg);
+            }
+        }
+        if (path.empty() == ring_name.empty()) {
+            throw std::invalid_argument("a corpus file or a ring (--shm) is required");
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    try {
+        if (!ring_name.empty()) {
+            return verify_ring(ring_name, ring_wait, dsl_path, max_report);
+        }
+
+        const Corpus corpus(path);
+        const CorpusHeader& header = corpus.header();
+        std::cout << "Corpus: " << path << " (" << corpus.size() << " records of ";
+        if (corpus.fixed_size()) {
+            std::cout << corpus.record_size() << " bytes";
+        } else {
+            std::cout << "variable length";
+        }
+        std::cout << ", " << std::fixed << std::setprecision(1) << corpus.data_size() / 1e6 << " MB)" << std::endl;
+        std::cout.unsetf(std::ios::floatfield);
+
+        // The header's model, and the second hash of joint collision corpora
+        std::vector<Constraint> constraints;
+        const std::string model = corpus.model();
+        constraints.push_back({model, make_hasher(model, dsl_path.empty() ? corpus.param("model_path") : dsl_path),
+                               header.target & header.target_mask, header.target_mask});
+        const std::string h2 = corpus.param("h2");
+        if (!h2.empty()) {
+            const uint64_t mask = std::stoull(corpus.param("h2_mask", "0xffffffff"), nullptr, 0);
+            constraints.push_back({h2, make_hasher(h2, ""),
+                                   std::stoull(corpus.param("h2_target", "0"), nullptr, 0) & mask, mask});
+        }
+        print_constraints(constraints);
+
+        bool checksum_ok = true;
+        if (!skip_checksum) {
+            const auto start = std::chrono::steady_clock::now();
+            checksum_ok = corpus.verify_checksum();
+            const double elapsed =
+                std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            std::cout << "Checksum: " << (checksum_ok ? "ok" : "MISMATCH") << " (" << std::fixed
+                      << std::setprecision(2) << elapsed << " s)" << std::endl;
+            std::cout.unsetf(std::ios::floatfield);
+        }
+
+        // Every thread claims CHUNK records at a time and hashes them BATCH at a time
+        const uint64_t n_records = corpus.size();
+        const uint8_t* limit = corpus.data() + corpus.data_size();
+        std::atomic<uint64_t> next{0};
+        MismatchLog log(max_report);
+        const auto start = std::chrono::steady_clock::now();
+        {
+            std::vector<std::thread> threads;
+            for (unsigned t = 0; t < n_threads; ++t) {
+                threads.emplace_back([&]() {
+                    uint64_t digests[BATCH];
+                    const uint8_t* records[BATCH];
+                    uint64_t sizes[BATCH];
+                    uint64_t first;
+                    while ((first = next.fetch_add(CHUNK)) < n_records) {
+                        const uint64_t end = std::min(first + CHUNK, n_records);
+                        if (corpus.fixed_size()) {
+                            check_records(constraints, corpus[first].data, corpus.record_size(),
+                                          static_cast<size_t>(end - first), limit, first, log);
+                            continue;
+                        }
+                        for (uint64_t batch = first; batch < end; batch += BATCH) {
+                            const size_t n = static_cast<size_t>(std::min<uint64_t>(BATCH, end - batch));
+                            for (size_t i = 0; i < n; ++i) {
+                                const CorpusRecord record = corpus[batch + i];
+                                records[i] = record.data;
+                                sizes[i] = record.size;
+                            }
+                            std::bitset<BATCH> failed;
+                            for (size_t c = 0; c < constraints.size(); ++c) {
+                                const Constraint& constraint = constraints[c];
+                                constraint.hasher->hash_many(records, sizes, n, digests);
+                                for (size_t i = 0; i < n; ++i) {
+                                    if ((digests[i] & constraint.mask) != constraint.target) {
+                                        failed.set(i);
+                                        log.add(batch + i, c, digests[i], records[i], static_cast<size_t>(sizes[i]));
+                                    }
+                                }
+                            }
+                            log.add_failed(failed);
+                        }
+                    }
+                });
+            }
+            for (auto& thread : threads) {
+                thread.join();
+            }
+        }
+        const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        return print_results(constraints, log, n_records, corpus.data_size(), elapsed, n_threads, checksum_ok);
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
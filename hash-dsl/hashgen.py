@@ -0,0 +1,524 @@
+# hashgen.py
+# Generate and compile native kernels for a hash model described in a small DSL
+# Author: Paul Bottinelli
+# For Black Hat EU 2025 - Cut to the QUIC: Slashing QUIC's Performance with a Hash DoS
+#
+# A model file describes an iterated hash over little-endian input words:
+#
+#   name   fnv1a32
+#   bits   32                  # state and digest size, 32 or 64
+#   word   1                   # bytes absorbed per round
+#   init   0x811c9dc5          # initial state
+#   round: h ^= w; h *= 0x01000193
+#   final: h ^= h >> 16        # optional, may use the input length 'len'
+#
+# Round statements update the state h or the input word w with: +=, -=, ^= a constant,
+# w or len; *= an odd constant; h ^= h >> s, h ^= h << s, h += h << s, h -= h << s;
+# h = rotl(h, r), h = rotr(h, r) and h = ~h (the same forms apply to w). Every statement on
+# h is invertible in h, so the generator derives the backward round and the inverse
+# finalization along with the forward ones, plus an AVX2 batch kernel for 32-bit models,
+# and compiles them into a shared object loaded by common/hash_model.h.
+#
+# The generated kernels are checked against a Python evaluation of the model before use.
+
+import argparse
+import ctypes
+import os
+import random
+import re
+import subprocess
+import sys
+import tempfile
+
+ABI_VERSION = 1
+COMMON_DIR = os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', 'common')
+
+_NUMBER = r'(0[xX][0-9a-fA-F]+|\d+)'
+_ASSIGN_RE = re.compile(r'^([hw])\s*([-+^*])=\s*(.+)$')
+_SHIFT_RE = re.compile(r'^([hw])\s*(<<|>>)\s*' + _NUMBER + r'$')
+_ROTATE_RE = re.compile(r'^([hw])\s*=\s*(rotl|rotr)\(\s*([hw])\s*,\s*' + _NUMBER + r'\s*\)$')
+_NOT_RE = re.compile(r'^([hw])\s*=\s*~\s*([hw])$')
+
+
+class Op:
+    """
+    One statement: target ('h' or 'w'), kind and argument.
+    Kinds: 'add', 'sub', 'xor', 'mul' with an operand ('w', 'len' or an integer),
+    'xorshr', 'xorshl', 'addshl', 'subshl' with a shift, 'rotl' with a rotation, 'not'.
+    """
+    def __init__(self, target, kind, arg=None):
+        self.target = target
+        self.kind = kind
+        self.arg = arg
+
+    def uses_word(self):
+        return self.arg == 'w'
+
+
+class HashModel:
+    """Parsed model file, with a Python reference evaluation of the hash."""
+
+    def __init__(self, text, source='<model>'):
+        self.name = None
+        self.bits = 32
+        self.word_bytes = 1
+        self.init = 0
+        self.round = []
+        self.final = []
+        self.source = source
+        section = None
+        for number, raw in enumerate(text.splitlines(), 1):
+            line = raw.split('#', 1)[0].strip()
+            if not line:
+                continue
+            where = f"{source}:{number}"
+            key, _, rest = line.partition(' ')
+            if key in ('round:', 'final:'):
+                section = self.round if key == 'round:' else self.final
+                self._parse_statements(rest, section, key == 'final:', where)
+            elif key.endswith(':') and key[:-1] in ('round', 'final'):
+                raise ValueError(f"{where}: expected '{key[:-1]}:' followed by statements")
+            elif key == 'name':
+                if not re.match(r'^[A-Za-z_][A-Za-z0-9_]*$', rest.strip()):
+                    raise ValueError(f"{where}: model name must be an identifier")
+                self.name = rest.strip()
+            elif key == 'bits':
+                self.bits = int(rest, 0)
+            elif key == 'word':
+                self.word_bytes = int(rest, 0)
+            elif key == 'init':
+                self.init = int(rest, 0)
+            elif section is not None and key not in ('name', 'bits', 'word', 'init'):
+                # Continuation line of the last section
+                self._parse_statements(line, section, section is self.final, where)
+            else:
+                raise ValueError(f"{where}: unknown directive {key}")
+        if self.name is None:
+            raise ValueError(f"{source}: missing name")
+        if self.bits not in (32, 64):
+            raise ValueError(f"{source}: bits must be 32 or 64")
+        if self.word_bytes not in (1, 2, 4, 8) or self.word_bytes * 8 > self.bits:
+            raise ValueError(f"{source}: word must be 1, 2, 4 or 8 bytes, at most the state size")
+        if not self.round:
+            raise ValueError(f"{source}: missing round")
+        self.mask = (1 << self.bits) - 1
+        self.init &= self.mask
+        for op in self.round + self.final:
+            self._check(op)
+
+    def _parse_statements(self, text, section, final, where):
+        for statement in filter(None, (s.strip() for s in text.split(';'))):
+            section.append(self._parse_statement(statement, final, where))
+
+    @staticmethod
+    def _parse_statement(statement, final, where):
+        m = _ROTATE_RE.match(statement)
+        if m:
+            target, direction, source, amount = m.groups()
+            if target != source:
+                raise ValueError(f"{where}: {target} can only be rotated into itself")
+            return Op(target, 'rotl' if direction == 'rotl' else 'rotr', int(amount, 0))
+        m = _NOT_RE.match(statement)
+        if m:
+            if m.group(1) != m.group(2):
+                raise ValueError(f"{where}: {m.group(1)} = ~{m.group(2)} is not supported")
+            return Op(m.group(1), 'not')
+        m = _ASSIGN_RE.match(statement)
+        if not m:
+            raise ValueError(f"{where}: cannot parse '{statement}'")
+        target, operator, operand = m.group(1), m.group(2), m.group(3).strip()
+        if final and target == 'w':
+            raise ValueError(f"{where}: no input word in the finalization")
+        shift = _SHIFT_RE.match(operand)
+        if shift:
+            source, direction, amount = shift.group(1), shift.group(2), int(shift.group(3), 0)
+            kinds = {('^', '>>'): 'xorshr', ('^', '<<'): 'xorshl', ('+', '<<'): 'addshl', ('-', '<<'): 'subshl'}
+            if source != target or (operator, direction) not in kinds:
+                raise ValueError(f"{where}: '{statement}' is not invertible")
+            return Op(target, kinds[(operator, direction)], amount)
+        if operand in ('w', 'len'):
+            if operand == 'w' and (final or target == 'w'):
+                raise ValueError(f"{where}: w is only an operand of h in the round")
+            if operand == 'len' and not final:
+                raise ValueError(f"{where}: len is only available in the finalization")
+            value = operand
+        elif re.match('^' + _NUMBER + '$', operand):
+            value = int(operand, 0)
+        else:
+            raise ValueError(f"{where}: unknown operand '{operand}'")
+        kind = {'+': 'add', '-': 'sub', '^': 'xor', '*': 'mul'}[operator]
+        if kind == 'mul' and target == 'h' and not isinstance(value, int):
+            raise ValueError(f"{where}: h can only be multiplied by a constant")
+        return Op(target, kind, value)
+
+    def _check(self, op):
+        if op.kind in ('rotl', 'rotr'):
+            op.arg %= self.bits
+            if op.kind == 'rotr':
+                op.kind, op.arg = 'rotl', (self.bits - op.arg) % self.bits
+        elif op.kind in ('xorshr', 'xorshl', 'addshl', 'subshl'):
+            if not 0 < op.arg < self.bits:
+                raise ValueError(f"{self.source}: shift {op.arg} out of range")
+        elif isinstance(op.arg, int):
+            op.arg &= self.mask
+            if op.kind == 'mul' and op.target == 'h' and op.arg % 2 == 0:
+                raise ValueError(f"{self.source}: multiplier {op.arg:#x} is even, so not invertible")
+
+    # Python reference evaluation
+
+    def _apply(self, op, h, w, length):
+        x = h if op.target == 'h' else w
+        operand = {'w': w, 'len': length}.get(op.arg, op.arg)
+        if op.kind == 'add':
+            x += operand
+        elif op.kind == 'sub':
+            x -= operand
+        elif op.kind == 'xor':
+            x ^= operand
+        elif op.kind == 'mul':
+            x *= operand
+        elif op.kind == 'xorshr':
+            x ^= x >> op.arg
+        elif op.kind == 'xorshl':
+            x ^= x << op.arg
+        elif op.kind == 'addshl':
+            x += x << op.arg
+        elif op.kind == 'subshl':
+            x -= x << op.arg
+        elif op.kind == 'rotl':
+            x = ((x << op.arg) | (x >> ((self.bits - op.arg) % self.bits))) & self.mask
+        elif op.kind == 'not':
+            x = ~x
+        x &= self.mask
+        return (x, w) if op.target == 'h' else (h, x)
+
+    def hash(self, data):
+        if len(data) % self.word_bytes:
+            raise ValueError("input length must be a multiple of the word size")
+        h = self.init
+        for i in range(0, len(data), self.word_bytes):
+            w = int.from_bytes(data[i:i + self.word_bytes], 'little')
+            for op in self.round:
+                h, w = self._apply(op, h, w, None)
+        for op in self.final:
+            h, _ = self._apply(op, h, 0, len(data))
+        return h
+
+
+class _Emitter:
+    """C++ code generation for one model."""
+
+    def __init__(self, model):
+        self.model = model
+        self.t = 'uint32_t' if model.bits == 32 else 'uint64_t'
+
+    def const(self, value):
+        return f"{self.t}({value:#x}u)" if self.model.bits == 32 else f"{self.t}({value:#x}ull)"
+
+    def operand(self, arg, word):
+        if arg == 'w':
+            return word
+        if arg == 'len':
+            return f"static_cast<{self.t}>(length)"
+        return self.const(arg)
+
+    def scalar(self, op, word='w'):
+        x = op.target if op.target == 'h' else word
+        if op.kind in ('add', 'sub', 'xor', 'mul'):
+            symbol = {'add': '+', 'sub': '-', 'xor': '^', 'mul': '*'}[op.kind]
+            return f"{x} {symbol}= {self.operand(op.arg, word)};"
+        if op.kind == 'xorshr':
+            return f"{x} ^= {x} >> {op.arg};"
+        if op.kind == 'xorshl':
+            return f"{x} ^= {x} << {op.arg};"
+        if op.kind == 'addshl':
+            return f"{x} += {x} << {op.arg};"
+        if op.kind == 'subshl':
+            return f"{x} -= {x} << {op.arg};"
+        if op.kind == 'rotl':
+            return f"{x} = rotl({x}, {op.arg});" if op.arg else ""
+        return f"{x} = ~{x};"
+
+    def inverse(self, op, word):
+        """Statement undoing op on h, given the value word of w it was applied with."""
+        modulus = 1 << self.model.bits
+        if op.kind == 'add':
+            return f"h -= {self.operand(op.arg, word)};"
+        if op.kind == 'sub':
+            return f"h += {self.operand(op.arg, word)};"
+        if op.kind == 'xor':
+            return f"h ^= {self.operand(op.arg, word)};"
+        if op.kind == 'mul':
+            return f"h *= {self.const(pow(op.arg, -1, modulus))};"
+        if op.kind == 'addshl':
+            return f"h *= {self.const(pow(1 + (1 << op.arg), -1, modulus))};"
+        if op.kind == 'subshl':
+            return f"h *= {self.const(pow((1 - (1 << op.arg)) % modulus, -1, modulus))};"
+        if op.kind in ('xorshr', 'xorshl'):
+            shift = '>>' if op.kind == 'xorshr' else '<<'
+            return (f"{{ {self.t} x = h; for (unsigned i = {op.arg}; i < {self.model.bits}; i += {op.arg}) "
+                    f"x = h ^ (x {shift} {op.arg}); h = x; }}")
+        if op.kind == 'rotl':
+            return f"h = rotl(h, {(self.model.bits - op.arg) % self.model.bits});" if op.arg else ""
+        return "h = ~h;"
+
+    def vector(self, op):
+        x = op.target
+        def value(arg):
+            return 'w' if arg == 'w' else f"_mm256_set1_epi32(static_cast<int>({self.const(arg)}))"
+        if op.kind in ('add', 'sub', 'xor', 'mul'):
+            function = {'add': '_mm256_add_epi32', 'sub': '_mm256_sub_epi32',
+                        'xor': '_mm256_xor_si256', 'mul': '_mm256_mullo_epi32'}[op.kind]
+            return f"{x} = {function}({x}, {value(op.arg)});"
+        if op.kind in ('xorshr', 'xorshl', 'addshl', 'subshl'):
+            combine = {'xorshr': '_mm256_xor_si256', 'xorshl': '_mm256_xor_si256',
+                       'addshl': '_mm256_add_epi32', 'subshl': '_mm256_sub_epi32'}[op.kind]
+            shift = '_mm256_srli_epi32' if op.kind == 'xorshr' else '_mm256_slli_epi32'
+            return f"{x} = {combine}({x}, {shift}({x}, {op.arg}));"
+        if op.kind == 'rotl':
+            if not op.arg:
+                return ""
+            return (f"{x} = _mm256_or_si256(_mm256_slli_epi32({x}, {op.arg}), "
+                    f"_mm256_srli_epi32({x}, {32 - op.arg}));")
+        return f"{x} = _mm256_xor_si256({x}, _mm256_set1_epi32(-1));"
+
+    def load_vector(self):
+        return {
+            1: "_mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(p)))",
+            2: "_mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)))",
+            4: "_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p))",
+        }[self.model.word_bytes]
+
+    def source(self):
+        m = self.model
+        t = self.t
+        lines = []
+        add = lines.append
+        add(f"// Generated by hashgen.py from {os.path.basename(m.source)}, do not edit")
+        add(f"// Model {m.name}: {m.bits}-bit state, {m.word_bytes}-byte words")
+        add("")
+        add("#define HASH_MODEL_NO_LOADER")
+        add("#include <cstddef>")
+        add("#include <cstdint>")
+        add("#ifdef __AVX2__")
+        add("#include <immintrin.h>")
+        add("#endif")
+        add('#include "hash_model.h"')
+        add("")
+        add("namespace {")
+        add("")
+        add(f"inline {t} rotl({t} x, unsigned r) {{ return (x << r) | (x >> ({m.bits} - r)); }}")
+        add("")
+        add(f"inline {t} load_word(const uint8_t* p) {{")
+        add(f"    {t} w = 0;")
+        add(f"    for (unsigned i = 0; i < {m.word_bytes}; ++i) {{")
+        add(f"        w |= static_cast<{t}>(p[i]) << (8 * i);")
+        add("    }")
+        add("    return w;")
+        add("}")
+        add("")
+        add(f"inline {t} round_forward({t} h, {t} w) {{")
+        for op in m.round:
+            statement = self.scalar(op)
+            if statement:
+                add(f"    {statement}")
+        add("    return h;")
+        add("}")
+        add("")
+        # The backward round replays the word updates to know w at every state update,
+        # then undoes the state updates in reverse order
+        add(f"inline {t} round_backward({t} h, {t} w) {{")
+        versions = {}
+        for index, op in enumerate(m.round):
+            if op.target == 'w':
+                statement = self.scalar(op)
+                if statement:
+                    add(f"    {statement}")
+            elif op.uses_word():
+                versions[index] = f"w{index}"
+                add(f"    const {t} w{index} = w;")
+        for index in reversed(range(len(m.round))):
+            op = m.round[index]
+            if op.target == 'h':
+                statement = self.inverse(op, versions.get(index, 'w'))
+                if statement:
+                    add(f"    {statement}")
+        add("    (void)w;")
+        add("    return h;")
+        add("}")
+        add("")
+        add("uint64_t forward(uint64_t state, const uint8_t* data, size_t length) {")
+        add(f"    {t} h = static_cast<{t}>(state);")
+        add(f"    for (size_t i = 0; i + {m.word_bytes} <= length; i += {m.word_bytes}) {{")
+        add("        h = round_forward(h, load_word(data + i));")
+        add("    }")
+        add("    return h;")
+        add("}")
+        add("")
+        add("uint64_t backward(uint64_t state, const uint8_t* data, size_t length) {")
+        add(f"    {t} h = static_cast<{t}>(state);")
+        add(f"    for (size_t i = length / {m.word_bytes}; i-- > 0;) {{")
+        add(f"        h = round_backward(h, load_word(data + i * {m.word_bytes}));")
+        add("    }")
+        add("    return h;")
+        add("}")
+        add("")
+        add("uint64_t finalize(uint64_t state, uint64_t length) {")
+        add(f"    {t} h = static_cast<{t}>(state);")
+        for op in m.final:
+            statement = self.scalar(op)
+            if statement:
+                add(f"    {statement}")
+        add("    (void)length;")
+        add("    return h;")
+        add("}")
+        add("")
+        add("uint64_t unfinalize(uint64_t digest, uint64_t length) {")
+        add(f"    {t} h = static_cast<{t}>(digest);")
+        for op in reversed(m.final):
+            statement = self.inverse(op, 'w')
+            if statement:
+                add(f"    {statement}")
+        add("    (void)length;")
+        add("    return h;")
+        add("}")
+        add("")
+        if m.bits == 32:
+            add("void forward_batch(uint32_t* states, const uint8_t* words, size_t n_words, size_t lanes) {")
+            add("    for (size_t p = 0; p < n_words; ++p) {")
+            add(f"        const uint8_t* row = words + p * lanes * {m.word_bytes};")
+            add("        size_t l = 0;")
+            add("#ifdef __AVX2__")
+            add("        for (; l + 8 <= lanes; l += 8) {")
+            add(f"            const uint8_t* p = row + l * {m.word_bytes};")
+            add("            __m256i h = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(states + l));")
+            add(f"            __m256i w = {self.load_vector()};")
+            for op in m.round:
+                statement = self.vector(op)
+                if statement:
+                    add(f"            {statement}")
+            add("            (void)w;")
+            add("            _mm256_storeu_si256(reinterpret_cast<__m256i*>(states + l), h);")
+            add("        }")
+            add("#endif")
+            add("        for (; l < lanes; ++l) {")
+            add(f"            states[l] = round_forward(states[l], load_word(row + l * {m.word_bytes}));")
+            add("        }")
+            add("    }")
+            add("}")
+            add("")
+        add("}  // namespace")
+        add("")
+        add('extern "C" const HashModelKernels* hash_model_kernels(void) {')
+        add("    static const HashModelKernels kernels = {")
+        add(f'        {ABI_VERSION}, "{m.name}", {m.bits}, {m.word_bytes}, {m.init:#x}ull,')
+        add(f"        forward, backward, finalize, unfinalize, {'forward_batch' if m.bits == 32 else 'nullptr'},")
+        add("    };")
+        add("    return &kernels;")
+        add("}")
+        return "\n".join(lines) + "\n"
+
+
+def compile_model(source, output, cxx, flags):
+    """Compile generated source into a shared object, raising on compiler errors."""
+    with tempfile.NamedTemporaryFile('w', suffix='.cpp', delete=False) as f:
+        f.write(source)
+        path = f.name
+    try:
+        command = [cxx, '-std=c++17', '-shared', '-fPIC', '-I', os.path.abspath(COMMON_DIR)] + flags + ['-o', output, path]
+        result = subprocess.run(command, capture_output=True, text=True)
+        if result.returncode != 0:
+            raise RuntimeError(f"compilation failed ({' '.join(command)}):\n{result.stderr}")
+    finally:
+        os.unlink(path)
+
+
+class _Kernels(ctypes.Structure):
+    _fields_ = [
+        ('abi_version', ctypes.c_uint32),
+        ('name', ctypes.c_char_p),
+        ('bits', ctypes.c_uint),
+        ('word_bytes', ctypes.c_uint),
+        ('initial_state', ctypes.c_uint64),
+        ('forward', ctypes.CFUNCTYPE(ctypes.c_uint64, ctypes.c_uint64, ctypes.c_char_p, ctypes.c_size_t)),
+        ('backward', ctypes.CFUNCTYPE(ctypes.c_uint64, ctypes.c_uint64, ctypes.c_char_p, ctypes.c_size_t)),
+        ('finalize', ctypes.CFUNCTYPE(ctypes.c_uint64, ctypes.c_uint64, ctypes.c_uint64)),
+        ('unfinalize', ctypes.CFUNCTYPE(ctypes.c_uint64, ctypes.c_uint64, ctypes.c_uint64)),
+        ('forward_batch', ctypes.c_void_p),
+    ]
+
+
+def check_model(model, library, n_tests):
+    """
+    Compare the compiled kernels with the Python evaluation on random inputs: hashes,
+    forward/backward and finalize/unfinalize round trips, and the batch kernel.
+    Returns the number of mismatches.
+    """
+    lib = ctypes.CDLL(os.path.abspath(library))
+    lib.hash_model_kernels.restype = ctypes.POINTER(_Kernels)
+    k = lib.hash_model_kernels().contents
+    batch = None
+    if k.forward_batch:
+        batch = ctypes.CFUNCTYPE(None, ctypes.POINTER(ctypes.c_uint32), ctypes.c_char_p,
+                                 ctypes.c_size_t, ctypes.c_size_t)(k.forward_batch)
+    rng = random.Random(1)
+    failures = 0
+    for _ in range(n_tests):
+        data = bytes(rng.randrange(256) for _ in range(model.word_bytes * rng.randrange(0, 9)))
+        state = k.forward(k.initial_state, data, len(data))
+        if k.finalize(state, len(data)) != model.hash(data):
+            failures += 1
+        s = rng.getrandbits(model.bits)
+        if k.backward(k.forward(s, data, len(data)), data, len(data)) != s:
+            failures += 1
+        if k.unfinalize(k.finalize(s, len(data)), len(data)) != s:
+            failures += 1
+    if batch:
+        lanes, n_words = 37, 3
+        words = bytes(rng.randrange(256) for _ in range(lanes * n_words * model.word_bytes))
+        states = (ctypes.c_uint32 * lanes)(*(rng.getrandbits(32) for _ in range(lanes)))
+        expected = []
+        for lane in range(lanes):
+            data = b''.join(words[(p * lanes + lane) * model.word_bytes:(p * lanes + lane + 1) * model.word_bytes]
+                            for p in range(n_words))
+            expected.append(k.forward(states[lane], data, len(data)))
+        batch(states, words, n_words, lanes)
+        failures += sum(states[lane] != expected[lane] for lane in range(lanes))
+    return failures
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Generate and compile native kernels for a hash model")
+    parser.add_argument("model", help="Model file")
+    parser.add_argument("-o", "--output", help="Shared object to write (default: <name>.so)")
+    parser.add_argument("--emit", help="Also write the generated C++ source to this file")
+    parser.add_argument("--cxx", default=os.environ.get('CXX', 'c++'), help="C++ compiler (default: $CXX or c++)")
+    parser.add_argument("--flags", default="-O3 -march=native", help="Compiler flags (default: '-O3 -march=native')")
+    parser.add_argument("--check", type=int, default=1000, metavar="N",
+                        help="Random inputs checked against the Python evaluation, 0 to skip (default: 1000)")
+    args = parser.parse_args()
+
+    try:
+        with open(args.model) as f:
+            model = HashModel(f.read(), args.model)
+        source = _Emitter(model).source()
+        if args.emit:
+            with open(args.emit, 'w') as f:
+                f.write(source)
+        output = args.output or f"{model.name}.so"
+        compile_model(source, output, args.cxx, args.flags.split())
+    except (OSError, ValueError, RuntimeError) as e:
+        print(f"Error: {e}", file=sys.stderr)
+        sys.exit(1)
+    print(f"Compiled {model.name} ({model.bits}-bit state, {model.word_bytes}-byte words) to {output}")
+
+    if args.check > 0:
+        failures = check_model(model, output, args.check)
+        if failures:
+            print(f"CHECK FAILED: {failures} mismatches between the kernels and the model", file=sys.stderr)
+            sys.exit(1)
+        print(f"Checked {args.check} random inputs against the model")
+
+
+if __name__ == "__main__":
+    main()
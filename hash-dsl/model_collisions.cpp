@@ -0,0 +1,256 @@
+// model_collisions.cpp
+// Native collision generator for hash models compiled by hashgen.py
+// Author: Paul Bottinelli
+// For Black Hat EU 2025 - Cut to the QUIC: Slashing QUIC's Performance with a Hash DoS
+//
+// Loads a model shared object and runs the meet-in-the-middle search of model_mitm.h on
+// it: n inputs of prefix + suffix bytes, all hashing to the target digest. A new hash
+// function only takes a model file, no engine code.
+
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include "../common/corpus.h"
+#include "../common/hash_model.h"
+#include "../common/hex_format.h"
+#include "../multiplicative-hash-mitm/charset.h"
+#include "model_mitm.h"
+
+// Configuration constants (sizes as in generic_mitm.py)
+constexpr size_t DEFAULT_PREFIX_SIZE = 7;
+constexpr size_t DEFAULT_SUFFIX_SIZE = 3;
+constexpr uint64_t DEFAULT_N_COLLISIONS = 100;
+
+void print_usage(const char* name) {
+    std::cerr << "Usage: " << name << " -m model.so [-n collisions] [-p prefix] [-s suffix]"
+              << " [-l length] [-c charset] [--spec spec] [-t target] [--table-bits bits]"
+              << " [--threads n] [--seed seed] [-o output] [--corpus path] [--quiet|-q] [--test]" << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+    // Parse command line arguments
+    std::string model_path;
+    uint64_t n_collisions = DEFAULT_N_COLLISIONS;
+    size_t prefix_size = DEFAULT_PREFIX_SIZE;
+    size_t suffix_size = DEFAULT_SUFFIX_SIZE;
+    size_t length = 0;
+    ByteSet charset = ByteSet::any();
+    std::string spec_string;
+    bool has_target = false;
+    uint64_t target = 0;
+    unsigned table_bits = ModelMeetInTheMiddle::MAX_TABLE_BITS;
+    unsigned n_threads = std::max(1u, std::thread::hardware_concurrency());
+    bool has_seed = false;
+    uint64_t seed = 0;
+    std::string output;
+    std::string corpus_path;
+    bool quiet = false;
+    bool run_test = false;
+
+    try {
+        for (int i = 1; i < argc; i++) {
+            const std::string arg = argv[i];
+            auto value = [&]() -> std::string {
+                if (i + 1 >= argc) {
+                    throw std::invalid_argument("missing value for " + arg);
+                }
+                return argv[++i];
+            };
+
+            if (arg == "-m" || arg == "--model") {
+                model_path = value();
+            } else if (arg == "-n" || arg == "--collisions") {
+                n_collisions = std::stoull(value(), nullptr, 0);
+            } else if (arg == "-p" || arg == "--prefix") {
+                prefix_size = std::stoul(value(), nullptr, 0);
+            } else if (arg == "-s" || arg == "--suffix") {
+                suffix_size = std::stoul(value(), nullptr, 0);
+            } else if (arg == "-l" || arg == "--length") {
+                length = std::stoul(value(), nullptr, 0);
+            } else if (arg == "-c" || arg == "--charset") {
+                charset = ByteSet::parse(value());
+            } else if (arg == "--spec") {
+                spec_string = value();
+            } else if (arg == "-t" || arg == "--target") {
+                target = std::stoull(value(), nullptr, 0);
+                has_target = true;
+            } else if (arg == "--table-bits") {
+                table_bits = static_cast<unsigned>(std::stoul(value(), nullptr, 0));
+            } else if (arg == "--threads") {
+                n_threads = static_cast<unsigned>(std::stoul(value(), nullptr, 0));
+                if (n_threads == 0) {
+                    throw std::invalid_argument("number of threads must be positive");
+                }
+            } else if (arg == "--seed") {
+                seed = std::stoull(value(), nullptr, 0);
+                has_seed = true;
+            } else if (arg == "-o" || arg == "--output") {
+                output = value();
+            } else if (arg == "--corpus") {
+                corpus_path = value();
+            } else if (arg == "--quiet" || arg == "-q") {
+                quiet = true;
+            } else if (arg == "--test") {
+                run_test = true;
+            } else {
+                throw std::invalid_argument("unknown argument " + arg);
+            }
+        }
+        if (model_path.empty()) {
+            throw std::invalid_argument("a model is required (-m model.so, see hashgen.py)");
+        }
+        if (n_collisions == 0) {
+            throw std::invalid_argument("number of collisions must be positive");
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    try {
+        const HashModel model(model_path);
+        if (!has_seed) {
+            seed = std::random_device{}() ^ (uint64_t(std::random_device{}()) << 32);
+        }
+        std::mt19937_64 rng(seed);
+
+        CharsetSpec spec;
+        if (!spec_string.empty()) {
+            spec = CharsetSpec::parse(spec_string);
+            length = spec.length();
+        }
+        if (length != 0) {
+            if (length <= suffix_size) {
+                throw std::invalid_argument("length must be larger than the suffix size");
+            }
+            prefix_size = length - suffix_size;
+        }
+        length = prefix_size + suffix_size;
+        if (spec_string.empty()) {
+            spec = CharsetSpec::uniform(length, charset);
+        }
+
+        ModelMeetInTheMiddle mitm(model, prefix_size, suffix_size, spec, table_bits);
+        if (!has_target) {
+            target = rng() & model.mask();
+        }
+        std::cout << "Model: " << model.name() << " (" << model.bits() << "-bit, "
+                  << model.word_bytes() << "-byte words"
+                  << (model.has_batch() ? ", batch kernel" : "") << ")" << std::endl;
+        std::cout << "Target: 0x" << std::hex << target << std::dec << ", " << prefix_size
+                  << "-byte prefixes, " << suffix_size << "-byte suffixes" << std::endl;
+
+        auto start = std::chrono::steady_clock::now();
+        mitm.precompute(static_cast<uint32_t>(target));
+        const double precompute_time =
+            std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::cout << "Table of " << mitm.table_entries() << " suffixes built in " << std::fixed
+                  << std::setprecision(2) << precompute_time << " s" << std::endl;
+        std::cout.unsetf(std::ios::floatfield);
+
+        std::ofstream output_file;
+        if (!output.empty()) {
+            output_file.open(output);
+            if (!output_file) {
+                std::cerr << "Error: Could not open output file '" << output << "'" << std::endl;
+                return 1;
+            }
+        }
+        std::ostream& out = output.empty() ? std::cout : output_file;
+        hex_format::Buffer text(out);
+
+        std::vector<std::vector<uint8_t>> collisions;
+        std::mutex mutex;
+        PrefixRange range(mitm.prefix_count(), rng());
+        std::vector<uint64_t> tries(n_threads, 0);
+        start = std::chrono::steady_clock::now();
+        {
+            std::vector<std::thread> threads;
+            // The threads share the prefix range; each looks for its share of the collisions
+            for (unsigned t = 0; t < n_threads; ++t) {
+                const uint64_t share = n_collisions / n_threads + (t < n_collisions % n_threads);
+                if (share == 0) {
+                    continue;
+                }
+                threads.emplace_back([&, t, share]() {
+                    tries[t] = mitm.search(share, range, [&](const uint8_t* data, size_t size) {
+                        std::lock_guard<std::mutex> lock(mutex);
+                        collisions.emplace_back(data, data + size);
+                        if (!quiet) {
+                            text.hex(data, size).put('\n');
+                        }
+                    });
+                });
+            }
+            for (auto& thread : threads) {
+                thread.join();
+            }
+        }
+        const double search_time =
+            std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        uint64_t total_tries = 0;
+        for (uint64_t t : tries) {
+            total_tries += t;
+        }
+        text.flush();
+        std::cout << "Found " << collisions.size() << " collisions in " << std::fixed
+                  << std::setprecision(2) << search_time << " s, " << std::setprecision(1)
+                  << total_tries / search_time / 1e6 << " M prefixes/s" << std::endl;
+        std::cout.unsetf(std::ios::floatfield);
+        if (collisions.size() < n_collisions) {
+            std::cerr << "Warning: all " << range.count() << " prefixes tried, only "
+                      << collisions.size() << " collisions found" << std::endl;
+        }
+        if (!output.empty()) {
+            std::cout << "Collisions written to " << output << std::endl;
+        }
+        if (!corpus_path.empty()) {
+            CorpusInfo info;
+            info.model = "dsl:" + model.name();
+            info.hash_bits = model.bits();
+            info.target = target;
+            info.target_mask = model.mask();
+            info.seed = seed;
+            info.param("generator", "model_collisions").param("model_path", model_path);
+            if (!spec_string.empty()) {
+                info.param("spec", spec_string);
+            }
+            CorpusWriter corpus(corpus_path, info, mitm.length());
+            for (const auto& collision : collisions) {
+                corpus.add(collision.data(), collision.size());
+            }
+            corpus.finish();
+            std::cout << corpus.size() << " collisions written to corpus " << corpus_path << std::endl;
+        }
+
+        if (run_test) {
+            uint64_t passed = 0;
+            for (const auto& collision : collisions) {
+                passed += model.hash(collision.data(), collision.size()) == target &&
+                          spec.contains(collision.data(), collision.size());
+            }
+            std::cout << "\n=== Test Results ===" << std::endl;
+            std::cout << "Passed: " << passed << "/" << collisions.size() << std::endl;
+            std::cout << "Failed: " << collisions.size() - passed << "/" << collisions.size() << std::endl;
+            if (passed != collisions.size()) {
+                std::cout << "TEST FAILED: Some inputs do not hash to the target" << std::endl;
+                return 1;
+            }
+            std::cout << "TEST PASSED: All inputs hash to the target" << std::endl;
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,168 @@
+// model_mitm.h
+// Meet-in-the-middle collision search over a generated hash model
+// Author: Paul Bottinelli
+// For Black Hat EU 2025 - Cut to the QUIC: Slashing QUIC's Performance with a Hash DoS
+//
+// The algorithm of multiplicative-hash-mitm/mitm.h for any model compiled by hashgen.py:
+// the target digest is unfinalized for the full input length, every suffix is hashed
+// backward from that state into a CSR table, and prefixes are hashed forward until their
+// state lands in the table. Inputs are whole words, so prefix and suffix sizes are
+// multiples of the model's word size.
+//
+// Prefixes are enumerated in mixed radix over the CharsetSpec. Consecutive prefixes only
+// differ in their last word as long as no carry reaches the leading ones, so the state
+// after the leading words is computed once per block, and the last word of up to LANES
+// prefixes is absorbed by one call to the model's batch kernel (AVX2 when available).
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+#include "../common/hash_model.h"
+#include "../multiplicative-hash-mitm/charset.h"
+#include "../multiplicative-hash-mitm/prefix_enumerator.h"
+#include "../multiplicative-hash-mitm/suffix_table.h"
+
+class ModelMeetInTheMiddle {
+public:
+    // We upperbound the memory usage to 2^24 entries, as generic_mitm.py does
+    static constexpr unsigned MAX_TABLE_BITS = 24;
+    // Prefixes absorbed per batch kernel call
+    static constexpr size_t LANES = 256;
+
+    // spec constrains all prefix_size + suffix_size positions; an empty spec allows any byte.
+    // The table holds the first 2^table_bits suffixes at most.
+    ModelMeetInTheMiddle(const HashModel& model, size_t prefix_size, size_t suffix_size,
+                         const CharsetSpec& spec = CharsetSpec(), unsigned table_bits = MAX_TABLE_BITS)
+        : model_(model), prefix_size_(prefix_size), suffix_size_(suffix_size) {
+        if (model.bits() != 32) {
+            throw std::invalid_argument("meet-in-the-middle only supports 32-bit models");
+        }
+        const size_t word = model.word_bytes();
+        if (prefix_size == 0 || suffix_size == 0 || prefix_size % word || suffix_size % word) {
+            throw std::invalid_argument("prefix and suffix sizes must be positive multiples of the " +
+                                        std::to_string(word) + "-byte word of " + model.name());
+        }
+        const CharsetSpec full = spec.length() == 0
+            ? CharsetSpec::uniform(prefix_size + suffix_size, ByteSet::any()) : spec;
+        if (full.length() != prefix_size + suffix_size) {
+            throw std::invalid_argument("charset spec length must equal prefix + suffix size");
+        }
+        prefix_spec_ = full.slice(0, prefix_size);
+        suffix_spec_ = full.slice(prefix_size, prefix_size + suffix_size);
+        lead_spec_ = full.slice(0, prefix_size - word);
+        word_spec_ = full.slice(prefix_size - word, prefix_size);
+        word_count_ = word_spec_.count();
+        if (table_bits == 0 || table_bits > MAX_TABLE_BITS) {
+            throw std::invalid_argument("table bits must be between 1 and " + std::to_string(MAX_TABLE_BITS));
+        }
+        table_entries_ = std::min<uint64_t>(uint64_t(1) << table_bits, suffix_spec_.count());
+    }
+
+    size_t prefix_size() const noexcept { return prefix_size_; }
+    size_t suffix_size() const noexcept { return suffix_size_; }
+    size_t length() const noexcept { return prefix_size_ + suffix_size_; }
+    uint64_t table_entries() const noexcept { return table_entries_; }
+    uint32_t target() const noexcept { return target_; }
+
+    // Number of distinct prefixes the search enumerates: as in PrefixEnumerator, indices stay
+    // below 2^63 and the leading positions keep their first allowed byte beyond that
+    uint64_t prefix_count() const noexcept {
+        return std::min(prefix_spec_.count(), PrefixEnumerator::MAX_COUNT);
+    }
+
+    void suffix(uint32_t index, uint8_t* out) const noexcept { suffix_spec_.decode(index, out); }
+
+    // Fill the table for target. progress(i, total) is called periodically.
+    template <typename Progress>
+    void precompute(uint32_t target, Progress progress) {
+        target_ = target;
+        const uint32_t state = static_cast<uint32_t>(model_.unfinalize(target, length()));
+        const uint64_t total = table_entries();
+        const uint64_t increment_display = std::max<uint64_t>(total / 1000, 1);
+        std::vector<std::pair<uint32_t, uint32_t>> entries(total);
+        std::vector<uint8_t> s(suffix_size_);
+        for (uint64_t i = 0; i < total; ++i) {
+            if (i % increment_display == 0 || i == total - 1) {
+                progress(i, total);
+            }
+            suffix(static_cast<uint32_t>(i), s.data());
+            entries[i] = {static_cast<uint32_t>(model_.backward(state, s.data(), suffix_size_)),
+                          static_cast<uint32_t>(i)};
+        }
+        table_.build(entries);
+    }
+
+    void precompute(uint32_t target) {
+        precompute(target, [](uint64_t, uint64_t) {});
+    }
+
+    // Search prefixes of range for up to n_collisions collisions, calling
+    // emit(data, length) for each of them. Thread-safe given a thread-safe emit; threads
+    // sharing range never try the same prefix. Returns the number of prefixes tried.
+    template <typename Emit>
+    uint64_t search(uint64_t n_collisions, PrefixRange& range, Emit emit) const {
+        const size_t word = model_.word_bytes();
+        std::vector<uint8_t> collision(length());
+        std::vector<uint8_t> words(LANES * word);
+        uint32_t states[LANES];
+        const uint64_t count = prefix_count();
+        uint64_t tries = 0;
+        uint64_t n = 0;
+        uint64_t first;
+        uint64_t size;
+        while (n != n_collisions && range.claim(first, size)) {
+            for (uint64_t done = 0; done < size && n != n_collisions;) {
+                // Prefixes index, index + 1, ... share their leading words up to the next
+                // multiple of the last word's radix
+                const uint64_t index = (first + done) % count;
+                const uint64_t inner = index % word_count_;
+                const size_t lanes = static_cast<size_t>(
+                    std::min<uint64_t>({LANES, word_count_ - inner, size - done, count - index}));
+                lead_spec_.decode(index / word_count_, collision.data());
+                const uint32_t base = static_cast<uint32_t>(
+                    model_.forward(model_.initial_value(), collision.data(), prefix_size_ - word));
+                for (size_t l = 0; l < lanes; ++l) {
+                    word_spec_.decode(inner + l, &words[l * word]);
+                    states[l] = base;
+                }
+                if (model_.has_batch()) {
+                    model_.forward_batch(states, words.data(), 1, lanes);
+                } else {
+                    for (size_t l = 0; l < lanes; ++l) {
+                        states[l] = static_cast<uint32_t>(model_.forward(base, &words[l * word], word));
+                    }
+                }
+                for (size_t l = 0; l < lanes && n != n_collisions; ++l) {
+                    table_.find(states[l], [&](uint32_t suffix_index) {
+                        std::copy(&words[l * word], &words[(l + 1) * word],
+                                  &collision[prefix_size_ - word]);
+                        suffix(suffix_index, &collision[prefix_size_]);
+                        emit(collision.data(), collision.size());
+                        return ++n != n_collisions;
+                    });
+                }
+                done += lanes;
+                tries += lanes;
+            }
+        }
+        return tries;
+    }
+
+private:
+    const HashModel& model_;
+    size_t prefix_size_;
+    size_t suffix_size_;
+    CharsetSpec prefix_spec_;
+    CharsetSpec suffix_spec_;
+    CharsetSpec lead_spec_;  // prefix positions before its last word
+    CharsetSpec word_spec_;  // positions of the last prefix word
+    uint64_t word_count_;
+    uint64_t table_entries_;
+    uint32_t target_ = 0;
+    CsrSuffixTable table_;
+};
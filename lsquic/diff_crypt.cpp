@@ -16,74 +16,50 @@
 #include <random>
 #include <string>
 #include <algorithm>
+#include <thread>
+#include <memory>
+#include <exception>
+#include "../common/corpus.h"
+#include "../common/hex_format.h"
+#include "../common/lease.h"
+#include "../common/shm_ring.h"
+#include "diff_pipeline.h"
+#include "differential.h"
 #include "xxhash32.h"
 
-// XXHash32 constants and their modular inverses (mod 2^32)
-constexpr uint32_t Prime3 = 3266489917U;
-constexpr uint32_t inv_Prime3 = 2828982549U;
-constexpr uint32_t inv_Prime4 = 2701016015U;
-
 // Configuration constants
-constexpr uint8_t NUM_VERIFICATION_TESTS = 20;     // Number of random tests per differential
 constexpr size_t DEFAULT_MAX_PAIRS = 100;          // Default maximum pairs to collect
-constexpr size_t PROGRESS_UPDATE_INTERVAL = 10000; // Progress bar update frequency
-constexpr size_t ARRAY_SIZE = 8;                    // Size of input arrays
-
-// Rotate bits right (should compile to a single CPU instruction - ROR)
-inline constexpr uint32_t rotateRight(uint32_t x, unsigned char bits) noexcept {
-    return (x >> bits) | (x << (32 - bits));
-}
-
-// Convert 4-byte array to uint32_t (little-endian)
-inline uint32_t bytes_to_uint32(const uint8_t* bytes) noexcept {
-    return static_cast<uint32_t>(bytes[0]) |
-           (static_cast<uint32_t>(bytes[1]) << 8) |
-           (static_cast<uint32_t>(bytes[2]) << 16) |
-           (static_cast<uint32_t>(bytes[3]) << 24);
-}
-
-// Convert uint32_t to 4-byte array (little-endian)
-inline std::array<uint8_t, 4> uint32_to_bytes(uint32_t value) noexcept {
-    return {
-        static_cast<uint8_t>(value & 0xFF),
-        static_cast<uint8_t>((value >> 8) & 0xFF),
-        static_cast<uint8_t>((value >> 16) & 0xFF),
-        static_cast<uint8_t>((value >> 24) & 0xFF)
-    };
-}
-
-// Print uint8 array in hexadecimal format
-inline void print_uint8_array(const uint8_t* array, size_t length) {
-    for (size_t i = 0; i < length; ++i) {
-        std::cout << std::hex << std::setw(2) << std::setfill('0')
-                  << static_cast<int>(array[i]) << " ";
+constexpr double PROGRESS_UPDATE_INTERVAL = 0.1;   // Seconds between progress bar updates
+constexpr uint64_t DEFAULT_LEASE_SIZE = uint64_t(1) << 26;  // First differences per lease
+constexpr double DEFAULT_LEASE_TIMEOUT = 30;       // Seconds before a silent lease is re-issued
+constexpr const char* DEFAULT_SHARD_DIR = "diff_crypt.shards";
+
+// Print an 8-byte array in hexadecimal format, one line written at once
+inline void print_uint8_array(const uint8_t* array) {
+    char line[3 * ARRAY_SIZE + 1];
+    char* out = line;
+    for (size_t i = 0; i < ARRAY_SIZE; ++i) {
+        out = hex_format::encode_hex(array + i, 1, out);
+        *out++ = ' ';
     }
-    std::cout << std::dec << std::endl;
-}
-
-// Apply differences to 8-byte array (first diff to first 4 bytes, second diff to last 4 bytes)
-inline std::array<uint8_t, ARRAY_SIZE> apply_diffs_to_array(
-    const uint8_t* input, uint32_t diff1, uint32_t diff2) noexcept {
-
-    std::array<uint8_t, ARRAY_SIZE> output;
-
-    // Apply diff1 to first 4 bytes
-    auto first_bytes = uint32_to_bytes(bytes_to_uint32(input) + diff1);
-    std::copy(first_bytes.begin(), first_bytes.end(), output.begin());
-
-    // Apply diff2 to last 4 bytes
-    auto last_bytes = uint32_to_bytes(bytes_to_uint32(&input[4]) + diff2);
-    std::copy(last_bytes.begin(), last_bytes.end(), output.begin() + 4);
-
-    return output;
+    *out++ = '\n';
+    std::cout.write(line, out - line);
 }
 
-// Compute the chunk value needed to reach target hash from a given intermediate state
-// This reverses one round of XXHash32 computation
-inline uint32_t back_round_for_chunk(uint32_t target, uint32_t middle_value) noexcept {
-    uint32_t result = target * inv_Prime4;
-    result = rotateRight(result, 17);
-    return (result - middle_value) * inv_Prime3;
+// Parse a string of 2*ARRAY_SIZE hexadecimal digits into an 8-byte array
+// Returns false if the string is malformed
+inline bool parse_hex_array(const std::string& hex, std::array<uint8_t, ARRAY_SIZE>& output) {
+    if (hex.size() != 2 * ARRAY_SIZE) {
+        return false;
+    }
+    for (size_t i = 0; i < ARRAY_SIZE; ++i) {
+        const std::string byte = hex.substr(2 * i, 2);
+        if (byte.find_first_not_of("0123456789abcdefABCDEF") != std::string::npos) {
+            return false;
+        }
+        output[i] = static_cast<uint8_t>(std::stoul(byte, nullptr, 16));
+    }
+    return true;
 }
 
 // Function to display the progress bar
@@ -101,106 +77,183 @@ void show_progress(uint64_t current, uint64_t total, int n_found, int bar_length
 }
 
 
-// Test a differential hypothesis multiple times with random inputs and seeds
-// Returns true if all tests produce collisions, false if any test fails
-// Note: Tests n different seeds, with n random inputs per seed (total n*n tests)
-bool test_single_hypothesis_n_times(uint32_t diff1, uint32_t diff2, uint8_t n,
-                                    std::mt19937& rng) {
-    std::uniform_int_distribution<uint32_t> dist(0, 255);
+// Search for differential characteristics that produce hash collisions
+// Returns a vector of (diff1, diff2) pairs that create collisions, in the order the
+// verification stage confirms them
+// Bits set in fixed_mask (e.g. a version byte) must be left unchanged by the differences:
+// only the diff1 values keeping them are enumerated, and diff2 values that would change
+// them are rejected before the (much more expensive) verification.
+// Runs the staged search of diff_pipeline.h and stores its per-stage report in report.
+// Each colliding array is also published to ring, if any, as soon as it is verified.
+std::vector<std::pair<uint32_t, uint32_t>> compute_all_differences(
+    const uint8_t* input_array, size_t max_pairs, std::mt19937& rng,
+    const uint8_t* fixed_mask, const PipelineConfig& config, PipelineReport& report,
+    ShmRingWriter* ring = nullptr) {
 
-    for (size_t j = 0; j < n; ++j) {
-        // Generate random seed
-        std::array<uint8_t, 4> seed_array;
-        for (auto& byte : seed_array) {
-            byte = static_cast<uint8_t>(dist(rng));
-        }
-        const uint32_t seed = bytes_to_uint32(seed_array.data());
-
-        // Test n times with different random inputs
-        for (size_t i = 0; i < n; ++i) {
-            // Generate random 8-byte array
-            std::array<uint8_t, ARRAY_SIZE> array1;
-            for (auto& byte : array1) {
-                byte = static_cast<uint8_t>(dist(rng));
+    std::vector<std::pair<uint32_t, uint32_t>> successful_diffs;
+    successful_diffs.reserve(max_pairs);
+    std::exception_ptr ring_error;
+
+    // Collect up to max_pairs successful pairs
+    report = run_difference_pipeline(
+        input_array, rng, fixed_mask, config,
+        [&](uint32_t diff1, uint32_t diff2) {
+            successful_diffs.emplace_back(diff1, diff2);
+            if (ring) {
+                // The pipeline threads are still running: stop them before rethrowing
+                try {
+                    const auto modified_array = apply_diffs_to_array(input_array, diff1, diff2);
+                    ring->add(modified_array.data(), ARRAY_SIZE);
+                } catch (...) {
+                    ring_error = std::current_exception();
+                    return false;
+                }
             }
+            return successful_diffs.size() < max_pairs;
+        },
+        [](uint64_t i, uint64_t total, uint64_t n_found) {
+            show_progress(i, total, static_cast<int>(n_found));
+        });
+    if (ring_error) {
+        std::rethrow_exception(ring_error);
+    }
 
-            // Compute its hash
-            const uint32_t hash_result = XXHash32::hash_no_final_bit_mixing(
-                array1.data(), ARRAY_SIZE, seed);
-
-            // Apply diffs to array1
-            const auto array2 = apply_diffs_to_array(array1.data(), diff1, diff2);
-
-            // Compute its hash
-            const uint32_t hash_result2 = XXHash32::hash_no_final_bit_mixing(
-                array2.data(), ARRAY_SIZE, seed);
+    return successful_diffs;
+}
 
-            if (hash_result != hash_result2) {
-                return false;
+// Sweep the first differences of the leases of a coordinator (--worker), until it is done.
+// The base array, fixed mask and seed come from the coordinator, and every lease is swept
+// with a generator seeded from the lease, so that any worker finds the same arrays.
+int run_worker(const std::string& address, double wait, const PipelineConfig& config) {
+    try {
+        LeaseWorker worker(address, wait);
+        const LeaseJob& job = worker.job();
+        std::array<uint8_t, ARRAY_SIZE> base;
+        std::array<uint8_t, ARRAY_SIZE> fixed_mask;
+        if (job.get("tool") != "diff_crypt" || !parse_hex_array(job.get("base"), base) ||
+            !parse_hex_array(job.get("fixed_mask"), fixed_mask) || worker.record_size() != ARRAY_SIZE) {
+            throw std::runtime_error("coordinator " + address + " runs another job: " + job.line());
+        }
+        const uint64_t seed = job.number("seed");
+        std::cout << "Working for " << address << " on base " << job.get("base") << std::endl;
+
+        Lease lease;
+        std::vector<uint8_t> records;
+        uint64_t n_leases = 0;
+        while (worker.next(lease)) {
+            PipelineConfig lease_config = config;
+            lease_config.first = lease.first + 1;
+            lease_config.last = lease.first + lease.size;
+            lease_config.candidate_seeds = true;
+            std::mt19937 rng(static_cast<uint32_t>(lease_seed(seed, lease.id)));
+            records.clear();
+            const PipelineReport report = run_difference_pipeline(
+                base.data(), rng, fixed_mask.data(), lease_config,
+                [&](uint32_t diff1, uint32_t diff2) {
+                    const auto modified_array = apply_diffs_to_array(base.data(), diff1, diff2);
+                    records.insert(records.end(), modified_array.begin(), modified_array.end());
+                    return true;
+                },
+                [](uint64_t, uint64_t, uint64_t) {});
+            std::cout << "Lease " << lease.id << ": " << records.size() / ARRAY_SIZE
+                      << " colliding arrays in " << std::fixed << std::setprecision(2)
+                      << report.seconds << " s" << std::endl;
+            std::cout.unsetf(std::ios::floatfield);
+            if (!worker.complete(lease, records)) {
+                break;
             }
+            ++n_leases;
         }
+        std::cout << "Coordinator done, " << n_leases << " leases swept" << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
     }
-
-    return true;
+    return 0;
 }
 
-// Search for differential characteristics that produce hash collisions
-// Returns a vector of (diff1, diff2) pairs that create collisions
-std::vector<std::pair<uint32_t, uint32_t>> compute_all_differences(
-    const uint8_t* input_array, size_t max_pairs, std::mt19937& rng) {
+// Split the sweep into leases served to workers (--coordinate), then return the
+// differentials of the merged shards, in lease order
+std::vector<std::pair<uint32_t, uint32_t>> coordinate_differences(
+    const uint8_t* input_array, const uint8_t* fixed_mask, uint64_t max_pairs, uint64_t seed,
+    const CorpusInfo& info, LeaseCoordinator::Config config) {
+
+    std::mt19937 unused;
+    config.space = DifferenceFilter(input_array, fixed_mask, unused).count();
+    config.record_size = ARRAY_SIZE;
+    config.limit = max_pairs;
+    LeaseJob job;
+    job.set("tool", "diff_crypt")
+        .set("base", hex_format::hex_string(input_array, ARRAY_SIZE))
+        .set("fixed_mask", hex_format::hex_string(fixed_mask, ARRAY_SIZE))
+        .set("seed", seed);
+    LeaseCoordinator coordinator(config, job, info);
+    coordinator.run(std::cout);
 
-    constexpr uint32_t myseed = 0;
     std::vector<std::pair<uint32_t, uint32_t>> successful_diffs;
-    successful_diffs.reserve(max_pairs);
-
-    const uint32_t last_four_bytes = bytes_to_uint32(&input_array[4]);
-    const uint32_t hash_result = XXHash32::hash_no_final_bit_mixing(
-        input_array, ARRAY_SIZE, myseed);
-
-    constexpr uint32_t total_loop = 4294967295U;  // Search through all possible 32-bit differences
-    uint32_t total_count = 0;
-
-    for (size_t i = 1; i < total_loop; ++i) {
-        const uint32_t diff = static_cast<uint32_t>(i);
-        const uint32_t m1 = bytes_to_uint32(input_array) + diff;
-
-        // Note: We pass length=8 even though the array is 4 bytes
-        // The length parameter is used for hash state initialization, not for reading
-        // The function only reads what's actually in the buffer (4 bytes)
-        const auto m1_bytes = uint32_to_bytes(m1);
-        const uint32_t intermediate_hash = XXHash32::hash_single_round(
-            m1_bytes.data(), ARRAY_SIZE, myseed);
-
-        const uint32_t chunk = back_round_for_chunk(hash_result, intermediate_hash);
-        const uint32_t diff2 = chunk - last_four_bytes;
-
-        // Test if this differential produces collisions with random inputs
-        if (test_single_hypothesis_n_times(diff, diff2, NUM_VERIFICATION_TESTS, rng)) {
-            ++total_count;
+    coordinator.merge([&](const uint8_t* record, size_t) {
+        successful_diffs.emplace_back(bytes_to_uint32(record) - bytes_to_uint32(input_array),
+                                      bytes_to_uint32(record + 4) - bytes_to_uint32(input_array + 4));
+    });
+    return successful_diffs;
+}
 
-            // Collect up to max_pairs successful pairs
-            if (successful_diffs.size() < max_pairs) {
-                successful_diffs.emplace_back(diff, diff2);
-            } else {
-                break;  // Stop once we have enough pairs
-            }
+// Print the queue depth and utilization of every pipeline stage
+void print_pipeline_report(const PipelineReport& report) {
+    std::cout << "\n=== Pipeline ===" << std::endl;
+    std::cout << report.candidates << " candidates in " << std::fixed << std::setprecision(2)
+              << report.seconds << " s (" << std::setprecision(1)
+              << report.candidates / std::max(report.seconds, 1e-9) / 1e6 << " M/s)" << std::endl;
+    const StageReport* busiest = &report.stages.front();
+    for (const StageReport& stage : report.stages) {
+        std::cout << "  " << std::setfill(' ') << std::left << std::setw(7) << stage.name << std::right << stage.threads
+                  << (stage.threads == 1 ? " thread,  " : " threads, ") << stage.items_in << " in, "
+                  << stage.items_out << " out, " << std::setprecision(1)
+                  << 100.0 * stage.utilization << "% busy";
+        if (stage.queue_capacity != 0) {
+            std::cout << ", input queue " << std::setprecision(1) << stage.queue_average
+                      << " avg / " << stage.queue_max << " max / " << stage.queue_capacity;
         }
-
-        // Display progress periodically
-        if (i % PROGRESS_UPDATE_INTERVAL == 0) {
-            show_progress(i, total_loop, total_count);
+        std::cout << std::endl;
+        if (stage.utilization > busiest->utilization) {
+            busiest = &stage;
         }
     }
-
-    return successful_diffs;
+    std::cout << "Bottleneck: " << busiest->name << std::endl;
+    std::cout.unsetf(std::ios::floatfield);
 }
 
-
 int main(int argc, char* argv[]) {
     // Parse command line arguments
     size_t max_pairs = DEFAULT_MAX_PAIRS;
     bool run_test = false;
     bool quiet = false;
+    bool has_base = false;
+    bool has_max_pairs = false;
+    bool has_seed = false;
+    uint32_t rng_seed = 0;
+    std::string corpus_path;
+    std::string ring_name;
+    std::string coordinate_address;
+    std::string worker_address;
+    double worker_wait = 10;
+    LeaseCoordinator::Config lease_config;
+    lease_config.shard_dir = DEFAULT_SHARD_DIR;
+    lease_config.lease_size = DEFAULT_LEASE_SIZE;
+    lease_config.timeout = DEFAULT_LEASE_TIMEOUT;
+    const unsigned hardware_threads = std::max(1u, std::thread::hardware_concurrency());
+    PipelineConfig config;
+    config.filter_threads = std::max(1u, hardware_threads / 2);
+    config.verify_threads = std::max(1u, hardware_threads - config.filter_threads);
+    config.progress_interval = PROGRESS_UPDATE_INTERVAL;
+    std::array<uint8_t, ARRAY_SIZE> myarray;
+    std::array<uint8_t, ARRAY_SIZE> fixed_mask{};
+
+    const std::string usage = std::string("Usage: ") + argv[0] +
+        " [max_pairs] [--test] [--quiet|-q] [--base hex] [--fixed-mask hex]"
+        " [--filter-threads n] [--verify-threads n] [--corpus path] [--shm name] [--seed seed]"
+        " [--coordinate address [--shards dir] [--lease-size n] [--lease-timeout seconds]]"
+        " [--worker address [--wait seconds]]";
 
     for (int i = 1; i < argc; i++) {
         std::string arg = argv[i];
@@ -208,38 +261,160 @@ int main(int argc, char* argv[]) {
             run_test = true;
         } else if (arg == "--quiet" || arg == "-q") {
             quiet = true;
+        } else if (arg == "--base" || arg == "--fixed-mask") {
+            auto& target = (arg == "--base") ? myarray : fixed_mask;
+            if (i + 1 >= argc || !parse_hex_array(argv[++i], target)) {
+                std::cerr << "Error: " << arg << " expects " << 2 * ARRAY_SIZE
+                          << " hexadecimal digits" << std::endl;
+                std::cerr << usage << std::endl;
+                return 1;
+            }
+            has_base = has_base || arg == "--base";
+        } else if (arg == "--corpus" || arg == "--shm") {
+            if (i + 1 >= argc) {
+                std::cerr << "Error: " << arg << " expects " << (arg == "--corpus" ? "a path" : "a name") << std::endl;
+                std::cerr << usage << std::endl;
+                return 1;
+            }
+            (arg == "--corpus" ? corpus_path : ring_name) = argv[++i];
+        } else if (arg == "--coordinate" || arg == "--worker" || arg == "--shards") {
+            if (i + 1 >= argc) {
+                std::cerr << "Error: " << arg << " expects " << (arg == "--shards" ? "a directory" : "an address")
+                          << std::endl;
+                std::cerr << usage << std::endl;
+                return 1;
+            }
+            (arg == "--coordinate" ? coordinate_address : arg == "--worker" ? worker_address
+                                                                             : lease_config.shard_dir) = argv[++i];
+        } else if (arg == "--lease-size" || arg == "--seed") {
+            const long long input = (i + 1 < argc) ? std::atoll(argv[++i]) : 0;
+            if (input <= 0 || (arg == "--seed" && input > UINT32_MAX)) {
+                std::cerr << "Error: " << arg << " expects a positive integer" << std::endl;
+                std::cerr << usage << std::endl;
+                return 1;
+            }
+            if (arg == "--seed") {
+                rng_seed = static_cast<uint32_t>(input);
+                has_seed = true;
+            } else {
+                lease_config.lease_size = static_cast<uint64_t>(input);
+            }
+        } else if (arg == "--lease-timeout" || arg == "--wait") {
+            const double input = (i + 1 < argc) ? std::atof(argv[++i]) : 0;
+            if (input <= 0) {
+                std::cerr << "Error: " << arg << " expects a positive number of seconds" << std::endl;
+                std::cerr << usage << std::endl;
+                return 1;
+            }
+            (arg == "--wait" ? worker_wait : lease_config.timeout) = input;
+        } else if (arg == "--filter-threads" || arg == "--verify-threads") {
+            auto& threads = (arg == "--filter-threads") ? config.filter_threads : config.verify_threads;
+            const long long input = (i + 1 < argc) ? std::atoll(argv[++i]) : 0;
+            if (input <= 0) {
+                std::cerr << "Error: " << arg << " expects a positive number of threads" << std::endl;
+                std::cerr << usage << std::endl;
+                return 1;
+            }
+            threads = static_cast<unsigned>(input);
         } else {
             // Assume it's the max_pairs argument
             long long input = std::atoll(argv[i]);
             if (input <= 0) {
                 std::cerr << "Error: max_pairs must be a positive integer" << std::endl;
-                std::cerr << "Usage: " << argv[0] << " [max_pairs] [--test] [--quiet|-q]" << std::endl;
+                std::cerr << usage << std::endl;
                 return 1;
             }
             // Upper bound by UINT32_MAX since that's the search space
             max_pairs = (input > UINT32_MAX) ? UINT32_MAX : static_cast<size_t>(input);
+            has_max_pairs = true;
         }
     }
 
+    if (!worker_address.empty()) {
+        return run_worker(worker_address, worker_wait, config);
+    }
+    // Coordinated sweeps cover every first difference unless told otherwise
+    if (!coordinate_address.empty() && !has_max_pairs) {
+        max_pairs = UINT32_MAX;
+    }
+
     std::cout << "Searching for up to " << max_pairs << " differential pairs..." << std::endl;
 
     // Initialize C++11 random number generator
-    std::random_device rd;
-    std::mt19937 rng(rd());
+    if (!has_seed) {
+        rng_seed = std::random_device{}();
+    }
+    std::mt19937 rng(rng_seed);
     std::uniform_int_distribution<uint32_t> dist(0, 255);
 
-    // Generate random 8-byte array
-    std::array<uint8_t, ARRAY_SIZE> myarray;
-    for (auto& byte : myarray) {
-        byte = static_cast<uint8_t>(dist(rng));
+    // Generate random 8-byte array, unless given
+    if (!has_base) {
+        for (auto& byte : myarray) {
+            byte = static_cast<uint8_t>(dist(rng));
+        }
     }
 
     // Print the original array
     std::cout << "Original array: ";
-    print_uint8_array(myarray.data(), ARRAY_SIZE);
+    print_uint8_array(myarray.data());
+    std::cout << "Fixed bit mask: ";
+    print_uint8_array(fixed_mask.data());
+
+    // The original array and the arrays colliding with it are streamed to a consumer as
+    // they are found
+    constexpr uint32_t myseed = 0;
+    const uint32_t original_hash = XXHash32::hash(myarray.data(), ARRAY_SIZE, myseed);
+    std::unique_ptr<ShmRingWriter> ring;
+    if (!ring_name.empty()) {
+        try {
+            CorpusInfo info;
+            info.model = "xxh32:0";
+            info.target = original_hash;
+            info.target_mask = UINT32_MAX;
+            info.seed = rng_seed;
+            ring.reset(new ShmRingWriter(ring_name, info, ARRAY_SIZE));
+            ring->add(myarray.data(), ARRAY_SIZE);
+        } catch (const std::exception& e) {
+            std::cerr << "Error: " << e.what() << std::endl;
+            return 1;
+        }
+    }
 
-    // Pass it to compute_all_differences
-    auto diff_pairs = compute_all_differences(myarray.data(), max_pairs, rng);
+    // Pass it to compute_all_differences, or to the workers
+    PipelineReport report;
+    std::vector<std::pair<uint32_t, uint32_t>> diff_pairs;
+    try {
+        if (coordinate_address.empty()) {
+            diff_pairs = compute_all_differences(myarray.data(), max_pairs, rng, fixed_mask.data(),
+                                                 config, report, ring.get());
+        } else {
+            CorpusInfo info;
+            info.model = "xxh32:0";
+            info.target = original_hash;
+            info.target_mask = UINT32_MAX;
+            info.seed = rng_seed;
+            info.param("generator", "diff_crypt");
+            lease_config.address = coordinate_address;
+            diff_pairs = coordinate_differences(myarray.data(), fixed_mask.data(), max_pairs, rng_seed,
+                                                info, lease_config);
+            if (ring) {
+                for (const auto& pair : diff_pairs) {
+                    const auto modified_array = apply_diffs_to_array(myarray.data(), pair.first, pair.second);
+                    ring->add(modified_array.data(), ARRAY_SIZE);
+                }
+            }
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "\nError: " << e.what() << std::endl;
+        return 1;
+    }
+    if (ring) {
+        ring->finish();
+        std::cout << "\n" << ring->size() << " colliding arrays published to ring " << ring_name << std::endl;
+    }
+    if (coordinate_address.empty()) {
+        print_pipeline_report(report);
+    }
 
     // Print summary of successful differences
     std::cout << "\n=== Summary ===" << std::endl;
@@ -248,16 +423,40 @@ int main(int argc, char* argv[]) {
     // Only print individual pairs if not in quiet mode
     if (!quiet) {
         std::cout << "Successful (diff1, diff2) pairs:" << std::endl;
+        hex_format::Buffer text(std::cout);
         for (const auto& pair : diff_pairs) {
-            std::cout << "  (0x" << std::hex << pair.first << ", 0x" << pair.second << ")" << std::dec << std::endl;
+            text.append("  (0x").uint(pair.first).append(", 0x").uint(pair.second).append(")\n");
         }
     }
 
     // Print the hash of myarray
-    constexpr uint32_t myseed = 0;
-    const uint32_t original_hash = XXHash32::hash(myarray.data(), ARRAY_SIZE, myseed);
     std::cout << "\nOriginal hash: 0x" << std::hex << original_hash << std::dec << std::endl;
 
+    // The original array and all the arrays colliding with it, as a corpus
+    if (!corpus_path.empty()) {
+        try {
+            CorpusInfo info;
+            info.model = "xxh32:0";
+            info.target = original_hash;
+            info.target_mask = UINT32_MAX;
+            info.seed = rng_seed;
+            info.param("generator", "diff_crypt")
+                .param("base", hex_format::hex_string(myarray.data(), ARRAY_SIZE))
+                .param("fixed_mask", hex_format::hex_string(fixed_mask.data(), ARRAY_SIZE));
+            CorpusWriter corpus(corpus_path, info, ARRAY_SIZE);
+            corpus.add(myarray.data(), ARRAY_SIZE);
+            for (const auto& pair : diff_pairs) {
+                const auto modified_array = apply_diffs_to_array(myarray.data(), pair.first, pair.second);
+                corpus.add(modified_array.data(), ARRAY_SIZE);
+            }
+            corpus.finish();
+            std::cout << corpus.size() << " colliding arrays written to corpus " << corpus_path << std::endl;
+        } catch (const std::exception& e) {
+            std::cerr << "Error: " << e.what() << std::endl;
+            return 1;
+        }
+    }
+
     // Test mode: verify collisions with applied differentials
     if (run_test) {
         std::cout << "\n=== Running Verification Test ===" << std::endl;
@@ -268,7 +467,8 @@ int main(int argc, char* argv[]) {
             const auto modified_array = apply_diffs_to_array(myarray.data(), pair.first, pair.second);
             const uint32_t new_hash = XXHash32::hash(modified_array.data(), ARRAY_SIZE, myseed);
 
-            if (new_hash == original_hash) {
+            if (new_hash == original_hash &&
+                fixed_bits_unchanged(myarray.data(), modified_array.data(), fixed_mask.data())) {
                 passed++;
             } else {
                 failed++;
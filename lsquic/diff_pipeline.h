@@ -0,0 +1,430 @@
+// diff_pipeline.h
+// Staged, multi-threaded version of the differential search of differential.h
+// Author: Paul Bottinelli
+// For Black Hat EU 2025 - Cut to the QUIC: Slashing QUIC's Performance with a Hash DoS
+//
+// search_differences runs candidate generation, verification and result storage inline,
+// one candidate at a time. Here they are three stages connected by bounded lock-free
+// queues (common/mpmc_queue.h):
+//
+//   filter  --candidates-->  verify  --differentials-->  output
+//
+// - filter: threads claim chunks of the D1 sweep and test 8 candidates at a time (AVX2)
+//   against a few random inner states. For 8-byte inputs, (D1, D2) collides for the state
+//   u = seed + Prime5 + 8 + A * Prime3 exactly when
+//       (rotl(u + D1 * Prime3, 17) - rotl(u, 17)) * Prime4 == -D2 * Prime3
+//   so each test is one of the random-input tests of the verification, done in registers.
+//   Almost every candidate fails the first one.
+// - verify: a pool of threads, each with its own generator, runs the full
+//   test_single_hypothesis_n_times on the survivors.
+// - output: the calling thread stores the differentials, reports progress and samples the
+//   queue depths; it is the only stage calling back into the caller.
+//
+// A stage waiting on an empty (or full) queue backs off and counts that time as idle, so
+// that every stage reports its utilization. Differentials arrive in completion order.
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "../common/mpmc_queue.h"
+#include "differential.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+// Tests every candidate of the D1 sweep of search_differences against a few inner states
+class DifferenceFilter {
+public:
+    static constexpr size_t TESTS = 32;  // random inner states per candidate
+    static constexpr size_t LANES = 8;
+
+    // The inner states are drawn from rng
+    DifferenceFilter(const uint8_t* input_array, const uint8_t* fixed_mask, std::mt19937& rng) {
+        a_ = bytes_to_uint32(input_array);
+        b_ = bytes_to_uint32(&input_array[4]);
+        fixed1_ = fixed_mask ? bytes_to_uint32(fixed_mask) : 0;
+        fixed2_ = fixed_mask ? bytes_to_uint32(&fixed_mask[4]) : 0;
+        free1_ = ~fixed1_;
+        free_width_ = static_cast<unsigned>(__builtin_popcount(free1_));
+        start_ = extract(a_ & free1_);
+        // State before the first word for seed 0, and the state the last word must reach
+        initial_ = static_cast<uint32_t>(ARRAY_SIZE) + Prime5;
+        const uint32_t hash_result = XXHash32::hash_no_final_bit_mixing(input_array, ARRAY_SIZE, 0);
+        reach_ = rotateRight(hash_result * inv_Prime4, 17);
+        for (size_t t = 0; t < TESTS; ++t) {
+            states_[t] = static_cast<uint32_t>(rng());
+            rotated_[t] = rotateLeft(states_[t], 17);
+        }
+    }
+
+    // Number of candidates, numbered 1 to count() in the order of search_differences
+    uint64_t count() const noexcept { return (uint64_t(1) << free_width_) - 1; }
+
+    // Test candidates first to first + size - 1, appending the (diff1, diff2) survivors
+    void run(uint64_t first, uint64_t size, std::vector<std::pair<uint32_t, uint32_t>>& out) const {
+        const uint64_t width_mask = count();
+        uint32_t free_bits = deposit((start_ + first) & width_mask);
+        alignas(32) uint32_t m1[LANES];
+        uint64_t done = 0;
+        for (; done + LANES <= size; done += LANES) {
+            for (size_t l = 0; l < LANES; ++l) {
+                m1[l] = (a_ & fixed1_) | free_bits;
+                free_bits = ((free_bits | fixed1_) + 1) & free1_;
+            }
+            unsigned passed = test8(m1);
+            while (passed) {
+                const int l = __builtin_ctz(passed);
+                passed &= passed - 1;
+                keep(m1[l], out);
+            }
+        }
+        for (; done < size; ++done) {
+            const uint32_t m = (a_ & fixed1_) | free_bits;
+            free_bits = ((free_bits | fixed1_) + 1) & free1_;
+            if (test(m)) {
+                keep(m, out);
+            }
+        }
+    }
+
+private:
+    uint32_t a_, b_;
+    uint32_t fixed1_, fixed2_, free1_;
+    unsigned free_width_;
+    uint64_t start_;     // counter value of the original first word
+    uint32_t initial_;
+    uint32_t reach_;     // state before the last round plus the last word times Prime3
+    uint32_t states_[TESTS];
+    uint32_t rotated_[TESTS];
+
+    static uint32_t rotateLeft(uint32_t x, unsigned bits) noexcept {
+        return (x << bits) | (x >> (32 - bits));
+    }
+
+    // Counter value of the free bits of x, and its inverse
+    uint64_t extract(uint32_t x) const noexcept {
+        uint64_t value = 0;
+        unsigned bit = 0;
+        for (uint32_t free = free1_; free; free &= free - 1, ++bit) {
+            value |= uint64_t((x >> __builtin_ctz(free)) & 1) << bit;
+        }
+        return value;
+    }
+
+    uint32_t deposit(uint64_t value) const noexcept {
+        uint32_t x = 0;
+        for (uint32_t free = free1_; free; free &= free - 1, value >>= 1) {
+            x |= static_cast<uint32_t>(value & 1) << __builtin_ctz(free);
+        }
+        return x;
+    }
+
+    // Scalar version of test8
+    bool test(uint32_t m1) const noexcept {
+        const uint32_t intermediate = rotateLeft(initial_ + m1 * Prime3, 17) * Prime4;
+        const uint32_t chunk = (reach_ - intermediate) * inv_Prime3;
+        if ((chunk ^ b_) & fixed2_) {
+            return false;
+        }
+        const uint32_t d1 = (m1 - a_) * Prime3;
+        const uint32_t d2 = (chunk - b_) * Prime3;
+        for (size_t t = 0; t < TESTS; ++t) {
+            if ((rotateLeft(states_[t] + d1, 17) - rotated_[t]) * Prime4 + d2 != 0) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Bit l set if candidate m1[l] passes the fixed mask and every test
+    unsigned test8(const uint32_t* m1) const noexcept {
+#if defined(__AVX2__)
+        auto rotl17 = [](__m256i x) {
+            return _mm256_or_si256(_mm256_slli_epi32(x, 17), _mm256_srli_epi32(x, 15));
+        };
+        auto set1 = [](uint32_t x) { return _mm256_set1_epi32(static_cast<int>(x)); };
+        const __m256i p3 = set1(Prime3);
+        const __m256i p4 = set1(Prime4);
+        const __m256i m = _mm256_mullo_epi32(_mm256_load_si256(reinterpret_cast<const __m256i*>(m1)), p3);
+        const __m256i intermediate = _mm256_mullo_epi32(rotl17(_mm256_add_epi32(set1(initial_), m)), p4);
+        const __m256i zero = _mm256_setzero_si256();
+        __m256i ok = zero;
+        if (fixed2_) {
+            const __m256i chunk =
+                _mm256_mullo_epi32(_mm256_sub_epi32(set1(reach_), intermediate), set1(inv_Prime3));
+            ok = _mm256_and_si256(_mm256_xor_si256(chunk, set1(b_)), set1(fixed2_));
+        }
+        ok = _mm256_cmpeq_epi32(ok, zero);
+        // D1 * Prime3 and D2 * Prime3, the latter without going through the chunk
+        const __m256i d1 = _mm256_sub_epi32(m, set1(a_ * Prime3));
+        const __m256i d2 = _mm256_sub_epi32(_mm256_sub_epi32(set1(reach_), intermediate), set1(b_ * Prime3));
+        for (size_t t = 0; t < TESTS; ++t) {
+            const __m256i moved = rotl17(_mm256_add_epi32(set1(states_[t]), d1));
+            const __m256i delta = _mm256_mullo_epi32(_mm256_sub_epi32(moved, set1(rotated_[t])), p4);
+            ok = _mm256_and_si256(ok, _mm256_cmpeq_epi32(_mm256_add_epi32(delta, d2), zero));
+            if (t % 4 == 3 && _mm256_testz_si256(ok, ok)) {
+                return 0;
+            }
+        }
+        return static_cast<unsigned>(_mm256_movemask_ps(_mm256_castsi256_ps(ok)));
+#else
+        unsigned passed = 0;
+        for (size_t l = 0; l < LANES; ++l) {
+            passed |= unsigned(test(m1[l])) << l;
+        }
+        return passed;
+#endif
+    }
+
+    void keep(uint32_t m1, std::vector<std::pair<uint32_t, uint32_t>>& out) const {
+        const uint32_t intermediate = rotateLeft(initial_ + m1 * Prime3, 17) * Prime4;
+        const uint32_t chunk = (reach_ - intermediate) * inv_Prime3;
+        out.emplace_back(m1 - a_, chunk - b_);
+    }
+};
+
+struct PipelineConfig {
+    unsigned filter_threads = 1;
+    unsigned verify_threads = 1;
+    size_t candidate_queue = 4096;    // filter -> verify capacity
+    size_t result_queue = 1024;       // verify -> output capacity
+    uint64_t chunk = uint64_t(1) << 16;  // candidates claimed at a time by a filter thread
+    double progress_interval = 0.1;   // seconds between progress calls
+    uint64_t first = 1;               // candidates swept, first to last, within 1 to count()
+    uint64_t last = UINT64_MAX;
+    // Verify each candidate with a generator seeded from it, instead of one per thread, so
+    // that the differentials found depend on rng only, not on the threads
+    bool candidate_seeds = false;
+};
+
+struct StageReport {
+    const char* name;
+    unsigned threads;
+    uint64_t items_in;
+    uint64_t items_out;
+    double utilization;     // busy time over threads * wall time
+    size_t queue_capacity;  // input queue, 0 for the first stage
+    double queue_average;   // sampled input queue depth
+    size_t queue_max;
+};
+
+struct PipelineReport {
+    double seconds = 0;
+    uint64_t candidates = 0;   // D1 candidates tested
+    std::vector<StageReport> stages;
+};
+
+namespace pipeline_detail {
+
+// Backs off while a queue is empty or full and accumulates the time spent doing so
+class Idle {
+public:
+    void wait() {
+        const auto start = std::chrono::steady_clock::now();
+        if (rounds_ < 16) {
+            for (int i = 0; i < 32; ++i) {
+#if defined(__x86_64__) || defined(__i386__)
+                __builtin_ia32_pause();
+#endif
+            }
+        } else if (rounds_ < 32) {
+            std::this_thread::yield();
+        } else {
+            std::this_thread::sleep_for(std::chrono::microseconds(50));
+        }
+        ++rounds_;
+        seconds_ += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    void reset() noexcept { rounds_ = 0; }
+    double seconds() const noexcept { return seconds_; }
+
+private:
+    unsigned rounds_ = 0;
+    double seconds_ = 0;
+};
+
+struct DepthSampler {
+    double sum = 0;
+    size_t max = 0;
+    uint64_t samples = 0;
+
+    void sample(size_t depth) {
+        sum += static_cast<double>(depth);
+        max = std::max(max, depth);
+        ++samples;
+    }
+    double average() const { return samples ? sum / static_cast<double>(samples) : 0; }
+};
+
+}  // namespace pipeline_detail
+
+// Same contract as search_differences: found(diff1, diff2) is called for each verified
+// differential until it returns false, and progress(candidates, total, n_found) every
+// config.progress_interval seconds. Both run on the calling thread. Only the candidates
+// config.first to config.last are tested, and total counts those.
+template <typename Found, typename Progress>
+PipelineReport run_difference_pipeline(const uint8_t* input_array, std::mt19937& rng,
+                                       const uint8_t* fixed_mask, const PipelineConfig& config,
+                                       Found found, Progress progress) {
+    using Candidate = std::pair<uint32_t, uint32_t>;
+    using Clock = std::chrono::steady_clock;
+    using pipeline_detail::Idle;
+
+    const DifferenceFilter filter(input_array, fixed_mask, rng);
+    const uint64_t end = std::min(filter.count(), config.last);
+    const uint64_t total = end >= config.first ? end - config.first + 1 : 0;
+    const unsigned n_filter = std::max(1u, config.filter_threads);
+    const unsigned n_verify = std::max(1u, config.verify_threads);
+    MpmcQueue<Candidate> candidates(config.candidate_queue);
+    MpmcQueue<Candidate> results(config.result_queue);
+
+    std::atomic<bool> stop{false};
+    std::atomic<uint64_t> next{std::max<uint64_t>(config.first, 1)};
+    std::atomic<uint64_t> tested{0};
+    std::atomic<unsigned> filters_running{n_filter};
+    std::atomic<unsigned> verifiers_running{n_verify};
+    // Busy time of each thread: from its start to its exit, less its idle time, so that a
+    // thread done early counts as idle for the rest of the run
+    std::vector<double> filter_busy(n_filter, 0), verify_busy(n_verify, 0);
+    std::vector<uint64_t> survivors(n_filter, 0), verified_in(n_verify, 0), verified_out(n_verify, 0);
+    const auto start = Clock::now();
+    auto busy_since = [](Clock::time_point begun, const Idle& idle) {
+        return std::max(0.0, std::chrono::duration<double>(Clock::now() - begun).count() - idle.seconds());
+    };
+
+    std::vector<std::thread> threads;
+    for (unsigned t = 0; t < n_filter; ++t) {
+        threads.emplace_back([&, t]() {
+            const auto begun = Clock::now();
+            Idle idle;
+            std::vector<Candidate> passed;
+            uint64_t first;
+            while (!stop.load(std::memory_order_relaxed) &&
+                   (first = next.fetch_add(config.chunk, std::memory_order_relaxed)) <= end) {
+                const uint64_t size = std::min(config.chunk, end + 1 - first);
+                passed.clear();
+                filter.run(first, size, passed);
+                for (const Candidate& candidate : passed) {
+                    idle.reset();
+                    while (!candidates.try_push(candidate) && !stop.load(std::memory_order_relaxed)) {
+                        idle.wait();
+                    }
+                }
+                survivors[t] += passed.size();
+                tested.fetch_add(size, std::memory_order_relaxed);
+            }
+            filter_busy[t] = busy_since(begun, idle);
+            filters_running.fetch_sub(1, std::memory_order_release);
+        });
+    }
+    const uint32_t candidate_seed = config.candidate_seeds ? static_cast<uint32_t>(rng()) : 0;
+    std::vector<uint32_t> seeds(n_verify);
+    for (auto& seed : seeds) {
+        seed = static_cast<uint32_t>(rng());
+    }
+    for (unsigned t = 0; t < n_verify; ++t) {
+        threads.emplace_back([&, t]() {
+            const auto begun = Clock::now();
+            Idle idle;
+            std::mt19937 local(seeds[t]);
+            Candidate candidate;
+            while (!stop.load(std::memory_order_relaxed)) {
+                if (!candidates.try_pop(candidate)) {
+                    if (filters_running.load(std::memory_order_acquire) != 0) {
+                        idle.wait();
+                        continue;
+                    }
+                    // The filters are done: drain what they left
+                    if (!candidates.try_pop(candidate)) {
+                        break;
+                    }
+                }
+                idle.reset();
+                ++verified_in[t];
+                if (config.candidate_seeds) {
+                    local.seed(candidate_seed + candidate.first * 0x9E3779B9U);
+                }
+                if (test_single_hypothesis_n_times(candidate.first, candidate.second,
+                                                   NUM_VERIFICATION_TESTS, local)) {
+                    ++verified_out[t];
+                    while (!results.try_push(candidate) && !stop.load(std::memory_order_relaxed)) {
+                        idle.wait();
+                    }
+                }
+            }
+            verify_busy[t] = busy_since(begun, idle);
+            verifiers_running.fetch_sub(1, std::memory_order_release);
+        });
+    }
+
+    // Output stage
+    Idle idle;
+    pipeline_detail::DepthSampler candidate_depth, result_depth;
+    uint64_t received = 0;
+    uint64_t stored = 0;
+    auto last_progress = start;
+    for (;;) {
+        candidate_depth.sample(candidates.size());
+        result_depth.sample(results.size());
+        Candidate differential;
+        if (results.try_pop(differential)) {
+            idle.reset();
+            ++received;
+            if (!stop.load(std::memory_order_relaxed)) {
+                ++stored;
+                if (!found(differential.first, differential.second)) {
+                    stop.store(true, std::memory_order_relaxed);
+                }
+            }
+        } else if (verifiers_running.load(std::memory_order_acquire) == 0) {
+            if (results.size() == 0) {
+                break;
+            }
+        } else {
+            idle.wait();
+        }
+        const auto now = Clock::now();
+        if (std::chrono::duration<double>(now - last_progress).count() >= config.progress_interval) {
+            last_progress = now;
+            progress(std::min(tested.load(std::memory_order_relaxed), total), total, stored);
+        }
+    }
+    const double output_busy = busy_since(start, idle);
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    PipelineReport report;
+    report.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    report.candidates = std::min(tested.load(), total);
+    progress(report.candidates, total, stored);
+
+    auto utilization = [&](const std::vector<double>& busy) {
+        double sum = 0;
+        for (double b : busy) {
+            sum += b;
+        }
+        return report.seconds > 0 ? sum / (report.seconds * static_cast<double>(busy.size())) : 0;
+    };
+    uint64_t total_survivors = 0, total_in = 0, total_out = 0;
+    for (uint64_t s : survivors) total_survivors += s;
+    for (uint64_t s : verified_in) total_in += s;
+    for (uint64_t s : verified_out) total_out += s;
+    report.stages.push_back({"filter", n_filter, report.candidates, total_survivors,
+                             utilization(filter_busy), 0, 0, 0});
+    report.stages.push_back({"verify", n_verify, total_in, total_out, utilization(verify_busy),
+                             candidates.capacity(), candidate_depth.average(), candidate_depth.max});
+    report.stages.push_back({"output", 1, received, stored, utilization({output_busy}),
+                             results.capacity(), result_depth.average(), result_depth.max});
+    return report;
+}
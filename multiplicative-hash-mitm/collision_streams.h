@@ -0,0 +1,58 @@
+// collision_streams.h
+// Pull streams over the engines of mult_collisions
+// Author: Paul Bottinelli
+// For Black Hat EU 2025 - Cut to the QUIC: Slashing QUIC's Performance with a Hash DoS
+//
+// Each function starts the engine on the thread of a CollisionStream (see
+// common/collision_stream.h) and returns the stream, which yields the collisions as the
+// engine finds them. The engine objects, and the prefix range, must outlive the stream.
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <random>
+#include <stdexcept>
+#include <vector>
+#include "../common/collision_stream.h"
+#include "lattice.h"
+#include "mitm.h"
+#include "multicollision.h"
+
+// Up to n_collisions collisions of a precomputed meet-in-the-middle table, from range
+inline CollisionStream stream_mitm(const MeetInTheMiddle& mitm, uint64_t n_collisions, PrefixRange& range,
+                                   SearchMode mode = SearchMode::Probe) {
+    return CollisionStream([&mitm, n_collisions, &range, mode](CollisionStream::Sink& sink) {
+        mitm.search(n_collisions, range, std::ref(sink), mode);
+    });
+}
+
+// n_collisions preimages of target; the stream ends with an error if the charset is too
+// narrow for the engine's length
+inline CollisionStream stream_lattice(const LatticeEngine& engine, uint64_t target, uint64_t n_collisions,
+                                      uint64_t seed) {
+    return CollisionStream([&engine, target, n_collisions, seed](CollisionStream::Sink& sink) {
+        std::mt19937_64 rng(seed);
+        std::vector<uint8_t> collision;
+        for (uint64_t n = 0; n < n_collisions; ++n) {
+            if (!engine.preimage(target, rng, collision)) {
+                throw std::runtime_error("no preimage within the charset, try a longer length");
+            }
+            sink(collision.data(), collision.size());
+        }
+    });
+}
+
+// The first n_collisions of the 2^k messages of a multicollision, in Gray code order
+inline CollisionStream stream_joux(const JouxMulticollision& joux, uint64_t n_collisions) {
+    return CollisionStream([&joux, n_collisions](CollisionStream::Sink& sink) {
+        auto messages = joux.stream();
+        for (uint64_t n = 0; n < n_collisions; ++n) {
+            const std::vector<uint8_t>* message = messages.next();
+            if (!message) {
+                return;
+            }
+            sink(message->data(), message->size());
+        }
+    });
+}
@@ -7,14 +7,117 @@
 # trading memory for time to efficiently generate hash collisions.
 
 import argparse
-import binascii
 import os
 import random
 import sys
 
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', 'common'))
+from corpus import CorpusWriter
+from hex_format import LineWriter, c_array, hex_line
+
 U32_MASK = 0xFFFFFFFF
 U32_SIZE = 32
 
+def _byte_range(lo, hi):
+    return bytes(range(lo, hi + 1))
+
+CHARSET_PRESETS = {
+    'any': _byte_range(0x00, 0xFF),
+    'printable': _byte_range(0x20, 0x7E),
+    'digits': _byte_range(0x30, 0x39),
+    'lower': _byte_range(0x61, 0x7A),
+    'upper': _byte_range(0x41, 0x5A),
+    'alpha': _byte_range(0x41, 0x5A) + _byte_range(0x61, 0x7A),
+    'alnum': _byte_range(0x30, 0x39) + _byte_range(0x41, 0x5A) + _byte_range(0x61, 0x7A),
+    'hex': b'0123456789abcdef',
+    'HEX': b'0123456789ABCDEF',
+    'base64': b'+/' + _byte_range(0x30, 0x39) + _byte_range(0x41, 0x5A) + _byte_range(0x61, 0x7A),
+    'base64url': b'-_' + _byte_range(0x30, 0x39) + _byte_range(0x41, 0x5A) + _byte_range(0x61, 0x7A),
+}
+
+def _parse_escape(spec, pos):
+    """Parse the escape sequence at spec[pos] == '\\', returning (byte, next position)."""
+    if pos + 1 >= len(spec):
+        raise ValueError(f"Dangling escape in {spec}")
+    if spec[pos + 1] == 'x':
+        if pos + 3 >= len(spec):
+            raise ValueError(f"Truncated \\x escape in {spec}")
+        return int(spec[pos + 2:pos + 4], 16), pos + 4
+    return ord(spec[pos + 1]), pos + 2
+
+def _parse_atom(spec, pos):
+    """Parse one atom of a charset spec at spec[pos], returning (alphabet, next position)."""
+    if spec[pos] == '.':
+        return CHARSET_PRESETS['any'], pos + 1
+    if spec[pos] == '\\':
+        c, pos = _parse_escape(spec, pos)
+        return bytes([c]), pos
+    if spec[pos] != '[':
+        return spec[pos].encode('latin-1'), pos + 1
+
+    allowed = set()
+    pos += 1
+    while pos < len(spec) and spec[pos] != ']':
+        if spec[pos] == '\\':
+            lo, pos = _parse_escape(spec, pos)
+        else:
+            lo, pos = ord(spec[pos]), pos + 1
+        hi = lo
+        if pos + 1 < len(spec) and spec[pos] == '-' and spec[pos + 1] != ']':
+            if spec[pos + 1] == '\\':
+                hi, pos = _parse_escape(spec, pos + 1)
+            else:
+                hi, pos = ord(spec[pos + 1]), pos + 2
+            if hi < lo:
+                raise ValueError(f"Reversed range in {spec}")
+        allowed.update(range(lo, hi + 1))
+    if pos >= len(spec):
+        raise ValueError(f"Unterminated [ in {spec}")
+    if not allowed:
+        raise ValueError(f"Empty set in {spec}")
+    return bytes(sorted(allowed)), pos + 1
+
+def parse_charset(name):
+    """
+    Parse a charset applying to every position: a preset name (see CHARSET_PRESETS),
+    a byte range 'lo-hi' (decimal or 0x-prefixed), or a '[...]' set.
+    """
+    if name in CHARSET_PRESETS:
+        return CHARSET_PRESETS[name]
+    if name.startswith('['):
+        alphabet, pos = _parse_atom(name, 0)
+        if pos != len(name):
+            raise ValueError(f"Trailing characters in charset {name}")
+        return alphabet
+    lo, sep, hi = name.partition('-')
+    if not sep:
+        raise ValueError(f"Unknown charset {name}")
+    lo, hi = int(lo, 0), int(hi, 0)
+    if lo > hi or hi > 0xFF:
+        raise ValueError(f"Invalid charset range {name}")
+    return _byte_range(lo, hi)
+
+def parse_charset_spec(spec):
+    """
+    Parse a per-position charset spec into a list of alphabets, one per position.
+    Atoms are '[...]' sets (ranges a-z, escapes \\xHH), '.' for any byte, '\\xHH' or a
+    literal character, each optionally followed by a repeat count {n}.
+    Example: '[0-9a-f]{8}-[A-Z]{4}' for 8 hex digits, a dash and 4 uppercase letters.
+    """
+    alphabets = []
+    pos = 0
+    while pos < len(spec):
+        alphabet, pos = _parse_atom(spec, pos)
+        repeat = 1
+        if pos < len(spec) and spec[pos] == '{':
+            close = spec.find('}', pos)
+            if close < 0:
+                raise ValueError(f"Unterminated {{ in {spec}")
+            repeat = int(spec[pos + 1:close])
+            pos = close + 1
+        alphabets.extend([alphabet] * repeat)
+    return alphabets
+
 class MultiplicativeHash:
     """
     Multiplicative hash with given initial value and multiplier.
@@ -42,11 +145,20 @@ class MultiplicativeHash:
             hash_target = ((hash_target - char) * self.INV_MULTIPLIER) & U32_MASK
         return hash_target
 
-    def __rand_generator(self, size):
-        return bytearray(os.urandom(size))
-
-    def __suffix_generator(self, int_val, length):
-        return int_val.to_bytes(length, byteorder='big')
+    def __rand_generator(self, size, alphabets=None):
+        if alphabets is None:
+            return bytearray(os.urandom(size))
+        return bytearray(random.choice(alphabet) for alphabet in alphabets)
+
+    def __suffix_generator(self, int_val, length, alphabets=None):
+        if alphabets is None:
+            return int_val.to_bytes(length, byteorder='big')
+        # Mixed radix over the allowed bytes of each position, last position least significant
+        suffix = bytearray(length)
+        for i in range(length - 1, -1, -1):
+            int_val, digit = divmod(int_val, len(alphabets[i]))
+            suffix[i] = alphabets[i][digit]
+        return suffix
 
     def __show_progress(self, current, total, bar_length=40):
         progress = current / total
@@ -55,7 +167,7 @@ class MultiplicativeHash:
         sys.stdout.write(f'\rProgress: [{bar}] {percent:.2f}%')
         sys.stdout.flush()
 
-    def meet_in_middle(self, prefix_size, suffix_size, n_collisions=10, target_hash=None, output=None, print_fct=print, interactive=False):
+    def meet_in_middle(self, prefix_size, suffix_size, n_collisions=10, target_hash=None, output=None, print_fct=print, interactive=False, charset_spec=None, corpus=None):
         """
         Perform meet-in-the-middle attack to generate hash collisions.
 
@@ -67,6 +179,10 @@ class MultiplicativeHash:
             output: Output file path (prints to console if None)
             print_fct: Function to format collision output
             interactive: Enable progress bar display
+            charset_spec: List of prefix_size + suffix_size alphabets (bytes) listing the
+                          allowed bytes of each position (any byte if None). Prefixes and
+                          suffixes are enumerated over these alphabets, never filtered.
+            corpus: Binary corpus file to also write the collisions to (see common/corpus.h)
         """
         if prefix_size <= 0 or suffix_size <= 0:
             raise ValueError("Prefix and suffix sizes must be positive integers")
@@ -75,6 +191,15 @@ class MultiplicativeHash:
         if suffix_size > 3:
             print(f"Warning: suffix_size={suffix_size} will create a table of 2^{suffix_size*8} entries, which may consume significant memory")
 
+        prefix_alphabets = suffix_alphabets = None
+        if charset_spec is not None:
+            if len(charset_spec) != prefix_size + suffix_size:
+                raise ValueError("Charset spec length must equal prefix + suffix size")
+            if not all(charset_spec):
+                raise ValueError("Charset spec allows no byte at some position")
+            prefix_alphabets = charset_spec[:prefix_size]
+            suffix_alphabets = charset_spec[prefix_size:]
+
         precomp = {}
 
         if target_hash is None:
@@ -83,18 +208,25 @@ class MultiplicativeHash:
         # We upperbound the memory usage to 2^24
         upper_bound = min(24, suffix_size*8)
 
+        total = 2**upper_bound
         print("Target hash: ", target_hash)
-        print("Entries in table: 2^", upper_bound, " = ", 2**upper_bound)
+        if suffix_alphabets is None:
+            print("Entries in table: 2^", upper_bound, " = ", total)
+        else:
+            n_suffixes = 1
+            for alphabet in suffix_alphabets:
+                n_suffixes *= len(alphabet)
+            total = min(total, n_suffixes)
+            print("Entries in table: ", total)
         print("Starting precomputations.")
 
-        total = 2**upper_bound
-        increment_display = total // 1000
+        increment_display = max(total // 1000, 1)
         for i in range(total):
             # Displaying progress
             if interactive and (i % increment_display == 0 or i == total - 1):
                 self.__show_progress(i, total)
 
-            s = self.__suffix_generator(i, suffix_size)
+            s = self.__suffix_generator(i, suffix_size, suffix_alphabets)
             h = self.__partial_backward_hash(s, target_hash)
             precomp[h] = s
 
@@ -111,42 +243,59 @@ class MultiplicativeHash:
             except IOError as e:
                 print(f"Error: Could not open output file '{output}': {e}")
                 return []
+        corpus_writer = None
+        if corpus:
+            corpus_writer = CorpusWriter(
+                corpus, f"mult:{self.INITIAL_VALUE}:{self.MULTIPLIER}:{U32_SIZE}",
+                target=target_hash, hash_bits=U32_SIZE, target_mask=U32_MASK,
+                params={'generator': 'generic_mitm.py'}, record_size=prefix_size + suffix_size)
+
+        # The built-in formats are written in batches (see common/hex_format.py), other
+        # print functions are called on each collision
+        formatter = FORMATTERS.get(print_fct)
+        if output_file and formatter is None:
+            formatter = str
+        writer = LineWriter(output_file or sys.stdout)
 
         while n != n_collisions:
-            s = self.__rand_generator(prefix_size)
+            s = self.__rand_generator(prefix_size, prefix_alphabets)
             h = self.__partial_forward_hash(s)
             if h in precomp:
                 collision = s + precomp[h]
                 collisions.append(collision)
 
                 # Write to file or print to console
-                if output_file:
-                    if print_fct == print_hex_string:
-                        output_file.write(binascii.hexlify(collision).decode() + '\n')
-                    elif print_fct == print_c_array:
-                        output_file.write("{" + ", ".join('0x%02x' % i for i in collision) + "}\n")
-                    else:
-                        output_file.write(str(collision) + '\n')
+                if formatter:
+                    writer.write(formatter(collision))
                 else:
                     print_fct(collision)
+                if corpus_writer:
+                    corpus_writer.add(collision)
 
                 n += 1
 
+        writer.flush()
         if output_file:
             output_file.close()
             print(f"Collisions written to {output}")
+        if corpus_writer:
+            corpus_writer.close()
+            print(f"{corpus_writer.count} collisions written to corpus {corpus}")
 
         return collisions
 
 def print_c_array(hex_string):
     """Print collision as C-style byte array."""
-    print("{" + ", ".join('0x%02x' % i for i in hex_string) + "}")
+    print(c_array(hex_string))
 
 def print_hex_string(hex_string):
     """Print collision as hexadecimal string."""
-    print(binascii.hexlify(hex_string).decode())
+    print(hex_line(hex_string))
+
+# Line formats of the print functions above, for batched output
+FORMATTERS = {print: str, print_c_array: c_array, print_hex_string: hex_line}
 
-def run_attack(prefix_size, suffix_size, initial_value, multiplier, n_collisions, print_fct, interactive, output):
+def run_attack(prefix_size, suffix_size, initial_value, multiplier, n_collisions, print_fct, interactive, output, charset_spec=None, corpus=None):
     """Execute the meet-in-the-middle collision attack."""
     mHash = MultiplicativeHash(initial_value, multiplier)
     collisions = mHash.meet_in_middle(
@@ -154,7 +303,9 @@ def run_attack(prefix_size, suffix_size, initial_value, multiplier, n_collisions
         n_collisions=n_collisions,
         print_fct=print_fct,
         interactive=interactive,
-        output=output
+        output=output,
+        charset_spec=charset_spec,
+        corpus=corpus
     )
     return collisions
 
@@ -173,11 +324,20 @@ def main(args):
         print_fct = print_hex_string
 
     try:
+        prefix_size = args.prefix
+        charset_spec = None
+        if args.spec is not None:
+            charset_spec = parse_charset_spec(args.spec)
+            prefix_size = len(charset_spec) - args.suffix
+        elif args.charset is not None:
+            charset_spec = [parse_charset(args.charset)] * (args.prefix + args.suffix)
+
         run_attack(
-            args.prefix, args.suffix,
+            prefix_size, args.suffix,
             args.initial, args.multiplier,
             args.n_collisions,
-            print_fct, args.interactive, args.output
+            print_fct, args.interactive, args.output,
+            charset_spec, args.corpus
         )
     except ValueError as e:
         print(f"Error: {e}")
@@ -203,6 +363,11 @@ if __name__ == "__main__":
         type=str,
         help='Output file to write the result to. If not provided, prints to console.'
     )
+    parser.add_argument(
+        '--corpus',
+        type=str,
+        help='Also write the collisions to this binary corpus file (see common/corpus.h).'
+    )
     parser.add_argument(
         '-p', '--prefix',
         type=int,
@@ -233,6 +398,16 @@ if __name__ == "__main__":
         default=100,
         help='The number of collisions to compute (default: 100, max: 2^32).'
     )
+    parser.add_argument(
+        '-c', '--charset',
+        type=str,
+        help="Bytes allowed at every position: a preset (any, printable, digits, lower, upper, alpha, alnum, hex, HEX, base64, base64url), a range 'lo-hi' or a '[...]' set."
+    )
+    parser.add_argument(
+        '--spec',
+        type=str,
+        help="Per-position charset spec, e.g. '[0-9a-f]{8}-[A-Z]{4}'. Sets the input length; the prefix size becomes the spec length minus the suffix size."
+    )
     parser.add_argument(
         '--interactive',
         action='store_true',
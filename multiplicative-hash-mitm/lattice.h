@@ -0,0 +1,272 @@
+// lattice.h
+// Lattice-reduction collision generator for multiplicative hash functions
+// Author: Paul Bottinelli
+// For Black Hat EU 2025 - Cut to the QUIC: Slashing QUIC's Performance with a Hash DoS
+//
+// For inputs of n bytes, h(x) = init*M^n + sum(x_i * a_i) mod 2^bits with a_i = M^(n-1-i).
+// Two inputs collide iff their difference d lies in the lattice
+//     L = { d in Z^n : sum(d_i * a_i) = 0 mod 2^bits },
+// and every input hashing to a target lies in a single coset of L. Once L is LLL-reduced,
+// Babai's nearest plane algorithm maps a random point of the charset box to a nearby
+// member of that coset, i.e. a preimage of the target with all bytes kept in range.
+// Only positions allowing a contiguous range of bytes are covered exactly; for other sets
+// the rounded point is kept only if every byte is allowed.
+// No table is needed, so this also works for 64-bit digests where MITM is impractical.
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <stdexcept>
+#include <vector>
+#include "charset.h"
+#include "multiplicative_hash.h"
+
+namespace lattice {
+
+// Basis entries reach 2^64 before reduction, so coordinates are kept in 128-bit integers
+// and the Gram-Schmidt data in long double (64-bit mantissa on x86).
+using Int = __int128;
+using Real = long double;
+using Vector = std::vector<Int>;
+using Basis = std::vector<Vector>;
+
+inline Real dot(const Vector& a, const Vector& b) noexcept {
+    Real sum = 0;
+    for (size_t i = 0; i < a.size(); ++i) {
+        sum += static_cast<Real>(a[i]) * static_cast<Real>(b[i]);
+    }
+    return sum;
+}
+
+// LLL reduction, floating-point variant of Schnorr and Euchner: the Gram-Schmidt row of
+// the current vector is recomputed from the exact basis whenever a size reduction used a
+// large coefficient, so rounding errors never accumulate.
+inline void lll_reduce(Basis& b, Real delta = 0.99L) {
+    const size_t n = b.size();
+    if (n < 2) {
+        return;
+    }
+
+    std::vector<std::vector<Real>> mu(n, std::vector<Real>(n, 0));
+    std::vector<std::vector<Real>> r(n, std::vector<Real>(n, 0));
+    std::vector<Real> norms(n, 0);  // squared norms of the Gram-Schmidt vectors
+
+    auto gso_row = [&](size_t k) {
+        for (size_t j = 0; j < k; ++j) {
+            Real s = dot(b[k], b[j]);
+            for (size_t i = 0; i < j; ++i) {
+                s -= mu[j][i] * r[k][i];
+            }
+            r[k][j] = s;
+            mu[k][j] = s / norms[j];
+        }
+        Real s = dot(b[k], b[k]);
+        for (size_t j = 0; j < k; ++j) {
+            s -= mu[k][j] * r[k][j];
+        }
+        norms[k] = s;
+    };
+
+    // Coefficients above 2^32 lose precision in mu and require a fresh Gram-Schmidt row
+    constexpr Real LARGE_COEFFICIENT = 4294967296.0L;
+
+    gso_row(0);
+    size_t k = 1;
+    while (k < n) {
+        bool large = true;
+        while (large) {
+            large = false;
+            gso_row(k);
+            for (size_t j = k; j-- > 0;) {
+                const Real q = std::round(mu[k][j]);
+                if (q == 0) {
+                    continue;
+                }
+                large = large || std::fabs(q) > LARGE_COEFFICIENT;
+                const Int qi = static_cast<Int>(q);
+                for (size_t i = 0; i < b[k].size(); ++i) {
+                    b[k][i] -= qi * b[j][i];
+                }
+                for (size_t i = 0; i < j; ++i) {
+                    mu[k][i] -= q * mu[j][i];
+                }
+                mu[k][j] -= q;
+            }
+        }
+
+        // Lovasz condition
+        if (norms[k] < (delta - mu[k][k - 1] * mu[k][k - 1]) * norms[k - 1]) {
+            std::swap(b[k], b[k - 1]);
+            if (k == 1) {
+                gso_row(0);
+            } else {
+                --k;
+            }
+        } else {
+            ++k;
+        }
+    }
+}
+
+}  // namespace lattice
+
+// Generates preimages of a target hash with every byte in the allowed set of its position.
+// Positions allowing a single byte are constants and stay out of the lattice; the other
+// coordinates are weighted so that a unit of every weighted coordinate spans the same
+// fraction of the allowed interval.
+class LatticeEngine {
+public:
+    LatticeEngine(const MultiplicativeHash& hash, const CharsetSpec& spec)
+        : hash_(hash), spec_(spec), length_(spec.length()) {
+        for (size_t i = 0; i < length_; ++i) {
+            if (spec[i].empty()) {
+                throw std::invalid_argument("empty charset");
+            }
+            if (spec[i].size() > 1) {
+                free_.push_back(i);
+            }
+        }
+        if (free_.size() < 2) {
+            throw std::invalid_argument("lattice inputs need at least 2 non-constant bytes");
+        }
+
+        unsigned max_width = 0;
+        for (size_t i : free_) {
+            max_width = std::max<unsigned>(max_width, spec[i].max() - spec[i].min());
+        }
+        for (size_t i : free_) {
+            const unsigned width = spec[i].max() - spec[i].min();
+            weights_.push_back(std::max<lattice::Int>(1, (max_width + width / 2) / width));
+        }
+
+        // Kernel basis over the free positions, pivoting on the last one (every weight
+        // a_i = M^(n-1-i) is odd, hence invertible): e_k - a_k/a_pivot * e_pivot for the other
+        // free positions, and 2^bits * e_pivot.
+        const size_t m = free_.size();
+        const size_t pivot = free_.back();
+        inv_pivot_weight_ = hash.inverse_power(length_ - 1 - pivot);
+        const lattice::Int modulus = static_cast<lattice::Int>(1) << hash.bits();
+        basis_.assign(m, lattice::Vector(m, 0));
+        for (size_t k = 0; k + 1 < m; ++k) {
+            const uint64_t ratio = hash.power(length_ - 1 - free_[k]) * inv_pivot_weight_;
+            basis_[k][k] = weights_[k];
+            basis_[k][m - 1] = -centered(ratio & hash.mask()) * weights_[m - 1];
+        }
+        basis_[m - 1][m - 1] = modulus * weights_[m - 1];
+
+        lattice::lll_reduce(basis_);
+        compute_gram_schmidt();
+    }
+
+    LatticeEngine(const MultiplicativeHash& hash, size_t length,
+                  uint8_t min_byte = 0x00, uint8_t max_byte = 0xFF)
+        : LatticeEngine(hash, CharsetSpec::uniform(length, ByteSet::range(min_byte, max_byte))) {}
+
+    size_t length() const noexcept { return length_; }
+    const lattice::Basis& reduced_basis() const noexcept { return basis_; }
+
+    // Writes to out a fresh input hashing to target. Each attempt rounds a random point of
+    // the charset box to the target coset; returns false if none of max_attempts landed on
+    // allowed bytes only (charset too narrow for this length).
+    template <typename Rng>
+    bool preimage(uint64_t target, Rng& rng, std::vector<uint8_t>& out,
+                  size_t max_attempts = 1000) const {
+        const size_t m = free_.size();
+        out.resize(length_);
+
+        // Constant positions move to the right-hand side. Any x with
+        // sum(x_i * a_i) = rhs over the free positions lies in the target coset; one such
+        // point is rhs / a_pivot * e_pivot.
+        uint64_t rhs = target - hash_.initial_value() * hash_.power(length_);
+        for (size_t i = 0; i < length_; ++i) {
+            if (spec_[i].size() == 1) {
+                out[i] = spec_[i][0];
+                rhs -= out[i] * hash_.power(length_ - 1 - i);
+            }
+        }
+        const lattice::Int particular = centered((rhs * inv_pivot_weight_) & hash_.mask());
+
+        lattice::Vector center(m), residual(m);
+        for (size_t attempt = 0; attempt < max_attempts; ++attempt) {
+            for (size_t k = 0; k < m; ++k) {
+                const ByteSet& set = spec_[free_[k]];
+                center[k] = set[std::uniform_int_distribution<size_t>(0, set.size() - 1)(rng)];
+                residual[k] = -center[k] * weights_[k];
+            }
+            residual[m - 1] += particular * weights_[m - 1];
+
+            babai_reduce(residual);
+
+            bool allowed = true;
+            for (size_t k = 0; k < m && allowed; ++k) {
+                const lattice::Int x = center[k] + residual[k] / weights_[k];
+                allowed = x >= 0 && x <= 0xFF && spec_[free_[k]].contains(static_cast<uint8_t>(x));
+                out[free_[k]] = static_cast<uint8_t>(x);
+            }
+            if (allowed) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+private:
+    MultiplicativeHash hash_;
+    CharsetSpec spec_;
+    size_t length_;
+    std::vector<size_t> free_;
+    std::vector<lattice::Int> weights_;
+    uint64_t inv_pivot_weight_;
+    lattice::Basis basis_;
+    std::vector<std::vector<lattice::Real>> gram_schmidt_;
+    std::vector<lattice::Real> norms_;
+
+    lattice::Int centered(uint64_t value) const noexcept {
+        const lattice::Int modulus = static_cast<lattice::Int>(1) << hash_.bits();
+        const lattice::Int v = value;
+        return v > modulus / 2 ? v - modulus : v;
+    }
+
+    void compute_gram_schmidt() {
+        gram_schmidt_.assign(basis_.size(), std::vector<lattice::Real>(basis_.size(), 0));
+        norms_.assign(basis_.size(), 0);
+        for (size_t k = 0; k < basis_.size(); ++k) {
+            for (size_t i = 0; i < basis_.size(); ++i) {
+                gram_schmidt_[k][i] = static_cast<lattice::Real>(basis_[k][i]);
+            }
+            for (size_t j = 0; j < k; ++j) {
+                lattice::Real s = 0;
+                for (size_t i = 0; i < basis_.size(); ++i) {
+                    s += static_cast<lattice::Real>(basis_[k][i]) * gram_schmidt_[j][i];
+                }
+                const lattice::Real mu = s / norms_[j];
+                for (size_t i = 0; i < basis_.size(); ++i) {
+                    gram_schmidt_[k][i] -= mu * gram_schmidt_[j][i];
+                }
+            }
+            for (size_t i = 0; i < basis_.size(); ++i) {
+                norms_[k] += gram_schmidt_[k][i] * gram_schmidt_[k][i];
+            }
+        }
+    }
+
+    // Babai's nearest plane: subtract the lattice vector closest to v, leaving v in the
+    // fundamental parallelepiped of the Gram-Schmidt basis (coordinates within +-1/2)
+    void babai_reduce(lattice::Vector& v) const {
+        for (size_t j = basis_.size(); j-- > 0;) {
+            lattice::Real s = 0;
+            for (size_t i = 0; i < basis_.size(); ++i) {
+                s += static_cast<lattice::Real>(v[i]) * gram_schmidt_[j][i];
+            }
+            const lattice::Int q = static_cast<lattice::Int>(std::round(s / norms_[j]));
+            if (q != 0) {
+                for (size_t i = 0; i < basis_.size(); ++i) {
+                    v[i] -= q * basis_[j][i];
+                }
+            }
+        }
+    }
+};
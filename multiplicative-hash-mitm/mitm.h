@@ -0,0 +1,529 @@
+// mitm.h
+// Native meet-in-the-middle collision search for 32-bit multiplicative hash functions
+// Author: Paul Bottinelli
+// For Black Hat EU 2025 - Cut to the QUIC: Slashing QUIC's Performance with a Hash DoS
+//
+// Same algorithm as MultiplicativeHash.meet_in_middle in generic_mitm.py: a table maps the
+// backward hash of every suffix to that suffix, then prefixes are hashed forward until
+// one lands in the table (enumerated and hashed in batches by prefix_enumerator.h). Unlike
+// the Python dict, the table keeps every suffix of a backward hash, so a prefix hit yields
+// one collision per matching suffix. Suffixes and prefixes are drawn from a CharsetSpec, by
+// mixed-radix enumeration over the allowed bytes of each position.
+//
+// Once the table outgrows the caches, every probe is a cache miss. The merge search mode
+// trades them for sequential passes: prefix hashes are produced in large batches, sorted,
+// and joined against the sorted table. The prefetch mode keeps the random accesses but
+// pipelines them, so that many misses are in flight at once. Probing modes can also query
+// a split-block Bloom filter over the table keys first, so that most misses never touch
+// the table.
+//
+// The table is either the CSR multimap of suffix_table.h, or, for tables beyond 2^24
+// suffixes, a ribbon retrieval structure mapping each backward hash to one suffix index in
+// about log2(entries) bits. The latter stores no keys, so every lookup is verified by
+// recomputing the backward hash of the retrieved suffix.
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+#include "bloom_filter.h"
+#include "charset.h"
+#include "multiplicative_hash.h"
+#include "prefix_enumerator.h"
+#include "ribbon.h"
+#include "suffix_table.h"
+
+enum class SearchMode { Probe, Prefetch, Merge, Auto };
+enum class TableBackend { Csr, Ribbon };
+
+class MeetInTheMiddle {
+public:
+    // We upperbound the memory usage to 2^24 entries, as generic_mitm.py does
+    static constexpr unsigned MAX_TABLE_BITS = 24;
+    // The ribbon backend takes about 3.5 bytes per entry, i.e. 1 GB for 2^28 entries
+    static constexpr unsigned MAX_RIBBON_TABLE_BITS = 30;
+
+    // Bounds on the number of lookups in flight in the prefetch search mode
+    static constexpr size_t MIN_GROUP_SIZE = 2;
+    static constexpr size_t MAX_GROUP_SIZE = 64;
+    static constexpr size_t DEFAULT_GROUP_SIZE = 32;
+
+    // spec constrains all prefix_size + suffix_size positions; an empty spec allows any byte.
+    // The table holds the first 2^table_bits suffixes at most.
+    MeetInTheMiddle(const MultiplicativeHash& hash, size_t prefix_size, size_t suffix_size,
+                    const CharsetSpec& spec = CharsetSpec(), unsigned table_bits = MAX_TABLE_BITS,
+                    TableBackend backend = TableBackend::Csr)
+        : hash_(hash), prefix_size_(prefix_size), suffix_size_(suffix_size), backend_(backend) {
+        if (hash.bits() != 32) {
+            throw std::invalid_argument("meet-in-the-middle only supports 32-bit digests");
+        }
+        if (prefix_size == 0 || suffix_size == 0) {
+            throw std::invalid_argument("prefix and suffix sizes must be positive integers");
+        }
+        const CharsetSpec full = spec.length() == 0
+            ? CharsetSpec::uniform(prefix_size + suffix_size, ByteSet::any()) : spec;
+        if (full.length() != prefix_size + suffix_size) {
+            throw std::invalid_argument("charset spec length must equal prefix + suffix size");
+        }
+        prefix_spec_ = full.slice(0, prefix_size);
+        suffix_spec_ = full.slice(prefix_size, prefix_size + suffix_size);
+        const unsigned max_bits = backend == TableBackend::Ribbon ? MAX_RIBBON_TABLE_BITS : MAX_TABLE_BITS;
+        if (table_bits == 0 || table_bits > max_bits) {
+            throw std::invalid_argument("table bits must be between 1 and " + std::to_string(max_bits));
+        }
+        table_entries_ = std::min<uint64_t>(uint64_t(1) << table_bits, suffix_spec_.count());
+    }
+
+    size_t prefix_size() const noexcept { return prefix_size_; }
+    size_t suffix_size() const noexcept { return suffix_size_; }
+    size_t length() const noexcept { return prefix_size_ + suffix_size_; }
+    uint64_t table_entries() const noexcept { return table_entries_; }
+    uint32_t target() const noexcept { return target_; }
+    size_t group_size() const noexcept { return group_size_; }
+    TableBackend backend() const noexcept { return backend_; }
+
+    void set_group_size(size_t group_size) {
+        if (group_size < MIN_GROUP_SIZE || group_size > MAX_GROUP_SIZE) {
+            throw std::invalid_argument("group size must be between " + std::to_string(MIN_GROUP_SIZE) +
+                                        " and " + std::to_string(MAX_GROUP_SIZE));
+        }
+        group_size_ = group_size;
+    }
+    const CsrSuffixTable& table() const noexcept { return table_; }
+    const RibbonRetrieval& ribbon() const noexcept { return ribbon_; }
+    const SplitBlockBloomFilter& filter() const noexcept { return filter_; }
+
+    // Number of distinct prefixes the search enumerates, see PrefixEnumerator
+    uint64_t prefix_count() const { return PrefixEnumerator(hash_, prefix_spec_).count(); }
+
+    // Bits per distinct key of the Bloom filter built by precompute, 0 for no filter
+    void set_filter_bits(double bits_per_key) {
+        if (bits_per_key < 0 || bits_per_key > 64) {
+            throw std::invalid_argument("filter bits per key must be between 0 and 64");
+        }
+        filter_bits_ = bits_per_key;
+    }
+
+    // Suffix number index, in mixed radix over the suffix alphabets (big-endian bytes when
+    // unconstrained, as in generic_mitm.py)
+    void suffix(uint32_t index, uint8_t* out) const noexcept {
+        suffix_spec_.decode(index, out);
+    }
+
+    // Fill the table for target. progress(i, total) is called periodically.
+    template <typename Progress>
+    void precompute(uint32_t target, Progress progress) {
+        target_ = target;
+
+        const uint64_t total = table_entries();
+        if (backend_ == TableBackend::Ribbon) {
+            unsigned value_bits = 1;
+            while ((uint64_t(1) << value_bits) < total) {
+                ++value_bits;
+            }
+            ribbon_.reset(total, value_bits);
+            std::vector<std::pair<uint32_t, uint32_t>> batch;
+            batch.reserve(RIBBON_BATCH);
+            for_each_backward_hash([&](uint32_t h, uint32_t i) {
+                batch.emplace_back(h, i);
+                if (batch.size() == RIBBON_BATCH) {
+                    ribbon_.insert(batch.data(), batch.size());
+                    batch.clear();
+                }
+            }, progress);
+            ribbon_.insert(batch.data(), batch.size());
+            ribbon_.finish();
+        } else {
+            std::vector<std::pair<uint32_t, uint32_t>> entries(total);
+            for_each_backward_hash([&](uint32_t h, uint32_t i) { entries[i] = {h, i}; }, progress);
+            table_.build(entries);
+        }
+        build_filter();
+    }
+
+    void precompute(uint32_t target) {
+        precompute(target, [](uint64_t, uint64_t) {});
+    }
+
+    // (Re)build the filter over the current table, after a change of set_filter_bits
+    void build_filter() {
+        filter_ = SplitBlockBloomFilter();
+        if (filter_bits_ == 0) {
+            return;
+        }
+        if (backend_ == TableBackend::Ribbon) {
+            // Dropped duplicates are inserted too, which is harmless
+            filter_.build(ribbon_.size(), filter_bits_, [&](auto insert) {
+                for_each_backward_hash([&](uint32_t h, uint32_t) { insert(h); },
+                                       [](uint64_t, uint64_t) {});
+            });
+        } else {
+            filter_.build(table_.distinct_keys(), filter_bits_,
+                          [&](auto insert) { table_.for_each_distinct_key(insert); });
+        }
+    }
+
+    // Number of suffixes the search can find, i.e. table entries minus those the backend
+    // dropped
+    size_t stored_entries() const noexcept {
+        return backend_ == TableBackend::Ribbon ? ribbon_.size() : table_.size();
+    }
+
+    size_t memory_bytes() const noexcept {
+        return backend_ == TableBackend::Ribbon ? ribbon_.memory_bytes() : table_.memory_bytes();
+    }
+
+    // Whether some suffix has backward hash h
+    bool contains(uint32_t h) const {
+        std::vector<uint8_t> s(suffix_size_);
+        bool found = false;
+        find(h, s.data(), [&]() { found = true; return false; });
+        return found;
+    }
+
+    // Hash the prefixes of range until n_collisions collisions have been passed to
+    // emit(const uint8_t* collision, size_t length), or the range is exhausted. Returns the
+    // number of prefixes tried. Several threads may search the same range.
+    //   Probe:    look every prefix hash up in the table, one random access each
+    //   Prefetch: same lookups, software pipelined over group_size() prefixes
+    //   Merge:    hash a batch of prefixes, sort it and merge-join it against the sorted
+    //             table (CSR backend only)
+    //   Auto:     whichever select_search_mode measures as fastest
+    template <typename Emit>
+    uint64_t search(uint64_t n_collisions, PrefixRange& range, Emit emit,
+                    SearchMode mode = SearchMode::Probe) const {
+        if (mode == SearchMode::Auto) {
+            mode = select_search_mode(n_collisions, range).mode;
+        }
+        if (mode == SearchMode::Merge && backend_ != TableBackend::Csr) {
+            throw std::invalid_argument("merge search requires the csr table");
+        }
+        return search_with(mode, n_collisions, UINT64_MAX, range, emit);
+    }
+
+    // Same, stopping after max_tries prefixes as well: a slice of a longer search, e.g. one
+    // chunk of range with max_tries = PrefixRange::CHUNK. Returns 0 once range is exhausted.
+    template <typename Emit>
+    uint64_t search(uint64_t n_collisions, uint64_t max_tries, PrefixRange& range, Emit emit,
+                    SearchMode mode = SearchMode::Probe) const {
+        if (mode == SearchMode::Auto || (mode == SearchMode::Merge && backend_ != TableBackend::Csr)) {
+            throw std::invalid_argument("bounded searches probe the table or merge with the csr table");
+        }
+        return search_with(mode, n_collisions, max_tries, range, emit);
+    }
+
+    // Prefixes per second of mode over the next tries prefixes of range (Auto is not a
+    // mode); the collisions found meanwhile are discarded
+    double search_rate(SearchMode mode, uint64_t tries, PrefixRange& range) const {
+        auto discard = [](const uint8_t*, size_t) {};
+        const auto start = std::chrono::steady_clock::now();
+        tries = search_with(mode, UINT64_MAX, tries, range, discard);
+        return tries / std::max(1e-9, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+    }
+
+    struct SearchModeChoice {
+        SearchMode mode;
+        double probe_rate;  // prefixes per second, 0 when not measured
+        double prefetch_rate;
+        double merge_rate;
+    };
+
+    // Time the search modes on a few merge batches of range against the current table; the
+    // collisions found meanwhile are discarded. Searches expected to finish within that
+    // many prefixes use probing without measuring.
+    SearchModeChoice select_search_mode(uint64_t n_collisions, PrefixRange& range) const {
+        const uint64_t trial = CALIBRATION_BATCHES * MERGE_BATCH;
+        const double expected_tries = static_cast<double>(n_collisions) * 4294967296.0 /
+                                      static_cast<double>(std::max<size_t>(stored_entries(), 1));
+        if (expected_tries < 2 * trial || range.count() - range.claimed() < 8 * trial) {
+            return {SearchMode::Probe, 0, 0, 0};
+        }
+        auto rate = [&](SearchMode mode) { return search_rate(mode, trial, range); };
+        SearchModeChoice choice = {SearchMode::Probe, rate(SearchMode::Probe), rate(SearchMode::Prefetch),
+                                   backend_ == TableBackend::Csr ? rate(SearchMode::Merge) : 0};
+        double best = choice.probe_rate;
+        if (choice.prefetch_rate > best) {
+            choice.mode = SearchMode::Prefetch;
+            best = choice.prefetch_rate;
+        }
+        if (choice.merge_rate > best) {
+            choice.mode = SearchMode::Merge;
+        }
+        return choice;
+    }
+
+private:
+    // Prefixes per merge batch, and entries per sorted chunk: 2^15 pairs are 256 KB, which
+    // fits in L2 together with the histograms
+    static constexpr size_t MERGE_BATCH = size_t(1) << 20;
+    static constexpr size_t L2_CHUNK_ENTRIES = size_t(1) << 15;
+    static constexpr uint64_t CALIBRATION_BATCHES = 2;
+    // Entries per batched ribbon insertion
+    static constexpr size_t RIBBON_BATCH = 4096;
+
+    // Calls f(h, i) with the backward hash h of every suffix i of the table
+    template <typename F, typename Progress>
+    void for_each_backward_hash(F f, Progress progress) const {
+        const uint64_t total = table_entries();
+        const uint64_t increment_display = std::max<uint64_t>(total / 1000, 1);
+        std::vector<uint8_t> s(suffix_size_);
+        for (uint64_t i = 0; i < total; ++i) {
+            if (i % increment_display == 0 || i == total - 1) {
+                progress(i, total);
+            }
+            suffix(static_cast<uint32_t>(i), s.data());
+            f(static_cast<uint32_t>(hash_.backward(target_, s.data(), suffix_size_)),
+              static_cast<uint32_t>(i));
+        }
+    }
+
+    // Writes every suffix whose backward hash is h to suffix_out in turn and calls f(),
+    // until f returns false
+    template <typename F>
+    void find(uint32_t h, uint8_t* suffix_out, F f) const {
+        if (backend_ == TableBackend::Csr) {
+            table_.find(h, [&](uint32_t suffix_index) {
+                suffix(suffix_index, suffix_out);
+                return f();
+            });
+            return;
+        }
+        const uint32_t suffix_index = ribbon_.lookup(h);
+        if (suffix_index < table_entries_) {
+            suffix(suffix_index, suffix_out);
+            if (hash_.backward(target_, suffix_out, suffix_size_) == h) {
+                f();
+            }
+        }
+    }
+
+    // Two-step prefetch of the lookup of h, see search_prefetch
+    void prefetch_first(uint32_t h) const noexcept {
+        if (backend_ == TableBackend::Csr) {
+            table_.prefetch_row(h);
+        } else {
+            ribbon_.prefetch(h);
+        }
+    }
+
+    void prefetch_second(uint32_t h) const noexcept {
+        if (backend_ == TableBackend::Csr) {
+            table_.prefetch_keys(h);
+        }
+    }
+
+    // The search loops stop after n_collisions collisions or max_tries prefixes and return
+    // the number of prefixes tried
+    template <typename Emit>
+    uint64_t search_with(SearchMode mode, uint64_t n_collisions, uint64_t max_tries,
+                         PrefixRange& range, Emit& emit) const {
+        PrefixStream prefixes(hash_, prefix_spec_, range);
+        switch (mode) {
+        case SearchMode::Prefetch: return search_prefetch(n_collisions, max_tries, prefixes, emit);
+        case SearchMode::Merge: return search_merge(n_collisions, max_tries, prefixes, emit);
+        default: return search_probe(n_collisions, max_tries, prefixes, emit);
+        }
+    }
+
+    // Prefix hashes are produced PROBE_BATCH at a time for the probing modes
+    static constexpr size_t PROBE_BATCH = 64;
+
+    template <typename Emit>
+    uint64_t search_probe(uint64_t n_collisions, uint64_t max_tries, PrefixStream& prefixes,
+                          Emit& emit) const {
+        std::vector<uint8_t> collision(length());
+        uint32_t hashes[PROBE_BATCH];
+        uint64_t tries = 0;
+        uint64_t n = 0;
+        while (n != n_collisions && tries < max_tries) {
+            uint64_t first;
+            const size_t batch =
+                prefixes.next(hashes, std::min<uint64_t>(PROBE_BATCH, max_tries - tries), first);
+            if (batch == 0) {
+                break;
+            }
+            for (size_t i = 0; i < batch; ++i) {
+                if (!filter_.empty() && !filter_.contains(hashes[i])) {
+                    continue;
+                }
+                find(hashes[i], &collision[prefix_size_], [&]() {
+                    prefixes.prefix(first + i, collision.data());
+                    emit(collision.data(), collision.size());
+                    return ++n != n_collisions;
+                });
+                if (n == n_collisions) {
+                    return tries + i + 1;
+                }
+            }
+            tries += batch;
+        }
+        return tries;
+    }
+
+    // Step j takes prefix j and prefetches its row offsets, prefetches the first keys of
+    // prefix j - d, whose offsets have arrived by then, and resolves the lookup of prefix
+    // j - 2d from cache, with d = group_size / 2. With a filter, step j prefetches the
+    // filter block instead, and step j + d only prefetches the row of filter hits.
+    template <typename Emit>
+    uint64_t search_prefetch(uint64_t n_collisions, uint64_t max_tries, PrefixStream& stream,
+                             Emit& emit) const {
+        const size_t d = group_size_ / 2;
+        const size_t ring = 2 * d + 1;
+        std::vector<uint64_t> indices(ring);
+        std::vector<uint32_t> hashes(ring);
+        std::vector<uint8_t> passed(ring, 1);
+        std::vector<uint8_t> collision(length());
+        const bool filtered = !filter_.empty();
+        uint32_t batch_hashes[PROBE_BATCH];
+        uint64_t batch_first = 0;
+        size_t batch_size = 0;
+        size_t batch_pos = 0;
+        uint64_t generated = 0;
+        uint64_t n = 0;
+        for (uint64_t j = 0;; ++j) {
+            if (batch_pos == batch_size && generated < max_tries) {
+                batch_size = stream.next(
+                    batch_hashes, std::min<uint64_t>(PROBE_BATCH, max_tries - generated), batch_first);
+                batch_pos = 0;
+            }
+            if (batch_pos < batch_size) {
+                const size_t slot = j % ring;
+                hashes[slot] = batch_hashes[batch_pos];
+                indices[slot] = batch_first + batch_pos;
+                ++batch_pos;
+                if (filtered) {
+                    filter_.prefetch(hashes[slot]);
+                } else {
+                    prefetch_first(hashes[slot]);
+                }
+                ++generated;
+            }
+            if (j >= d && j - d < generated) {
+                const size_t slot = (j - d) % ring;
+                if (!filtered) {
+                    prefetch_second(hashes[slot]);
+                } else if ((passed[slot] = filter_.contains(hashes[slot]))) {
+                    prefetch_first(hashes[slot]);
+                }
+            }
+            if (j < 2 * d) {
+                continue;
+            }
+            const uint64_t resolved = j - 2 * d;
+            if (resolved >= generated) {
+                return generated;
+            }
+            const size_t slot = resolved % ring;
+            if (!passed[slot]) {
+                continue;
+            }
+            find(hashes[slot], &collision[prefix_size_], [&]() {
+                stream.prefix(indices[slot], collision.data());
+                emit(collision.data(), collision.size());
+                return ++n != n_collisions;
+            });
+            if (n == n_collisions) {
+                return resolved + 1;
+            }
+        }
+    }
+
+    template <typename Emit>
+    uint64_t search_merge(uint64_t n_collisions, uint64_t max_tries, PrefixStream& stream,
+                          Emit& emit) const {
+        // The batch is partitioned on its top bucket_bits bits (MSD) into chunks of about
+        // L2_CHUNK_ENTRIES, then each chunk is sorted on the remaining bits in cache and
+        // merged against its slice of the table
+        unsigned bucket_bits = 0;
+        while ((MERGE_BATCH >> bucket_bits) > L2_CHUNK_ENTRIES) {
+            ++bucket_bits;
+        }
+        const size_t n_buckets = size_t(1) << bucket_bits;
+        auto bucket = [&](uint32_t h) -> size_t {
+            return bucket_bits == 0 ? 0 : h >> (32 - bucket_bits);
+        };
+
+        // A batch is a few runs of consecutive prefix indices: (position in the batch, index).
+        // A bounded search fills no more than max_tries of it.
+        const size_t capacity = static_cast<size_t>(std::min<uint64_t>(MERGE_BATCH, max_tries));
+        std::vector<std::pair<uint32_t, uint64_t>> runs;
+        std::vector<uint32_t> batch_hashes(capacity);
+        std::vector<std::pair<uint32_t, uint32_t>> hashes(capacity);
+        std::vector<std::pair<uint32_t, uint32_t>> sorted(capacity);
+        std::vector<size_t> starts(n_buckets + 1);
+        std::vector<uint8_t> collision(length());
+        uint64_t tries = 0;
+        uint64_t n = 0;
+        while (n != n_collisions && tries < max_tries) {
+            const size_t limit = static_cast<size_t>(std::min<uint64_t>(capacity, max_tries - tries));
+            size_t batch = 0;
+            runs.clear();
+            while (batch < limit) {
+                uint64_t first;
+                const size_t size = stream.next(&batch_hashes[batch], limit - batch, first);
+                if (size == 0) {
+                    break;
+                }
+                if (runs.empty() || runs.back().second + (batch - runs.back().first) != first) {
+                    runs.emplace_back(static_cast<uint32_t>(batch), first);
+                }
+                batch += size;
+            }
+            if (batch == 0) {
+                break;
+            }
+            for (size_t i = 0; i < batch; ++i) {
+                hashes[i] = {batch_hashes[i], static_cast<uint32_t>(i)};
+            }
+            tries += batch;
+
+            std::fill(starts.begin(), starts.end(), 0);
+            for (size_t i = 0; i < batch; ++i) {
+                ++starts[bucket(hashes[i].first) + 1];
+            }
+            for (size_t b = 0; b < n_buckets; ++b) {
+                starts[b + 1] += starts[b];
+            }
+            {
+                std::vector<size_t> fill(starts.begin(), starts.end() - 1);
+                for (size_t i = 0; i < batch; ++i) {
+                    sorted[fill[bucket(hashes[i].first)]++] = hashes[i];
+                }
+            }
+
+            for (size_t b = 0; b < n_buckets && n != n_collisions; ++b) {
+                const size_t size = starts[b + 1] - starts[b];
+                radix_sort_by_key(&sorted[starts[b]], &hashes[starts[b]], size, 32 - bucket_bits);
+                table_.merge_join(&sorted[starts[b]], size, [&](uint32_t id, uint32_t suffix_index) {
+                    const auto run =
+                        std::upper_bound(runs.begin(), runs.end(), std::make_pair(id, UINT64_MAX)) - 1;
+                    stream.prefix(run->second + (id - run->first), collision.data());
+                    suffix(suffix_index, &collision[prefix_size_]);
+                    emit(collision.data(), collision.size());
+                    return ++n != n_collisions;
+                });
+            }
+        }
+        return tries;
+    }
+
+    MultiplicativeHash hash_;
+    size_t prefix_size_;
+    size_t suffix_size_;
+    CharsetSpec prefix_spec_;
+    CharsetSpec suffix_spec_;
+    uint64_t table_entries_;
+    TableBackend backend_;
+    uint32_t target_ = 0;
+    size_t group_size_ = DEFAULT_GROUP_SIZE;
+    double filter_bits_ = 0;
+    CsrSuffixTable table_;
+    RibbonRetrieval ribbon_;
+    SplitBlockBloomFilter filter_;
+};
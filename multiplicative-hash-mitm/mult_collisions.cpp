@@ -0,0 +1,869 @@
+// mult_collisions.cpp
+// Native collision generator for multiplicative hash functions
+// Author: Paul Bottinelli
+// For Black Hat EU 2025 - Cut to the QUIC: Slashing QUIC's Performance with a Hash DoS
+//
+// Three engines generate inputs hashing to a common target:
+//   - mitm:    native port of the meet-in-the-middle attack in generic_mitm.py (32-bit only)
+//   - lattice: LLL/Babai preimages, no precomputation, works for 32-bit and 64-bit digests
+//   - joux:    2^k multicollisions chained from k block collisions found by the other two
+
+#include <chrono>
+#include <cstdint>
+#include <exception>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include "../common/corpus.h"
+#include "../common/hex_format.h"
+#include "../common/large_alloc.h"
+#include "../common/lease.h"
+#include "../common/shm_ring.h"
+#include "autotune.h"
+#include "charset.h"
+#include "collision_streams.h"
+#include "lattice.h"
+#include "mitm.h"
+#include "multicollision.h"
+#include "multiplicative_hash.h"
+
+// Configuration constants (defaults match generic_mitm.py)
+constexpr size_t DEFAULT_PREFIX_SIZE = 7;
+constexpr size_t DEFAULT_SUFFIX_SIZE = 3;
+constexpr uint64_t DEFAULT_INITIAL_VALUE = 5387;
+constexpr uint64_t DEFAULT_MULTIPLIER = 31;
+constexpr uint64_t DEFAULT_N_COLLISIONS = 100;
+constexpr size_t DEFAULT_JOUX_BLOCKS = 20;
+constexpr double DEFAULT_FILTER_BITS = 8;
+constexpr uint64_t DEFAULT_LEASE_SIZE = uint64_t(1) << 28;  // prefixes per lease
+constexpr double DEFAULT_LEASE_TIMEOUT = 30;
+constexpr const char* DEFAULT_SHARD_DIR = "mult_collisions.shards";
+
+enum class OutputFormat { Bytes, Hex, C };
+enum class Engine { Mitm, Lattice, Joux };
+
+const char* search_mode_name(SearchMode mode) {
+    switch (mode) {
+    case SearchMode::Probe: return "probe";
+    case SearchMode::Prefetch: return "prefetch";
+    case SearchMode::Merge: return "merge";
+    case SearchMode::Auto: return "auto";
+    }
+    return "";
+}
+
+// Print collision as Python bytes literal, C-style byte array or hexadecimal string
+void print_collision(hex_format::Buffer& out, const uint8_t* data, size_t length, OutputFormat format) {
+    switch (format) {
+    case OutputFormat::Hex:
+        out.hex(data, length);
+        break;
+    case OutputFormat::C:
+        out.c_array(data, length);
+        break;
+    case OutputFormat::Bytes:
+        out.bytes_literal(data, length);
+        break;
+    }
+    out.put('\n');
+}
+
+// Function to display the progress bar
+void show_progress(uint64_t current, uint64_t total, int bar_length = 40) {
+    const double progress = static_cast<double>(current) / total;
+    const int pos = static_cast<int>(progress * bar_length);
+
+    std::cout << "\rProgress: [";
+    for (int i = 0; i < bar_length; ++i) {
+        std::cout << (i < pos ? '#' : '-');
+    }
+    std::cout << "] " << std::fixed << std::setprecision(2) << (progress * 100.0) << "%";
+    std::cout.flush();
+}
+
+double seconds_since(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Time both engines on the same target and report setup time and collision rate. The
+// meet-in-the-middle engine is run with every search mode for every table size up to
+// max_table_bits, to show where prefetching and merging overtake plain probing.
+int run_benchmark(const MultiplicativeHash& hash, size_t prefix_size, size_t suffix_size,
+                  uint64_t n_collisions, uint64_t target, const CharsetSpec& spec,
+                  TableBackend backend, unsigned max_table_bits, size_t group_size,
+                  double filter_bits, std::mt19937_64& rng) {
+    std::cout << "Benchmarking " << n_collisions << " collisions of " << prefix_size + suffix_size
+              << " bytes, " << hash.bits() << "-bit digest" << std::endl;
+    std::cout << std::left << std::setw(20) << "engine" << std::setw(20) << "setup (s)"
+              << std::setw(20) << "search (s)" << std::setw(20) << "collisions/s"
+              << std::setw(20) << "Mprefixes/s" << "table entries" << std::endl;
+
+    uint64_t sink = 0;
+    if (hash.bits() == 32) {
+        const unsigned first_bits = std::min(16u, max_table_bits);
+        for (unsigned table_bits = first_bits; table_bits <= max_table_bits; table_bits += 2) {
+            MeetInTheMiddle mitm(hash, prefix_size, suffix_size, spec, table_bits, backend);
+            mitm.set_group_size(group_size);
+            auto start = std::chrono::steady_clock::now();
+            mitm.precompute(static_cast<uint32_t>(target));
+            const double setup = seconds_since(start);
+            // Prefixes per second of each probing mode, without then with the filter
+            double rates[2][2] = {};
+            auto run = [&](SearchMode mode, double setup_time, const char* suffix) {
+                PrefixRange range(mitm.prefix_count(), rng());
+                const auto search_start = std::chrono::steady_clock::now();
+                const uint64_t tries = mitm.search(
+                    n_collisions, range, [&](const uint8_t* c, size_t) { sink += c[0]; }, mode);
+                const double search = seconds_since(search_start);
+                std::cout << std::setw(20) << std::string("mitm/") + search_mode_name(mode) + suffix
+                          << std::setw(20) << setup_time << std::setw(20) << search << std::setw(20)
+                          << n_collisions / search << std::setw(20) << tries / search / 1e6
+                          << mitm.table_entries() << std::endl;
+                return tries / search;
+            };
+            rates[0][0] = run(SearchMode::Probe, setup, "");
+            rates[0][1] = run(SearchMode::Prefetch, setup, "");
+            if (backend == TableBackend::Csr) {
+                run(SearchMode::Merge, setup, "");
+            }
+
+            mitm.set_filter_bits(filter_bits);
+            start = std::chrono::steady_clock::now();
+            mitm.build_filter();
+            const double filter_setup = setup + seconds_since(start);
+            rates[1][0] = run(SearchMode::Probe, filter_setup, "+bloom");
+            rates[1][1] = run(SearchMode::Prefetch, filter_setup, "+bloom");
+
+            // False positive rate on random hashes that are not in the table
+            uint64_t negatives = 0;
+            uint64_t false_positives = 0;
+            for (uint32_t i = 0; i < (1u << 22); ++i) {
+                const uint32_t h = static_cast<uint32_t>(rng());
+                if (!mitm.contains(h)) {
+                    ++negatives;
+                    false_positives += mitm.filter().contains(h);
+                }
+            }
+            const auto precision = std::cout.precision(3);
+            if (backend == TableBackend::Ribbon) {
+                std::cout << "  ribbon table: " << mitm.memory_bytes() / 1024 << " KB ("
+                          << 8.0 * mitm.memory_bytes() / mitm.table_entries() << " bits/entry), "
+                          << mitm.ribbon().dropped() << " entries dropped" << std::endl;
+            }
+            std::cout << "  bloom filter: " << mitm.filter().memory_bytes() / 1024 << " KB, "
+                      << filter_bits << " bits/key, " << 100.0 * false_positives / negatives
+                      << "% false positives, speedup x" << rates[1][0] / rates[0][0]
+                      << " (probe), x" << rates[1][1] / rates[0][1] << " (prefetch)" << std::endl;
+            std::cout.precision(precision);
+            mitm.set_filter_bits(0);
+            if (mitm.table_entries() < (uint64_t(1) << table_bits)) {
+                break;  // the suffix space is exhausted, larger sizes are the same table
+            }
+        }
+    } else {
+        std::cout << std::setw(20) << "mitm" << "n/a (32-bit digests only)"
+                  << std::endl;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    LatticeEngine engine(hash, spec);
+    const double setup = seconds_since(start);
+    std::vector<uint8_t> collision;
+    start = std::chrono::steady_clock::now();
+    for (uint64_t n = 0; n < n_collisions; ++n) {
+        if (!engine.preimage(target, rng, collision)) {
+            std::cerr << "Error: lattice engine cannot satisfy the charset at this length" << std::endl;
+            return 1;
+        }
+        sink += collision[0];
+    }
+    const double search = seconds_since(start);
+    std::cout << std::setw(20) << "lattice" << std::setw(20) << setup << std::setw(20) << search
+              << std::setw(20) << n_collisions / search << std::setw(20) << "-" << 0 << std::endl;
+    std::cout << std::right << "(checksum " << sink << ")" << std::endl;
+    return 0;
+}
+
+// Search for n_collisions collisions on n_threads workers, pinned round-robin over the NUMA
+// nodes. replicas maps a node to the copy of the table on that node, if any. The workers
+// claim chunks of the same prefix range and each looks for an equal share of the
+// collisions; emit is serialized. If a worker throws (e.g. emit failing to write), the
+// others stop after their current chunk and the first exception is rethrown.
+template <typename Emit>
+void search_threads(const MeetInTheMiddle& mitm,
+                    const std::map<int, std::unique_ptr<MeetInTheMiddle>>& replicas,
+                    uint64_t n_collisions, SearchMode mode, size_t n_threads,
+                    PrefixRange& range, Emit emit) {
+    const large_alloc::Topology& topology = large_alloc::Topology::get();
+    std::mutex emit_mutex;
+    std::exception_ptr error;  // under emit_mutex
+    std::vector<std::thread> workers;
+    for (size_t i = 0; i < n_threads; ++i) {
+        const uint64_t share = n_collisions / n_threads + (i < n_collisions % n_threads);
+        workers.emplace_back([&, i, share]() {
+            const int cpu = topology.worker_cpu(i);
+            large_alloc::pin_thread(cpu);
+            const auto replica = replicas.find(topology.node_of_cpu(cpu));
+            const MeetInTheMiddle& table = replica == replicas.end() ? mitm : *replica->second;
+            try {
+                if (share > 0) {
+                    table.search(share, range, [&](const uint8_t* collision, size_t size) {
+                        std::lock_guard<std::mutex> lock(emit_mutex);
+                        if (!error) {
+                            emit(collision, size);
+                        }
+                    }, mode);
+                }
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(emit_mutex);
+                if (!error) {
+                    error = std::current_exception();
+                }
+                range.close();
+            }
+        });
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+// Search the prefixes of the leases of a coordinator (--worker), until it is done. The hash,
+// target, charset and table come from the coordinator; the search mode, filter, group size
+// and threads only change the speed, so they are the worker's own.
+int run_worker(const std::string& address, double wait, SearchMode search_mode, double filter_bits,
+               size_t group_size, size_t n_threads) {
+    try {
+        LeaseWorker worker(address, wait);
+        const LeaseJob& job = worker.job();
+        if (job.get("tool") != "mult_collisions") {
+            throw std::runtime_error("coordinator " + address + " runs another job: " + job.line());
+        }
+        const MultiplicativeHash hash(job.number("initial"), job.number("multiplier"), 32);
+        const CharsetSpec spec = job.has("spec")
+            ? CharsetSpec::parse(job.get("spec"))
+            : CharsetSpec::uniform(job.number("length"), ByteSet::parse(job.get("charset")));
+        const TableBackend backend = job.get("table") == "ribbon" ? TableBackend::Ribbon : TableBackend::Csr;
+        MeetInTheMiddle mitm(hash, job.number("prefix"), job.number("suffix"), spec,
+                             static_cast<unsigned>(job.number("table_bits")), backend);
+        if (mitm.length() != worker.record_size()) {
+            throw std::runtime_error("coordinator " + address + " expects records of another length");
+        }
+        mitm.set_group_size(group_size);
+        mitm.set_filter_bits(filter_bits >= 0 ? filter_bits
+                             : search_mode == SearchMode::Merge ? 0 : DEFAULT_FILTER_BITS);
+        const auto start = std::chrono::steady_clock::now();
+        mitm.precompute(static_cast<uint32_t>(job.number("target")));
+        std::cout << "Working for " << address << ", table precomputed in " << seconds_since(start)
+                  << " s" << std::endl;
+        if (search_mode == SearchMode::Auto) {
+            std::mt19937_64 rng(std::random_device{}());
+            PrefixRange calibration(mitm.prefix_count(), rng());
+            search_mode = mitm.select_search_mode(UINT32_MAX, calibration).mode;
+            std::cout << "Search mode: " << search_mode_name(search_mode) << std::endl;
+        }
+
+        Lease lease;
+        std::vector<uint8_t> records;
+        uint64_t n_leases = 0;
+        while (worker.next(lease)) {
+            const auto lease_start = std::chrono::steady_clock::now();
+            PrefixRange range(mitm.prefix_count(), job.number("start") + lease.first, lease.size);
+            records.clear();
+            search_threads(mitm, {}, UINT64_MAX, search_mode, n_threads, range,
+                           [&](const uint8_t* collision, size_t size) {
+                               records.insert(records.end(), collision, collision + size);
+                           });
+            std::cout << "Lease " << lease.id << ": " << records.size() / mitm.length()
+                      << " collisions in " << seconds_since(lease_start) << " s" << std::endl;
+            if (!worker.complete(lease, records)) {
+                break;
+            }
+            ++n_leases;
+        }
+        std::cout << "Coordinator done, " << n_leases << " leases searched" << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+void print_usage(const char* name) {
+    std::cerr << "Usage: " << name << " [-n n_collisions] [-p prefix] [-s suffix] [-i initial]"
+              << " [-m multiplier] [-b 32|64] [-t target] [-e mitm|lattice|joux] [-l length]"
+              << " [-k blocks] [--block-length length] [--block-engine lattice|mitm]"
+              << " [--search probe|prefetch|merge|auto] [--group size]"
+              << " [--filter-bits bits]"
+              << " [--table csr|ribbon] [--table-bits bits]"
+              << " [-c charset] [--spec spec] [-f bytes|hex|c] [-o output] [--corpus path] [--shm name] [--seed seed]"
+              << " [--start-index index]"
+              << " [--interactive]"
+              << " [--threads n] [--numa local|interleave|replicate] [--hugepages off|thp|explicit]"
+              << " [--placement] [--autotune] [--retune] [--profile path]"
+              << " [--coordinate address [--shards dir] [--lease-size n] [--lease-timeout seconds]]"
+              << " [--worker address [--wait seconds]]"
+              << " [--quiet|-q] [--test] [--bench]" << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+    // Parse command line arguments
+    size_t prefix_size = DEFAULT_PREFIX_SIZE;
+    size_t suffix_size = DEFAULT_SUFFIX_SIZE;
+    size_t length = 0;
+    uint64_t initial_value = DEFAULT_INITIAL_VALUE;
+    uint64_t multiplier = DEFAULT_MULTIPLIER;
+    uint64_t n_collisions = DEFAULT_N_COLLISIONS;
+    unsigned bits = 32;
+    bool has_target = false;
+    uint64_t target = 0;
+    bool has_seed = false;
+    uint64_t seed = 0;
+    bool has_start_index = false;
+    uint64_t start_index = 0;
+    ByteSet charset = ByteSet::any();
+    std::string charset_name = "any";
+    std::string spec_string;
+    Engine engine = Engine::Mitm;
+    size_t n_blocks = DEFAULT_JOUX_BLOCKS;
+    size_t block_length = 0;  // one byte per 4 digest bits unless given
+    auto block_engine = JouxMulticollision::BlockEngine::Lattice;
+    SearchMode search_mode = SearchMode::Auto;
+    unsigned table_bits = MeetInTheMiddle::MAX_TABLE_BITS;
+    TableBackend backend = TableBackend::Csr;
+    size_t group_size = MeetInTheMiddle::DEFAULT_GROUP_SIZE;
+    double filter_bits = -1;  // DEFAULT_FILTER_BITS, or none with --search merge
+    OutputFormat format = OutputFormat::Bytes;
+    std::string output;
+    std::string corpus_path;
+    std::string ring_name;
+    bool interactive = false;
+    bool quiet = false;
+    bool run_test = false;
+    bool bench = false;
+    size_t n_threads = 1;
+    bool placement = false;
+    bool autotune = false;
+    bool retune = false;
+    std::string profile_path = autotune::default_profile_path();
+    // Parameters given explicitly, which --autotune leaves alone
+    bool has_suffix = false;
+    bool has_table_bits = false;
+    bool has_backend = false;
+    bool has_group = false;
+    bool has_threads = false;
+    std::string coordinate_address;
+    std::string worker_address;
+    double worker_wait = 10;
+    LeaseCoordinator::Config lease_config;
+    lease_config.shard_dir = DEFAULT_SHARD_DIR;
+    lease_config.lease_size = DEFAULT_LEASE_SIZE;
+    lease_config.timeout = DEFAULT_LEASE_TIMEOUT;
+
+    try {
+        for (int i = 1; i < argc; i++) {
+            const std::string arg = argv[i];
+            auto value = [&]() -> std::string {
+                if (i + 1 >= argc) {
+                    throw std::invalid_argument("missing value for " + arg);
+                }
+                return argv[++i];
+            };
+
+            if (arg == "-n" || arg == "--n-collisions") {
+                n_collisions = std::stoull(value(), nullptr, 0);
+            } else if (arg == "-p" || arg == "--prefix") {
+                prefix_size = std::stoul(value(), nullptr, 0);
+            } else if (arg == "-s" || arg == "--suffix") {
+                suffix_size = std::stoul(value(), nullptr, 0);
+                has_suffix = true;
+            } else if (arg == "-l" || arg == "--length") {
+                length = std::stoul(value(), nullptr, 0);
+            } else if (arg == "-i" || arg == "--initial") {
+                initial_value = std::stoull(value(), nullptr, 0);
+            } else if (arg == "-m" || arg == "--multiplier") {
+                multiplier = std::stoull(value(), nullptr, 0);
+            } else if (arg == "-b" || arg == "--bits") {
+                bits = static_cast<unsigned>(std::stoul(value(), nullptr, 0));
+            } else if (arg == "-t" || arg == "--target") {
+                target = std::stoull(value(), nullptr, 0);
+                has_target = true;
+            } else if (arg == "--seed") {
+                seed = std::stoull(value(), nullptr, 0);
+                has_seed = true;
+            } else if (arg == "--start-index") {
+                start_index = std::stoull(value(), nullptr, 0);
+                has_start_index = true;
+            } else if (arg == "-c" || arg == "--charset") {
+                charset_name = value();
+                charset = ByteSet::parse(charset_name);
+            } else if (arg == "--spec") {
+                spec_string = value();
+            } else if (arg == "-e" || arg == "--engine") {
+                const std::string name = value();
+                if (name == "mitm") {
+                    engine = Engine::Mitm;
+                } else if (name == "lattice") {
+                    engine = Engine::Lattice;
+                } else if (name == "joux") {
+                    engine = Engine::Joux;
+                } else {
+                    throw std::invalid_argument("unknown engine " + name);
+                }
+            } else if (arg == "-k" || arg == "--blocks") {
+                n_blocks = std::stoul(value(), nullptr, 0);
+            } else if (arg == "--block-length") {
+                block_length = std::stoul(value(), nullptr, 0);
+            } else if (arg == "--block-engine") {
+                const std::string name = value();
+                if (name == "lattice") {
+                    block_engine = JouxMulticollision::BlockEngine::Lattice;
+                } else if (name == "mitm") {
+                    block_engine = JouxMulticollision::BlockEngine::Mitm;
+                } else {
+                    throw std::invalid_argument("unknown block engine " + name);
+                }
+            } else if (arg == "--search") {
+                const std::string name = value();
+                if (name == "probe") {
+                    search_mode = SearchMode::Probe;
+                } else if (name == "prefetch") {
+                    search_mode = SearchMode::Prefetch;
+                } else if (name == "merge") {
+                    search_mode = SearchMode::Merge;
+                } else if (name == "auto") {
+                    search_mode = SearchMode::Auto;
+                } else {
+                    throw std::invalid_argument("unknown search mode " + name);
+                }
+            } else if (arg == "--group") {
+                group_size = std::stoul(value(), nullptr, 0);
+                has_group = true;
+            } else if (arg == "--filter-bits") {
+                filter_bits = std::stod(value());
+            } else if (arg == "--table") {
+                const std::string name = value();
+                if (name == "csr") {
+                    backend = TableBackend::Csr;
+                } else if (name == "ribbon") {
+                    backend = TableBackend::Ribbon;
+                } else {
+                    throw std::invalid_argument("unknown table backend " + name);
+                }
+                has_backend = true;
+            } else if (arg == "--table-bits") {
+                table_bits = static_cast<unsigned>(std::stoul(value(), nullptr, 0));
+                has_table_bits = true;
+            } else if (arg == "-f" || arg == "--format") {
+                const std::string name = value();
+                if (name == "bytes") {
+                    format = OutputFormat::Bytes;
+                } else if (name == "hex") {
+                    format = OutputFormat::Hex;
+                } else if (name == "c") {
+                    format = OutputFormat::C;
+                } else {
+                    throw std::invalid_argument("unknown format " + name);
+                }
+            } else if (arg == "-o" || arg == "--output") {
+                output = value();
+            } else if (arg == "--corpus") {
+                corpus_path = value();
+            } else if (arg == "--shm") {
+                ring_name = value();
+            } else if (arg == "--interactive") {
+                interactive = true;
+            } else if (arg == "--quiet" || arg == "-q") {
+                quiet = true;
+            } else if (arg == "--test") {
+                run_test = true;
+            } else if (arg == "--threads") {
+                n_threads = std::stoul(value(), nullptr, 0);
+                if (n_threads == 0) {
+                    throw std::invalid_argument("number of threads must be positive");
+                }
+                has_threads = true;
+            } else if (arg == "--numa") {
+                const std::string name = value();
+                if (name == "local") {
+                    large_alloc::config().numa = large_alloc::NumaPolicy::Local;
+                } else if (name == "interleave") {
+                    large_alloc::config().numa = large_alloc::NumaPolicy::Interleave;
+                } else if (name == "replicate") {
+                    large_alloc::config().numa = large_alloc::NumaPolicy::Replicate;
+                } else {
+                    throw std::invalid_argument("unknown NUMA policy " + name);
+                }
+            } else if (arg == "--hugepages") {
+                const std::string name = value();
+                if (name == "off") {
+                    large_alloc::config().huge_pages = large_alloc::HugePages::Off;
+                } else if (name == "thp") {
+                    large_alloc::config().huge_pages = large_alloc::HugePages::Transparent;
+                } else if (name == "explicit") {
+                    large_alloc::config().huge_pages = large_alloc::HugePages::Explicit;
+                } else {
+                    throw std::invalid_argument("unknown huge page mode " + name);
+                }
+            } else if (arg == "--placement") {
+                placement = true;
+            } else if (arg == "--autotune") {
+                autotune = true;
+            } else if (arg == "--retune") {
+                autotune = true;
+                retune = true;
+            } else if (arg == "--profile") {
+                profile_path = value();
+            } else if (arg == "--bench") {
+                bench = true;
+            } else if (arg == "--coordinate") {
+                coordinate_address = value();
+            } else if (arg == "--worker") {
+                worker_address = value();
+            } else if (arg == "--wait") {
+                worker_wait = std::stod(value());
+            } else if (arg == "--shards") {
+                lease_config.shard_dir = value();
+            } else if (arg == "--lease-size") {
+                lease_config.lease_size = std::stoull(value(), nullptr, 0);
+            } else if (arg == "--lease-timeout") {
+                lease_config.timeout = std::stod(value());
+            } else {
+                throw std::invalid_argument("unknown argument " + arg);
+            }
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    if (!worker_address.empty()) {
+        return run_worker(worker_address, worker_wait, search_mode, filter_bits, group_size, n_threads);
+    }
+    if (!coordinate_address.empty() && (engine != Engine::Mitm || bench || bits != 32)) {
+        std::cerr << "Error: --coordinate distributes the 32-bit meet-in-the-middle search" << std::endl;
+        return 1;
+    }
+
+    if (n_collisions == 0 || n_collisions > UINT32_MAX + uint64_t(1)) {
+        std::cerr << "Error: Number of collisions must be between 1 and 2^32" << std::endl;
+        return 1;
+    }
+    CharsetSpec spec;
+    if (!spec_string.empty()) {
+        try {
+            spec = CharsetSpec::parse(spec_string);
+        } catch (const std::exception& e) {
+            std::cerr << "Error: " << e.what() << std::endl;
+            return 1;
+        }
+        length = spec.length();
+    }
+    if (length != 0) {
+        // An explicit length keeps the default table size and moves the rest to the prefix
+        if (length <= suffix_size) {
+            std::cerr << "Error: length must be larger than the suffix size" << std::endl;
+            return 1;
+        }
+        prefix_size = length - suffix_size;
+    }
+    if (spec_string.empty()) {
+        spec = CharsetSpec::uniform(prefix_size + suffix_size, charset);
+    }
+
+    try {
+        const MultiplicativeHash hash(initial_value, multiplier, bits);
+        if (!has_seed) {
+            seed = std::random_device{}() ^ (uint64_t(std::random_device{}()) << 32);
+        }
+        std::mt19937_64 rng(seed);
+
+        // The multicollision blocks are found up front: without an explicit target, their
+        // common hash becomes the target
+        std::unique_ptr<JouxMulticollision> joux;
+        if (engine == Engine::Joux && !bench) {
+            if (block_length == 0) {
+                block_length = bits / 4;
+            }
+            joux.reset(new JouxMulticollision(hash, n_blocks, block_length, charset));
+            const auto start = std::chrono::steady_clock::now();
+            joux->find_blocks(rng, block_engine);
+            if (has_target) {
+                joux->set_target(target & hash.mask(), block_length, rng);
+            }
+            target = joux->hash();
+            has_target = true;
+            std::cout << "Found " << n_blocks << " block collisions in " << seconds_since(start)
+                      << " s: 2^" << n_blocks << " = " << joux->size() << " colliding inputs of "
+                      << joux->length() << " bytes" << std::endl;
+            if (n_collisions > joux->size()) {
+                std::cerr << "Error: at most 2^" << n_blocks << " collisions with " << n_blocks
+                          << " blocks" << std::endl;
+                return 1;
+            }
+        }
+
+        if (!has_target) {
+            target = rng() & hash.mask();
+        }
+        target &= hash.mask();
+
+        if (bench) {
+            return run_benchmark(hash, prefix_size, suffix_size, n_collisions, target,
+                                 spec, backend, table_bits, group_size,
+                                 filter_bits > 0 ? filter_bits : DEFAULT_FILTER_BITS, rng);
+        }
+
+        std::ofstream output_file;
+        if (!output.empty()) {
+            output_file.open(output);
+            if (!output_file) {
+                std::cerr << "Error: Could not open output file '" << output << "'" << std::endl;
+                return 1;
+            }
+        }
+        std::ostream& out = output.empty() ? std::cout : output_file;
+        // Collisions are formatted into a large buffer, flushed before anything else is printed
+        hex_format::Buffer text(out);
+
+        std::cout << "Target hash: " << target << std::endl;
+
+        CorpusInfo info;
+        info.model = "mult:" + std::to_string(hash.initial_value()) + ":" +
+                     std::to_string(hash.multiplier()) + ":" + std::to_string(bits);
+        info.hash_bits = bits;
+        info.target = target;
+        info.target_mask = hash.mask();
+        info.seed = seed;
+        info.param("generator", "mult_collisions")
+            .param("engine", engine == Engine::Mitm ? "mitm" : engine == Engine::Joux ? "joux" : "lattice");
+        if (!spec_string.empty()) {
+            info.param("spec", spec_string);
+        }
+        const size_t record_size = joux ? joux->length() : spec.length();
+        std::unique_ptr<CorpusWriter> corpus;
+        if (!corpus_path.empty()) {
+            corpus.reset(new CorpusWriter(corpus_path, info, record_size));
+        }
+        // Collisions are also published to a consumer process as they are found
+        std::unique_ptr<ShmRingWriter> ring;
+        if (!ring_name.empty()) {
+            ring.reset(new ShmRingWriter(ring_name, info, record_size));
+        }
+
+        uint64_t passed = 0;
+        uint64_t failed = 0;
+        uint64_t emitted = 0;
+        auto emit = [&](const uint8_t* collision, size_t size) {
+            ++emitted;
+            if (run_test) {
+                if (hash.hash(collision, size) == target) {
+                    ++passed;
+                } else {
+                    ++failed;
+                }
+            }
+            if (!quiet) {
+                print_collision(text, collision, size, format);
+            }
+            if (corpus) {
+                corpus->add(collision, size);
+            }
+            if (ring) {
+                ring->add(collision, size);
+            }
+        };
+
+        if (engine == Engine::Mitm && autotune) {
+            if (bits != 32) {
+                throw std::invalid_argument("--autotune tunes the meet-in-the-middle engine, 32-bit only");
+            }
+            const autotune::Profile profile = autotune::get(profile_path, retune, std::cout);
+            autotune::Constraints fixed;
+            fixed.suffix_size = has_suffix ? suffix_size : 0;
+            fixed.fixed_backend = has_backend;
+            fixed.backend = backend;
+            fixed.table_bits = has_table_bits ? table_bits : 0;
+            const autotune::Choice choice = autotune::choose(profile, n_collisions, spec, fixed);
+            suffix_size = choice.suffix_size;
+            prefix_size = spec.length() - suffix_size;
+            backend = choice.backend;
+            table_bits = choice.table_bits;
+            if (search_mode == SearchMode::Auto) {
+                search_mode = choice.mode;
+            }
+            if (filter_bits < 0) {
+                filter_bits = choice.filter_bits;
+            }
+            if (!has_group) {
+                group_size = choice.group_size;
+            }
+            if (!has_threads) {
+                n_threads = choice.threads;
+            }
+            std::cout << "Autotune: " << prefix_size << "-byte prefixes, " << suffix_size
+                      << "-byte suffixes, " << (backend == TableBackend::Csr ? "csr" : "ribbon")
+                      << " table of 2^" << table_bits << ", " << search_mode_name(search_mode)
+                      << " search (group " << group_size << ", filter " << filter_bits << " bits), "
+                      << n_threads << " threads, predicted " << std::setprecision(2)
+                      << choice.predicted_seconds << " s" << std::endl;
+            std::cout.precision(6);
+        }
+
+        if (engine == Engine::Mitm && !coordinate_address.empty()) {
+            // The coordinator only sizes the prefix space; the workers build the tables
+            const MeetInTheMiddle mitm(hash, prefix_size, suffix_size, spec, table_bits, backend);
+            LeaseJob job;
+            job.set("tool", "mult_collisions")
+                .set("initial", hash.initial_value())
+                .set("multiplier", hash.multiplier())
+                .set("prefix", prefix_size)
+                .set("suffix", suffix_size)
+                .set("target", target)
+                .set("table", backend == TableBackend::Ribbon ? "ribbon" : "csr")
+                .set("table_bits", table_bits)
+                .set("start", (has_start_index ? start_index : rng()) % mitm.prefix_count());
+            if (spec_string.empty()) {
+                job.set("charset", charset_name).set("length", spec.length());
+            } else {
+                job.set("spec", spec_string);
+            }
+            lease_config.address = coordinate_address;
+            lease_config.space = mitm.prefix_count();
+            lease_config.record_size = mitm.length();
+            lease_config.limit = n_collisions;
+            LeaseCoordinator coordinator(lease_config, job, info);
+            coordinator.run(std::cout);
+            coordinator.merge(emit);
+            text.flush();
+            if (emitted < n_collisions) {
+                std::cerr << "Warning: all " << mitm.prefix_count() << " prefixes tried, only " << emitted
+                          << " collisions found" << std::endl;
+            }
+        } else if (engine == Engine::Mitm) {
+            MeetInTheMiddle mitm(hash, prefix_size, suffix_size, spec, table_bits, backend);
+            mitm.set_group_size(group_size);
+            mitm.set_filter_bits(filter_bits >= 0 ? filter_bits
+                                 : search_mode == SearchMode::Merge ? 0 : DEFAULT_FILTER_BITS);
+            std::cout << "Entries in table: " << mitm.table_entries() << std::endl;
+            std::cout << "Starting precomputations." << std::endl;
+            if (interactive) {
+                mitm.precompute(static_cast<uint32_t>(target),
+                                [](uint64_t i, uint64_t total) { show_progress(i, total); });
+            } else {
+                mitm.precompute(static_cast<uint32_t>(target));
+            }
+            std::cout << (interactive ? "\n" : "") << "Done precomputing (";
+            if (backend == TableBackend::Ribbon) {
+                std::cout << mitm.stored_entries() << " entries stored, " << mitm.ribbon().dropped()
+                          << " dropped, ";
+            } else {
+                std::cout << mitm.table().distinct_keys() << " distinct hashes, ";
+            }
+            std::cout << mitm.memory_bytes() / (1 << 20) << " MB)." << std::endl;
+            // Prefixes are enumerated from a random index unless resuming an earlier run
+            PrefixRange range(mitm.prefix_count(), has_start_index ? start_index : rng());
+            if (search_mode == SearchMode::Auto) {
+                PrefixRange calibration(mitm.prefix_count(), rng());
+                const auto choice = mitm.select_search_mode(n_collisions, calibration);
+                search_mode = choice.mode;
+                std::cout << "Search mode: " << search_mode_name(search_mode);
+                if (choice.probe_rate > 0) {
+                    std::cout << std::fixed << std::setprecision(1) << " (probe "
+                              << choice.probe_rate / 1e6 << " M/s, prefetch "
+                              << choice.prefetch_rate / 1e6 << " M/s, merge "
+                              << choice.merge_rate / 1e6 << " M/s)";
+                }
+                std::cout << std::endl;
+            }
+            // With the replicate policy, every node running workers gets its own copy
+            std::map<int, std::unique_ptr<MeetInTheMiddle>> replicas;
+            const large_alloc::Topology& topology = large_alloc::Topology::get();
+            if (large_alloc::config().numa == large_alloc::NumaPolicy::Replicate &&
+                topology.n_nodes() > 1) {
+                for (size_t i = 0; i < std::min(n_threads, topology.n_nodes()); ++i) {
+                    const int node = topology.node_of_cpu(topology.worker_cpu(i));
+                    large_alloc::NodeBinding binding(node);
+                    replicas[node].reset(new MeetInTheMiddle(mitm));
+                }
+            }
+            if (placement) {
+                large_alloc::report(std::cout);
+            }
+            if (n_threads > 1 || !replicas.empty()) {
+                std::cout << "Searching on " << n_threads << " threads over "
+                          << std::min(n_threads, topology.n_nodes()) << " NUMA node(s)" << std::endl;
+            }
+            // Formatting and writing the collisions overlaps with the search
+            CollisionStream collisions([&](CollisionStream::Sink& sink) {
+                if (n_threads == 1 && replicas.empty()) {
+                    mitm.search(n_collisions, range, std::ref(sink), search_mode);
+                } else {
+                    search_threads(mitm, replicas, n_collisions, search_mode, n_threads, range,
+                                   std::ref(sink));
+                }
+            });
+            for (const Collision& collision : collisions) {
+                emit(collision.data, collision.size);
+            }
+            text.flush();
+            if (emitted < n_collisions) {
+                std::cerr << "Warning: all " << range.count() << " prefixes tried, only " << emitted
+                          << " collisions found" << std::endl;
+            } else {
+                std::cout << "Resume with --start-index " << range.resume_index() << std::endl;
+            }
+        } else if (engine == Engine::Joux) {
+            for (const Collision& collision : stream_joux(*joux, n_collisions)) {
+                emit(collision.data, collision.size);
+            }
+        } else {
+            const LatticeEngine lattice_engine(hash, spec);
+            for (const Collision& collision : stream_lattice(lattice_engine, target, n_collisions, rng())) {
+                emit(collision.data, collision.size);
+            }
+        }
+
+        text.flush();
+        if (!output.empty()) {
+            std::cout << "Collisions written to " << output << std::endl;
+        }
+        if (corpus) {
+            corpus->finish();
+            std::cout << corpus->size() << " collisions written to corpus " << corpus_path << std::endl;
+        }
+        if (ring) {
+            ring->finish();
+            std::cout << ring->size() << " collisions published to ring " << ring_name << std::endl;
+        }
+
+        if (run_test) {
+            std::cout << "\n=== Test Results ===" << std::endl;
+            std::cout << "Passed: " << passed << "/" << n_collisions << std::endl;
+            std::cout << "Failed: " << failed << "/" << n_collisions << std::endl;
+            if (failed > 0) {
+                std::cout << "TEST FAILED: Some inputs do not hash to the target" << std::endl;
+                return 1;
+            }
+            std::cout << "TEST PASSED: All inputs hash to the target" << std::endl;
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,162 @@
+// multicollision.h
+// Joux-style multicollisions for multiplicative hash functions
+// Author: Paul Bottinelli
+// For Black Hat EU 2025 - Cut to the QUIC: Slashing QUIC's Performance with a Hash DoS
+//
+// Two blocks of equal length that collide from one state collide from every state, since
+// forward(s, B) = s*M^len(B) + forward(0, B). Picking one block out of each of k colliding
+// pairs therefore gives 2^k inputs with the same hash. The pairs are found with the lattice
+// or meet-in-the-middle engine; the 2^k inputs are enumerated lazily.
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <random>
+#include <stdexcept>
+#include <vector>
+#include "lattice.h"
+#include "mitm.h"
+#include "multiplicative_hash.h"
+
+class JouxMulticollision {
+public:
+    enum class BlockEngine { Lattice, Mitm };
+
+    // Upper bound on the number of blocks, so that the stream index fits in 64 bits
+    static constexpr size_t MAX_BLOCKS = 63;
+
+    // Every byte of the blocks and of the tail is taken from charset
+    JouxMulticollision(const MultiplicativeHash& hash, size_t n_blocks, size_t block_length,
+                       const ByteSet& charset = ByteSet::any())
+        : hash_(hash), n_blocks_(n_blocks), block_length_(block_length), charset_(charset) {
+        if (n_blocks == 0 || n_blocks > MAX_BLOCKS) {
+            throw std::invalid_argument("number of blocks must be between 1 and " +
+                                        std::to_string(MAX_BLOCKS));
+        }
+        if (block_length < 2) {
+            throw std::invalid_argument("blocks must be at least 2 bytes long");
+        }
+    }
+
+    size_t n_blocks() const noexcept { return n_blocks_; }
+    size_t block_length() const noexcept { return block_length_; }
+    size_t length() const noexcept { return n_blocks_ * block_length_ + tail_.size(); }
+    uint64_t size() const noexcept { return uint64_t(1) << n_blocks_; }
+
+    // Find the k colliding block pairs. With the mitm engine, each pair costs one table
+    // build of 2^(8*suffix_size) entries, so keep suffix_size small.
+    template <typename Rng>
+    void find_blocks(Rng& rng, BlockEngine engine = BlockEngine::Lattice, size_t suffix_size = 2) {
+        blocks_.assign(n_blocks_, {});
+        tail_.clear();
+
+        if (engine == BlockEngine::Lattice) {
+            const LatticeEngine lattice(hash_, CharsetSpec::uniform(block_length_, charset_));
+            for (auto& pair : blocks_) {
+                const uint64_t block_target = rng() & hash_.mask();
+                do {
+                    if (!lattice.preimage(block_target, rng, pair[0]) ||
+                        !lattice.preimage(block_target, rng, pair[1])) {
+                        throw std::runtime_error("no block collision within the charset, "
+                                                 "try a longer block length");
+                    }
+                } while (pair[0] == pair[1]);
+            }
+        } else {
+            if (block_length_ <= suffix_size) {
+                throw std::invalid_argument("block length must be larger than the suffix size");
+            }
+            MeetInTheMiddle mitm(hash_, block_length_ - suffix_size, suffix_size,
+                                 CharsetSpec::uniform(block_length_, charset_));
+            for (auto& pair : blocks_) {
+                mitm.precompute(static_cast<uint32_t>(rng() & hash_.mask()));
+                // Both searches share one range, so the second prefix differs from the first
+                PrefixRange range(mitm.prefix_count(), rng());
+                for (size_t found = 0; found < 2; ++found) {
+                    bool hit = false;
+                    mitm.search(1, range, [&](const uint8_t* c, size_t size) {
+                        pair[found].assign(c, c + size);
+                        hit = true;
+                    });
+                    if (!hit) {
+                        throw std::runtime_error("no block collision within the charset, "
+                                                 "try a longer block length");
+                    }
+                }
+            }
+        }
+    }
+
+    // Append a tail so that every message hashes to target instead of the common hash of
+    // the blocks. The tail is a lattice preimage starting from the state after the blocks.
+    template <typename Rng>
+    void set_target(uint64_t target, size_t tail_length, Rng& rng) {
+        tail_.clear();
+        const uint64_t state = blocks_hash();
+        const MultiplicativeHash from_state(state, hash_.multiplier(), hash_.bits());
+        const LatticeEngine lattice(from_state, CharsetSpec::uniform(tail_length, charset_));
+        if (!lattice.preimage(target, rng, tail_)) {
+            throw std::runtime_error("no tail reaching the target within the charset, "
+                                     "try a longer tail");
+        }
+    }
+
+    // Hash shared by all 2^k messages
+    uint64_t hash() const noexcept {
+        return hash_.forward(blocks_hash(), tail_.data(), tail_.size());
+    }
+
+    // Lazily enumerates the messages in Gray code order, so consecutive messages differ in
+    // a single block and each step only rewrites block_length bytes
+    class Stream {
+    public:
+        explicit Stream(const JouxMulticollision& mc) : mc_(mc) {
+            message_.reserve(mc.length());
+            for (const auto& pair : mc.blocks_) {
+                message_.insert(message_.end(), pair[0].begin(), pair[0].end());
+            }
+            message_.insert(message_.end(), mc.tail_.begin(), mc.tail_.end());
+        }
+
+        // Returns nullptr once all 2^k messages have been produced
+        const std::vector<uint8_t>* next() {
+            if (index_ == mc_.size()) {
+                return nullptr;
+            }
+            if (index_ > 0) {
+                // Gray code of index and index-1 differ in the lowest set bit of index
+                const size_t block = static_cast<size_t>(__builtin_ctzll(index_));
+                const uint64_t gray = index_ ^ (index_ >> 1);
+                const auto& src = mc_.blocks_[block][(gray >> block) & 1];
+                std::copy(src.begin(), src.end(), message_.begin() + block * mc_.block_length_);
+            }
+            ++index_;
+            return &message_;
+        }
+
+    private:
+        const JouxMulticollision& mc_;
+        std::vector<uint8_t> message_;
+        uint64_t index_ = 0;
+    };
+
+    Stream stream() const { return Stream(*this); }
+
+private:
+    MultiplicativeHash hash_;
+    size_t n_blocks_;
+    size_t block_length_;
+    ByteSet charset_;
+    std::vector<std::array<std::vector<uint8_t>, 2>> blocks_;
+    std::vector<uint8_t> tail_;
+
+    uint64_t blocks_hash() const noexcept {
+        uint64_t state = hash_.initial_value();
+        for (const auto& pair : blocks_) {
+            state = hash_.forward(state, pair[0].data(), pair[0].size());
+        }
+        return state;
+    }
+};
@@ -0,0 +1,89 @@
+// multiplicative_hash.h
+// Native model of the multiplicative hash functions attacked by generic_mitm.py
+// Author: Paul Bottinelli
+// For Black Hat EU 2025 - Cut to the QUIC: Slashing QUIC's Performance with a Hash DoS
+//
+// h = init * M^n + sum(c_i * M^(n-1-i)) mod 2^bits, for 32-bit and 64-bit digests.
+// The forward and backward partial hashes mirror the ones in generic_mitm.py.
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+
+class MultiplicativeHash {
+public:
+    MultiplicativeHash(uint64_t initial_value, uint64_t multiplier, unsigned bits = 32)
+        : bits_(bits),
+          mask_(bits >= 64 ? ~uint64_t(0) : (uint64_t(1) << bits) - 1),
+          initial_value_(initial_value & mask_),
+          multiplier_(multiplier & mask_) {
+        if (bits != 32 && bits != 64) {
+            throw std::invalid_argument("digest size must be 32 or 64 bits");
+        }
+        if ((multiplier_ & 1) == 0) {
+            throw std::invalid_argument("multiplier must be odd to be invertible mod 2^" +
+                                        std::to_string(bits));
+        }
+        // Newton iteration: each step doubles the number of correct low bits
+        uint64_t inv = multiplier_;
+        for (int i = 0; i < 5; ++i) {
+            inv *= 2 - multiplier_ * inv;
+        }
+        inv_multiplier_ = inv & mask_;
+    }
+
+    unsigned bits() const noexcept { return bits_; }
+    uint64_t mask() const noexcept { return mask_; }
+    uint64_t initial_value() const noexcept { return initial_value_; }
+    uint64_t multiplier() const noexcept { return multiplier_; }
+    uint64_t inv_multiplier() const noexcept { return inv_multiplier_; }
+
+    // Full hash of val, starting from the initial value
+    uint64_t hash(const uint8_t* val, size_t length) const noexcept {
+        return forward(initial_value_, val, length);
+    }
+
+    // Continue hashing val from an intermediate state
+    uint64_t forward(uint64_t state, const uint8_t* val, size_t length) const noexcept {
+        for (size_t i = 0; i < length; ++i) {
+            state = state * multiplier_ + val[i];
+        }
+        return state & mask_;
+    }
+
+    // State that must precede val for the hash to end on target
+    uint64_t backward(uint64_t target, const uint8_t* val, size_t length) const noexcept {
+        for (size_t i = length; i-- > 0;) {
+            target = (target - val[i]) * inv_multiplier_;
+        }
+        return target & mask_;
+    }
+
+    // M^n mod 2^bits, the weight of the byte n positions before the end
+    uint64_t power(size_t n) const noexcept {
+        uint64_t result = 1;
+        for (size_t i = 0; i < n; ++i) {
+            result *= multiplier_;
+        }
+        return result & mask_;
+    }
+
+    // M^-n mod 2^bits
+    uint64_t inverse_power(size_t n) const noexcept {
+        uint64_t result = 1;
+        for (size_t i = 0; i < n; ++i) {
+            result *= inv_multiplier_;
+        }
+        return result & mask_;
+    }
+
+private:
+    unsigned bits_;
+    uint64_t mask_;
+    uint64_t initial_value_;
+    uint64_t multiplier_;
+    uint64_t inv_multiplier_;
+};
